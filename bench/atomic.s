@@ -0,0 +1,56 @@
+# 原子操作：LR/SC 重试循环和 AMO 读改写交替更新同一组计数器。
+# 模拟器只有一个 hart，这里衡量的是原子指令路径本身的开销，而不是多核之间的争用
+
+.equ FINISHER, 0x100000
+.equ COUNTERS, 0x80200000
+.equ ITERATIONS, 2000000
+
+.text
+.globl _start
+_start:
+    li s0, COUNTERS
+    li s1, ITERATIONS
+    sd zero, 0(s0)
+    sd zero, 8(s0)
+    sd zero, 16(s0)
+    li t0, -1
+    sd t0, 24(s0)
+loop:
+    # LR/SC 自增 counter[0]
+1:  lr.d t0, (s0)
+    addi t0, t0, 1
+    sc.d t1, t0, (s0)
+    bnez t1, 1b
+    # AMOADD 自增 counter[1]
+    addi t2, s0, 8
+    li t3, 1
+    amoadd.d zero, t3, (t2)
+    # AMOMAX 记录最大的剩余次数，AMOMIN 记录最小的
+    addi t2, s0, 16
+    amomax.d zero, s1, (t2)
+    addi t2, s0, 24
+    amominu.d zero, s1, (t2)
+    # AMOSWAP 交换后换回
+    addi t2, s0, 8
+    amoswap.d.aqrl t4, zero, (t2)
+    amoswap.d.aqrl zero, t4, (t2)
+    addi s1, s1, -1
+    bnez s1, loop
+
+    li t1, FINISHER
+    li t0, ITERATIONS
+    ld t2, 0(s0)
+    bne t2, t0, fail
+    ld t2, 8(s0)
+    bne t2, t0, fail
+    ld t2, 16(s0)
+    bne t2, t0, fail
+    ld t2, 24(s0)
+    li t0, 1
+    bne t2, t0, fail
+    li t2, 0x5555
+    sw t2, 0(t1)
+fail:
+    li t2, 0x13333              # code 1
+    sw t2, 0(t1)
+2:  j 2b
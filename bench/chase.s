@@ -0,0 +1,55 @@
+# 指针追逐：8 MiB 的链表，节点顺序由满周期的线性同余序列 x -> (A*x + C) mod N 打乱，
+# 每个节点存下一个节点的地址。从节点 0 出发走 N 的整数倍步后应回到节点 0
+
+.equ FINISHER, 0x100000
+.equ NODES, 0x80200000
+.equ N_SHIFT, 20                # N = 2^20 个节点
+.equ A, 1103515245              # A mod 4 == 1、C 为奇数时周期为 N
+.equ C, 12345
+.equ LAPS, 8
+
+.text
+.globl _start
+_start:
+    # 建表：node[x] = &node[(A*x + C) mod N]
+    li s0, NODES
+    li s1, 1 << N_SHIFT
+    addi s2, s1, -1             # N - 1
+    li s3, A
+    li s4, C
+    li t0, 0
+build:
+    mul t1, t0, s3
+    add t1, t1, s4
+    and t1, t1, s2
+    slli t1, t1, 3
+    add t1, t1, s0
+    slli t2, t0, 3
+    add t2, t2, s0
+    sd t1, 0(t2)
+    addi t0, t0, 1
+    bltu t0, s1, build
+
+    # 追逐 LAPS * N 步，按 8 步展开
+    li t3, LAPS << (N_SHIFT - 3)
+    mv t0, s0
+chase:
+    ld t0, 0(t0)
+    ld t0, 0(t0)
+    ld t0, 0(t0)
+    ld t0, 0(t0)
+    ld t0, 0(t0)
+    ld t0, 0(t0)
+    ld t0, 0(t0)
+    ld t0, 0(t0)
+    addi t3, t3, -1
+    bnez t3, chase
+
+    li t1, FINISHER
+    bne t0, s0, fail
+    li t2, 0x5555
+    sw t2, 0(t1)
+fail:
+    li t2, 0x13333              # code 1
+    sw t2, 0(t1)
+1:  j 1b
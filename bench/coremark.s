@@ -0,0 +1,239 @@
+# CoreMark 风格：每轮反转一条 64 个节点的链表并按顺序遍历、做一次 8x8 整数矩阵乘法、
+# 用状态机扫描一串数字文本，三部分的结果依次累积进 CRC-16 (多项式 0xA001)，最后与预先算好的值比较
+
+.equ FINISHER, 0x100000
+.equ ITERATIONS, 5000
+.equ EXPECTED, 0xdc7d
+.equ LIST, 0x80200000           # 节点 16 字节：下一个节点地址、值
+.equ LIST_NODES, 64
+.equ MAT_A, 0x80201000          # 8x8 int64，行优先
+.equ MAT_B, 0x80201200
+
+.text
+.globl _start
+_start:
+    li sp, 0x80400000
+    li s0, ITERATIONS
+    li s1, 0                    # CRC
+    # 链表：node[i].value = (i * 37) & 0xff
+    li t0, LIST
+    li t1, 0
+    li t4, LIST_NODES
+init_list:
+    addi t2, t0, 16
+    addi t3, t1, 1
+    bne t3, t4, 1f
+    li t2, 0
+1:  sd t2, 0(t0)
+    li t5, 37
+    mul t5, t1, t5
+    andi t5, t5, 0xff
+    sd t5, 8(t0)
+    mv t0, t2
+    mv t1, t3
+    bnez t0, init_list
+    li s2, LIST                 # 表头
+    # B[i][j] = (i * j + 1) & 7
+    li t0, 0
+    li t4, 64
+    li t5, MAT_B
+init_b:
+    srli t1, t0, 3
+    andi t2, t0, 7
+    mul t1, t1, t2
+    addi t1, t1, 1
+    andi t1, t1, 7
+    slli t2, t0, 3
+    add t2, t2, t5
+    sd t1, 0(t2)
+    addi t0, t0, 1
+    bltu t0, t4, init_b
+
+iteration:
+    # 反转链表
+    mv t0, s2
+    li t1, 0
+reverse:
+    ld t2, 0(t0)
+    sd t1, 0(t0)
+    mv t1, t0
+    mv t0, t2
+    bnez t0, reverse
+    mv s2, t1
+    # 按顺序遍历：a0 = a0 * 3 + value
+    li a0, 0
+    mv t0, s2
+walk:
+    ld t2, 8(t0)
+    slli t3, a0, 1
+    add a0, a0, t3
+    add a0, a0, t2
+    ld t0, 0(t0)
+    bnez t0, walk
+    jal crc_value
+
+    # A[i][j] = (i * 8 + j + 轮次) & 15
+    li t0, 0
+    li t4, 64
+    li t5, MAT_A
+fill_a:
+    add t1, t0, s0
+    andi t1, t1, 15
+    slli t2, t0, 3
+    add t2, t2, t5
+    sd t1, 0(t2)
+    addi t0, t0, 1
+    bltu t0, t4, fill_a
+    # C = A * B，按行优先累积 a0 = a0 * 5 + C[i][j]
+    li a0, 0
+    li a2, MAT_A
+    li a6, MAT_A + 512
+mat_row:
+    li a3, MAT_B
+    li a7, MAT_B + 64
+mat_col:
+    mv a4, a2
+    mv a5, a3
+    li a1, 0
+    li t2, 8
+mat_dot:
+    ld t3, 0(a4)
+    ld t4, 0(a5)
+    mul t3, t3, t4
+    add a1, a1, t3
+    addi a4, a4, 8
+    addi a5, a5, 64
+    addi t2, t2, -1
+    bnez t2, mat_dot
+    slli t3, a0, 2
+    add a0, a0, t3
+    add a0, a0, a1
+    addi a3, a3, 8
+    bltu a3, a7, mat_col
+    addi a2, a2, 64
+    bltu a2, a6, mat_row
+    jal crc_value
+
+    # 状态机：0 起始、1 整数、2 小数、3 指数、4 非法，空格分隔的每一项按结束状态计数
+    li s3, 0
+    li s4, 0
+    li s5, 0
+    li s6, 0
+    li s7, 0
+    la t0, input
+    li t1, 0
+scan:
+    lbu t2, 0(t0)
+    beqz t2, scan_end
+    addi t0, t0, 1
+    li t3, ' '
+    beq t2, t3, separator
+    addi t3, t2, -'0'
+    li t4, 10
+    bltu t3, t4, digit
+    li t3, '.'
+    beq t2, t3, dot
+    li t3, 'e'
+    beq t2, t3, exponent
+    li t3, 'E'
+    beq t2, t3, exponent
+    li t3, '+'
+    beq t2, t3, sign
+    li t3, '-'
+    beq t2, t3, sign
+    j invalid
+digit:
+    bnez t1, scan
+    li t1, 1
+    j scan
+dot:
+    li t3, 2
+    bgeu t1, t3, invalid
+    li t1, 2
+    j scan
+exponent:
+    addi t3, t1, -1
+    li t4, 2
+    bgeu t3, t4, invalid
+    li t1, 3
+    j scan
+sign:
+    beqz t1, scan
+    li t3, 3
+    beq t1, t3, scan
+invalid:
+    li t1, 4
+    j scan
+separator:
+    jal count_state
+    li t1, 0
+    j scan
+scan_end:
+    jal count_state
+    # a0 = (((s7 * 8 + s6) * 8 + s5) * 8 + s4) * 8 + s3，再混入轮次
+    slli a0, s7, 3
+    add a0, a0, s6
+    slli a0, a0, 3
+    add a0, a0, s5
+    slli a0, a0, 3
+    add a0, a0, s4
+    slli a0, a0, 3
+    add a0, a0, s3
+    xor a0, a0, s0
+    jal crc_value
+
+    addi s0, s0, -1
+    bnez s0, iteration
+
+    li t0, EXPECTED
+    li t1, FINISHER
+    bne s1, t0, fail
+    li t2, 0x5555
+    sw t2, 0(t1)
+fail:
+    li t2, 0x13333              # code 1
+    sw t2, 0(t1)
+2:  j 2b
+
+# 把 a0 的低 16 位按字节累积进 s1
+crc_value:
+    li t5, 2
+crc_byte:
+    andi t0, a0, 0xff
+    xor s1, s1, t0
+    li t1, 8
+crc_bit:
+    andi t2, s1, 1
+    srli s1, s1, 1
+    beqz t2, 1f
+    li t3, 0xA001
+    xor s1, s1, t3
+1:  addi t1, t1, -1
+    bnez t1, crc_bit
+    srli a0, a0, 8
+    addi t5, t5, -1
+    bnez t5, crc_byte
+    ret
+
+# 按状态 t1 计数
+count_state:
+    bnez t1, 1f
+    addi s3, s3, 1
+    ret
+1:  li t3, 1
+    bne t1, t3, 2f
+    addi s4, s4, 1
+    ret
+2:  li t3, 2
+    bne t1, t3, 3f
+    addi s5, s5, 1
+    ret
+3:  li t3, 3
+    bne t1, t3, 4f
+    addi s6, s6, 1
+    ret
+4:  addi s7, s7, 1
+    ret
+
+input:
+    .asciz "123 .45e+6 -0x7f 89 +3.0e-2 abc 1.5 e9 7..2 42E5  -17 0.001 6e 2"
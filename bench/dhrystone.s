@@ -0,0 +1,140 @@
+# Dhrystone 风格：每轮复制 30 字节的字符串并与另一串比较、把 48 字节的记录传给过程修改后复制回来，
+# 夹杂按枚举值分支的整数运算。字符串比较和记录字段的结果都在最后检查
+
+.equ FINISHER, 0x100000
+.equ ITERATIONS, 100000
+.equ BUFFER, 0x80200000
+.equ RECORD, 0x80200100
+.equ RECORD_COPY, 0x80200200
+
+.text
+.globl _start
+_start:
+    li sp, 0x80400000
+    li s0, ITERATIONS
+    li s1, 0                    # 枚举值 0..3
+    li s2, 0                    # 整数运算累加
+    li s3, 0                    # 比较结果为小于的次数
+    # 记录初值：6 个 8 字节字段
+    li t0, RECORD
+    li t1, 1
+    sd t1, 0(t0)
+    sd zero, 8(t0)
+    sd zero, 16(t0)
+    sd zero, 24(t0)
+    sd zero, 32(t0)
+    sd zero, 40(t0)
+loop:
+    # strcpy(BUFFER, string1)
+    la a0, string1
+    li a1, BUFFER
+    jal strcpy
+    # strcmp(BUFFER, string2) < 0
+    li a0, BUFFER
+    la a1, string2
+    jal strcmp
+    bgez a0, 1f
+    addi s3, s3, 1
+1:
+    # 按枚举值选择运算
+    li t0, 1
+    beq s1, zero, e0
+    beq s1, t0, e1
+    li t0, 2
+    beq s1, t0, e2
+    sub s2, s2, s0
+    j enum_done
+e0: add s2, s2, s0
+    j enum_done
+e1: slli t1, s0, 1
+    add s2, s2, t1
+    j enum_done
+e2: xor s2, s2, s0
+enum_done:
+    addi s1, s1, 1
+    andi s1, s1, 3
+    # proc(RECORD)：修改字段后整体复制到 RECORD_COPY 再复制回来
+    li a0, RECORD
+    mv a1, s0
+    jal proc
+    addi s0, s0, -1
+    bnez s0, loop
+
+    # 检查：string1 < string2 每轮都成立；记录第 1 个字段每轮加 1，第 2 个字段累加 s0
+    li t1, FINISHER
+    li t0, ITERATIONS
+    bne s3, t0, fail
+    li t2, RECORD
+    ld t3, 0(t2)
+    addi t0, t0, 1
+    bne t3, t0, fail
+    ld t3, 8(t2)
+    li t0, ITERATIONS * (ITERATIONS + 1) / 2
+    bne t3, t0, fail
+    li t2, 0x5555
+    sw t2, 0(t1)
+fail:
+    li t2, 0x13333              # code 1
+    sw t2, 0(t1)
+2:  j 2b
+
+# a0: 源，a1: 目标
+strcpy:
+    lbu t0, 0(a0)
+    sb t0, 0(a1)
+    addi a0, a0, 1
+    addi a1, a1, 1
+    bnez t0, strcpy
+    ret
+
+# 返回 a0 与 a1 第一个不同字节之差
+strcmp:
+    lbu t0, 0(a0)
+    lbu t1, 0(a1)
+    bne t0, t1, 1f
+    addi a0, a0, 1
+    addi a1, a1, 1
+    bnez t0, strcmp
+1:  sub a0, t0, t1
+    ret
+
+# a0: 记录，a1: 本轮的计数
+proc:
+    addi sp, sp, -16
+    sd ra, 0(sp)
+    ld t0, 0(a0)
+    addi t0, t0, 1
+    sd t0, 0(a0)
+    ld t0, 8(a0)
+    add t0, t0, a1
+    sd t0, 8(a0)
+    sd a1, 16(a0)
+    li a1, RECORD_COPY
+    jal copy_record
+    li a0, RECORD_COPY
+    li a1, RECORD
+    jal copy_record
+    ld ra, 0(sp)
+    addi sp, sp, 16
+    ret
+
+# 复制 48 字节：a0 源，a1 目标
+copy_record:
+    ld t0, 0(a0)
+    ld t1, 8(a0)
+    ld t2, 16(a0)
+    ld t3, 24(a0)
+    ld t4, 32(a0)
+    ld t5, 40(a0)
+    sd t0, 0(a1)
+    sd t1, 8(a1)
+    sd t2, 16(a1)
+    sd t3, 24(a1)
+    sd t4, 32(a1)
+    sd t5, 40(a1)
+    ret
+
+string1:
+    .asciz "DHRYSTONE PROGRAM, 1'ST STRING"
+string2:
+    .asciz "DHRYSTONE PROGRAM, 2'ND STRING"
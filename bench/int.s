@@ -0,0 +1,41 @@
+# 整数运算：xorshift64 伪随机序列混合乘法、高位乘法、除法和取余
+# 结果与预先算好的值比较，通过时写测试结束设备正常退出
+
+.equ FINISHER, 0x100000
+.equ ITERATIONS, 2000000
+.equ EXPECTED, 0x6c8e9a0b8a302ee7
+
+.text
+.globl _start
+_start:
+    li s0, 0x9E3779B97F4A7C15   # xorshift 状态
+    li s1, ITERATIONS
+    li s2, 0                    # 累加结果
+loop:
+    slli t0, s0, 13
+    xor s0, s0, t0
+    srli t0, s0, 7
+    xor s0, s0, t0
+    slli t0, s0, 17
+    xor s0, s0, t0
+    mul t1, s0, s1
+    add s2, s2, t1
+    ori t2, s1, 1               # 除数不为 0
+    divu t3, s0, t2
+    remu t4, s0, t2
+    xor s2, s2, t3
+    add s2, s2, t4
+    mulh t5, s0, s2
+    sub s2, s2, t5
+    addi s1, s1, -1
+    bnez s1, loop
+
+    li t0, EXPECTED
+    li t1, FINISHER
+    bne s2, t0, fail
+    li t2, 0x5555
+    sw t2, 0(t1)
+fail:
+    li t2, 0x13333              # code 1
+    sw t2, 0(t1)
+1:  j 1b
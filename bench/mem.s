@@ -0,0 +1,71 @@
+# memset / memcpy：每轮用不同的值填满 1 MiB 源缓冲区，再按 8 字节展开复制到目标缓冲区，
+# 最后检查目标缓冲区首尾的值
+
+.equ FINISHER, 0x100000
+.equ SRC, 0x80200000
+.equ DST, 0x80400000
+.equ SIZE, 0x100000
+.equ ROUNDS, 48
+
+.text
+.globl _start
+_start:
+    li s0, ROUNDS
+    li s3, 0x0101010101010101
+round:
+    mul s4, s0, s3              # 本轮填充值
+    # memset(SRC, s4, SIZE)
+    li t0, SRC
+    li t1, SRC + SIZE
+fill:
+    sd s4, 0(t0)
+    sd s4, 8(t0)
+    sd s4, 16(t0)
+    sd s4, 24(t0)
+    sd s4, 32(t0)
+    sd s4, 40(t0)
+    sd s4, 48(t0)
+    sd s4, 56(t0)
+    addi t0, t0, 64
+    bltu t0, t1, fill
+    # memcpy(DST, SRC, SIZE)
+    li t0, SRC
+    li t2, DST
+copy:
+    ld a0, 0(t0)
+    ld a1, 8(t0)
+    ld a2, 16(t0)
+    ld a3, 24(t0)
+    ld a4, 32(t0)
+    ld a5, 40(t0)
+    ld a6, 48(t0)
+    ld a7, 56(t0)
+    sd a0, 0(t2)
+    sd a1, 8(t2)
+    sd a2, 16(t2)
+    sd a3, 24(t2)
+    sd a4, 32(t2)
+    sd a5, 40(t2)
+    sd a6, 48(t2)
+    sd a7, 56(t2)
+    addi t0, t0, 64
+    addi t2, t2, 64
+    bltu t0, t1, copy
+    # 检查首尾
+    li t2, DST
+    ld a0, 0(t2)
+    bne a0, s4, fail
+    li t2, DST + SIZE - 8
+    ld a0, 0(t2)
+    bne a0, s4, fail
+    addi s0, s0, -1
+    bnez s0, round
+
+    li t1, FINISHER
+    li t2, 0x5555
+    sw t2, 0(t1)
+fail:
+    li t1, FINISHER
+    li t2, 0x13333              # code 1
+    sw t2, 0(t1)
+1:  j 1b
@@ -0,0 +1,52 @@
+# 陷入密集：U 模式循环执行 ECALL，M 模式处理函数计数后 MRET 返回下一条指令，
+# 每次都经过特权级切换和 mepc/mcause/mstatus 的保存恢复
+
+.equ FINISHER, 0x100000
+.equ ITERATIONS, 3000000
+.equ MSTATUS_MPP, 0x1800
+
+.text
+.globl _start
+_start:
+    la t0, trap
+    csrw mtvec, t0
+    li s0, ITERATIONS
+    li s1, 0                    # 处理函数里的计数
+    # MRET 进入 U 模式的 user
+    li t0, MSTATUS_MPP
+    csrc mstatus, t0
+    la t0, user
+    csrw mepc, t0
+    mret
+
+user:
+    li a7, 0                    # 0: 计数，1: 结束
+    ecall
+    addi s0, s0, -1
+    bnez s0, user
+    li a7, 1
+    ecall
+1:  j 1b
+
+trap:
+    csrr t0, mcause
+    li t1, 8                    # 来自 U 模式的 ECALL
+    bne t0, t1, fail
+    bnez a7, done
+    addi s1, s1, 1
+    csrr t0, mepc
+    addi t0, t0, 4
+    csrw mepc, t0
+    mret
+
+done:
+    li t0, ITERATIONS
+    li t1, FINISHER
+    bne s1, t0, fail
+    li t2, 0x5555
+    sw t2, 0(t1)
+fail:
+    li t1, FINISHER
+    li t2, 0x13333              # code 1
+    sw t2, 0(t1)
+2:  j 2b
@@ -0,0 +1,48 @@
+# MMIO 密集：像轮询式串口驱动一样，每个字符先读 LSR 等待发送保持寄存器空，再写 THR；
+# 每行结束时读一次 CLINT 的 mtime。输出的文本由基准测试工具丢弃
+
+.equ FINISHER, 0x100000
+.equ UART, 0x10000000
+.equ UART_LSR, 5
+.equ LSR_THRE, 0x20
+.equ MTIME, 0x200BFF8
+.equ LINES, 40000
+
+.text
+.globl _start
+_start:
+    li s0, UART
+    li s1, LINES
+    li s3, MTIME
+    li s4, 0                    # 上一次读到的 mtime
+line:
+    la s2, text
+putc:
+    lbu a0, 0(s2)
+    beqz a0, line_done
+wait:
+    lbu t0, UART_LSR(s0)
+    andi t0, t0, LSR_THRE
+    beqz t0, wait
+    sb a0, 0(s0)
+    addi s2, s2, 1
+    j putc
+line_done:
+    # mtime 不应倒退
+    ld t0, 0(s3)
+    bltu t0, s4, fail
+    mv s4, t0
+    addi s1, s1, -1
+    bnez s1, line
+
+    li t1, FINISHER
+    li t2, 0x5555
+    sw t2, 0(t1)
+fail:
+    li t1, FINISHER
+    li t2, 0x13333              # code 1
+    sw t2, 0(t1)
+1:  j 1b
+
+text:
+    .asciz "The quick brown fox jumps over the lazy dog 0123456789\n"
@@ -0,0 +1,122 @@
+#ifndef RISCV_SIMULATOR_BLOCK_H
+#define RISCV_SIMULATOR_BLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu.h"
+
+// 基本块缓存：快速模式下按基本块取指和执行
+// 基本块从某个 pc 开始，到第一条控制转移 / SYSTEM / FENCE 指令 (含) 或 BLOCK_MAX_INSTS 条指令结束
+// 取指不经过 MMU (load_inst 直接访问物理内存)，因此按 pc 索引即可，SFENCE.VMA 不影响基本块缓存。
+// 基本块所在的页带 PAGE_FLAG_CODE，写入这些页时经 block_cache_code_write 让与写入范围重叠的基本块
+// 下次进入时重新取指校验，其余基本块不受影响；缓存因此总与内存一致，FENCE.I 不需要再清空缓存
+// 完整执行完的基本块按出口直接找到后继：返回用与影子调用栈同步的返回地址栈找到调用块缓存的返回点，
+// 其他出口 (分支两侧、直接跳转、间接调用) 用基本块自己的内联目标缓存，都不中时才查哈希表
+
+#define BLOCK_MAX_INSTS 32
+#define BLOCK_HASH_BITS 12
+#define BLOCK_HASH_SIZE (1u << BLOCK_HASH_BITS)
+
+// 超级块 (热路径)：入口执行次数每到 TRACE_HOT_THRESHOLD 的倍数时，沿后继命中计数占多数的方向把
+// 至多 TRACE_MAX_BLOCKS 个基本块串起来。执行时块之间只比较 pc，偏离热路径即从侧出口回到执行循环；
+// 最后一块的热后继是第一块时 (循环回边) 留在超级块里继续，每次至多 TRACE_MAX_ROUNDS 轮，
+// 以便执行循环及时处理宿主机输入和按键
+#define TRACE_HOT_THRESHOLD 256
+#define TRACE_MAX_BLOCKS 8
+#define TRACE_MAX_ROUNDS 64
+
+// 宏操作融合：取指时识别编译器常用的相邻指令对，执行时用预先译码的操作代替前一条 (或两条) 的完整译码。
+// 前一条只写整数寄存器、不会陷入，因此融合后 minstret 和陷入位置都与逐条执行一致
+typedef enum {
+    FUSE_NONE,
+    FUSE_CONST,      // LUI/AUIPC + ADDI/ADDIW，同一 rd：rd = 取指时算好的常数，两条一起完成
+    FUSE_SHIFT,      // SLLI + SRLI，同一 rd (零扩展)：rd = (rs1 << left) >> right，两条一起完成
+    FUSE_PC_REL,     // AUIPC + 以它为基址的 LOAD/JALR：rd = 常数，后一条照常执行
+    FUSE_INDEXED,    // ADD + 以它为基址的 LOAD：rd = rs1 + rs2，后一条照常执行
+} FuseKind;
+
+typedef struct {
+    uint8_t kind;     // FuseKind
+    uint8_t rd;
+    uint8_t rs1;
+    uint8_t rs2;      // FUSE_INDEXED 的第二个加数；FUSE_SHIFT 的左移位数
+    uint8_t shift;    // FUSE_SHIFT 的右移位数
+    uint64_t value;   // FUSE_CONST / FUSE_PC_REL 写入 rd 的常数
+} FusedOp;
+
+// 基本块最后一条指令的调用/返回提示 (同 JAL/JALR 对影子调用栈的处理)
+enum {
+    BLOCK_EXIT_CALL = 1,      // rd 为链接寄存器的 JAL/JALR
+    BLOCK_EXIT_RETURN = 2,    // rs1 为链接寄存器且与 rd 不同的 JALR
+};
+
+typedef struct Block {
+    uint64_t start_pc;
+    uint32_t length;          // 指令条数
+    bool valid;               // 代码被改写后清除，下次进入时重新取指校验
+    uint64_t exec_count;      // 进入次数，每次进入基本块只加一次
+    uint64_t *early_exits;    // early_exits[i]: 执行完第 i 条后因陷入/中断离开的次数，首次发生时才分配
+    struct Block *next;       // 哈希链
+    struct Block *page_next;  // 入口在同一页的基本块链
+    struct Block *successors[2]; // 内联目标缓存：最近进入的两个后继，使用前按 start_pc 和 valid 校验
+    struct Block *return_block;  // 以调用结尾的基本块：返回点 (块之后的地址) 的基本块
+    uint32_t exit_kind;       // BLOCK_EXIT_* 的组合
+    uint32_t successor_hits[2]; // successors[i] 命中的次数，组成超级块时选择热后继
+    struct Trace *trace;      // 以该块为入口的超级块
+    uint32_t insts[BLOCK_MAX_INSTS];
+    FusedOp fused[BLOCK_MAX_INSTS]; // fused[i]: 第 i 条与第 i+1 条的融合操作
+} Block;
+
+typedef struct Trace {
+    uint32_t length;
+    bool loops;               // 最后一块的热后继是第一块
+    uint64_t entries;         // 进入次数
+    uint64_t side_exits;      // 中途偏离热路径的次数，偏离过多时丢弃，之后按新的计数重新组成
+    Block *blocks[TRACE_MAX_BLOCKS];
+} Trace;
+
+// 请求执行循环在当前指令之后离开基本块 (调试停止、事件截止时间提前)，进入基本块时清除
+extern bool block_exit_requested;
+// 上一个完整执行完的基本块，block_next 用过即清除
+extern Block *block_chain_from;
+// 正在执行的基本块和进入时的 minstret，离开时清除。客户机在块中间退出 (写测试结束设备) 时
+// 来不及记录提前离开，由分析报告据此补记
+extern Block *block_running;
+extern uint64_t block_running_instret;
+
+// stop_pc: 基本块不会跨过该地址 (即 --end_address)，保证模拟器能在块边界停下
+void block_cache_init(uint64_t stop_pc);
+// 释放所有基本块 (系统复位时调用)
+void block_cache_reset(void);
+// 查找 pc 处的基本块，不存在或已失效时重新构建
+Block *block_lookup(CPU *cpu, uint64_t pc);
+// 查找 pc 处的基本块，上一个基本块完整执行完时先按它的出口预测；入口足够热时顺带组成超级块
+Block *block_next(CPU *cpu);
+// 超级块从侧出口离开，偏离过多时从入口块上摘下并释放
+void block_trace_side_exit(Block *head);
+// 基本块完整执行完 (没有提前离开)，下一次 block_next 从它链接到后继
+static inline void block_chain(Block *block) {
+    block_chain_from = block;
+}
+// 内存 [offset, offset + length) 被改写 (offset 相对 MEMORY_BASE_ADDR)：与之重叠的基本块在下次进入时
+// 重新取指校验。只看带 PAGE_FLAG_CODE 的页，正在执行的基本块被改写时在当前指令之后离开
+void block_cache_code_write(uint64_t offset, uint64_t length);
+// 记录一次提前离开基本块，executed 为已执行的条数
+void block_early_exit(Block *block, uint32_t executed);
+// 进入基本块：累加进入次数并记下正在执行的基本块
+static inline void block_enter(const CPU *cpu, Block *block) {
+    block->exec_count++;
+    block_running = block;
+    block_running_instret = cpu->csr.minstret;
+}
+static inline void block_leave(void) {
+    block_running = NULL;
+}
+// 在基本块中间退出时补记提前离开，instret 为退出时的 minstret
+void block_settle_running(uint64_t instret);
+// 基本块中第 index 条指令被执行的次数
+uint64_t block_inst_count(const Block *block, uint32_t index);
+// 遍历所有基本块
+void block_cache_foreach(void (*callback)(const Block *block, void *arg), void *arg);
+
+#endif //RISCV_SIMULATOR_BLOCK_H
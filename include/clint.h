@@ -8,18 +8,21 @@
 // 定义CLINT的MMIO基地址和大小
 #define CLINT_BASE_ADDR 0x2000000
 #define CLINT_SIZE 0x10000
-#define TIMER_INTERVAL_MS 10 // 定时器更新间隔（毫秒）
+// mtime 由虚拟时间推导：每退休 CLINT_INSTRET_PER_TICK 条指令 mtime 加 1
+#define CLINT_INSTRET_PER_TICK 10
 
 typedef struct {
     uint64_t msip[MAX_HARTS]; // 软件中断寄存器
     uint64_t mtimecmp[MAX_HARTS]; // 定时器比较寄存器
-    uint64_t mtime; // 定时器寄存器
+    uint64_t mtime_offset; // mtime = 虚拟时间 / CLINT_INSTRET_PER_TICK + mtime_offset，写 mtime 时调整
 } CLINT;
 
 CLINT* get_clint(void);
 void clint_init(CLINT *clint);
 uint64_t clint_read(uint64_t addr, uint32_t size);
 void clint_write(uint64_t addr, uint64_t value, uint32_t size);
-void *timer_loop(void *arg);
+uint64_t clint_get_mtime(CLINT *clint);
+// 按 compare 预约下一次定时器比较成立的虚拟时间，EVENT_NEVER 之类的最大值表示取消
+void clint_arm_timer(CLINT *clint, uint64_t compare);
 
 #endif // CLINT_H
@@ -0,0 +1,30 @@
+#ifndef RISCV_SIMULATOR_CONSOLE_H
+#define RISCV_SIMULATOR_CONSOLE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// 控制台：UART 发送的字符写入 stdout 或文件，经过大缓冲区后批量输出
+// 无界面模式下 CPU 线程直接写入；界面模式下 (--console) 由显示线程在刷新屏幕时一并写入
+
+#define CONSOLE_BUFFER_SIZE (1 << 20)
+
+extern bool console_enabled;
+extern FILE *console_file;
+
+// path 为 NULL 或 "-" 时写到 stdout
+int console_open(const char *path);
+void console_close(void);
+
+// 无界面模式下只由 CPU 线程调用
+static inline void console_putc(uint8_t c) {
+    putc_unlocked(c, console_file);
+}
+
+// 界面模式下由显示线程批量写入从 UART 发送环取出的字符
+static inline void console_write(const uint8_t *data, size_t length) {
+    fwrite(data, 1, length, console_file);
+}
+
+#endif //RISCV_SIMULATOR_CONSOLE_H
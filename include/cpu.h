@@ -17,13 +17,47 @@
 
 
 
+// 只保存已实现的 CSR，访问统一经过 csr.c 中按地址分发的读写处理函数
+// sstatus/sie/sip 是 mstatus/mie/mip 的视图，fflags/frm 是 fcsr 的视图，time 来自 CLINT，均不单独存储
+typedef struct {
+    // 机器模式
+    uint64_t mstatus;
+    uint64_t mie;
+    uint64_t mip;
+    uint64_t medeleg;
+    uint64_t mideleg;
+    uint64_t mtvec;
+    uint64_t mepc;
+    uint64_t mcause;
+    uint64_t mtval;
+    uint64_t mscratch;
+    uint64_t mcounteren;
+    uint64_t menvcfg;
+    uint64_t mhartid;
+    uint64_t mcycle_offset; // mcycle = minstret + mcycle_offset，写 mcycle 时调整
+    uint64_t minstret;
+    // 超级模式
+    uint64_t stvec;
+    uint64_t sepc;
+    uint64_t scause;
+    uint64_t stval;
+    uint64_t sscratch;
+    uint64_t scounteren;
+    uint64_t satp;
+    uint64_t stimecmp;
+    // 浮点
+    uint64_t fcsr;
+} CSRState;
+
+struct ShadowStack;
+
 typedef struct {
     uint64_t registers[32]; // 32个通用寄存器
-    uint64_t fregisters[32]; // 32个浮点寄存器
-    uint64_t csr[4096]; // 4096个CSR寄存器
     uint64_t pc;            // 程序计数器
     uint8_t priv;            // 当前特权级
     bool pc_updated;        // 程序计数器是否更新
+    CSRState csr;           // CSR 寄存器
+    uint64_t fregisters[32]; // 32个浮点寄存器
     uint64_t reserved_address; // 保留地址
     Memory *memory;
     MMU mmu;                 // 内存管理单元
@@ -34,6 +68,7 @@ typedef struct {
     PLIC * plic;               // 平台级中断控制器
     UART * uart;              // 串口
     int current_priority;    // 当前处理中断的优先级
+    struct ShadowStack *shadow_stack; // 影子调用栈，存储在采样器中 (见 sampler.h)
 } CPU;
 
 
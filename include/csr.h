@@ -35,6 +35,7 @@
 #define CSR_SCAUSE      0x142 // 异常原因
 #define CSR_STVAL       0x143 // 异常值
 #define CSR_SIP         0x144 // 中断挂起
+#define CSR_STIMECMP    0x14D // 超级模式定时器比较 (Sstc)
 #define CSR_SATP        0x180 // 地址转换和保护
 
 // 机器模式 CSRs
@@ -50,6 +51,7 @@
 #define CSR_MIE         0x304
 #define CSR_MTVEC       0x305
 #define CSR_MCOUNTEREN  0x306
+#define CSR_MENVCFG     0x30A // 机器模式环境配置
 
 #define CSR_MSCRATCH    0x340
 #define CSR_MEPC        0x341
@@ -63,6 +65,11 @@
 #define CSR_MCYCLEH     0xB80
 #define CSR_MINSTRETH   0xB82
 
+// 用户模式只读计数器 CSRs
+#define CSR_CYCLE       0xC00
+#define CSR_TIME        0xC01
+#define CSR_INSTRET     0xC02
+
 // 虚拟化相关 CSRs（如果实现支持虚拟化）
 #define CSR_VSSTATUS    0x200
 #define CSR_VSIE        0x204
@@ -86,6 +93,10 @@
 
 #define MAX_CSR_INDEX 4095
 
+// CSR 地址编码：csr[9:8] 为可访问的最低特权级，csr[11:10] == 3 表示只读
+#define CSR_MIN_PRIV(csr) (((csr) >> 8) & 0x3)
+#define CSR_IS_READ_ONLY(csr) ((((csr) >> 10) & 0x3) == 0x3)
+
 
 #define PRV_U 0 // User
 #define PRV_S 1 // Supervisor
@@ -106,13 +117,21 @@
 #define SIE_SEIE (1 << 9)  // Supervisor External Interrupt Enable
 
 // ECALL 异常代码
+#define CAUSE_INSTRUCTION_ACCESS_FAULT 1
 #define CAUSE_ILLEGAL_INSTRUCTION 2
 #define CAUSE_BREAKPOINT       3
 #define CAUSE_LOAD_ACCESS_FAULT 5
+#define CAUSE_STORE_ACCESS_FAULT 7
 #define CAUSE_USER_ECALL       8
 #define CAUSE_SUPERVISOR_ECALL 9
+#define CAUSE_INSTRUCTION_PAGE_FAULT 12
+#define CAUSE_LOAD_PAGE_FAULT  13
+#define CAUSE_STORE_PAGE_FAULT 15
 #define CAUSE_EXTERNAL_INTERRUPT_BASE 0x8000000000000000L
+#define CAUSE_SUPERVISOR_SOFTWARE_INTERRUPT (CAUSE_EXTERNAL_INTERRUPT_BASE + 1)
 #define CAUSE_MACHINE_SOFTWARE_INTERRUPT (CAUSE_EXTERNAL_INTERRUPT_BASE + 3)
+#define CAUSE_SUPERVISOR_TIMER_INTERRUPT (CAUSE_EXTERNAL_INTERRUPT_BASE + 5)
+#define CAUSE_SUPERVISOR_EXTERNAL_INTERRUPT (CAUSE_EXTERNAL_INTERRUPT_BASE + 9)
 #define CAUSE_MACHINE_TIMER_INTERRUPT (CAUSE_EXTERNAL_INTERRUPT_BASE + 7)
 #define CAUSE_MACHINE_EXTERNAL_INTERRUPT (CAUSE_EXTERNAL_INTERRUPT_BASE + 11)
 #define CAUSE_HYPERVISOR_ECALL 10
@@ -132,30 +151,85 @@
 #define OPCODE_SRET 0x102
 #define OPCODE_URET 0x002
 #define OPCODE_WFI 0x105
-
-#define PRIORITY_MACHINE_SOFTWARE_INTERRUPT 1
-#define PRIORITY_MACHINE_TIMER_INTERRUPT 2
-#define PRIORITY_MACHINE_EXTERNAL_INTERRUPT 3
+// SYSTEM 指令中带 rs1/rs2 的地址翻译屏障，按 funct7 区分
+#define FUNCT7_SFENCE_VMA 0x09
+#define FUNCT7_SINVAL_VMA 0x0B
+#define FUNCT7_SFENCE_INVAL 0x0C  // rs2 = 0: SFENCE.W.INVAL, rs2 = 1: SFENCE.INVAL.IR
+
+// 数值越大优先级越高，顺序与特权级规范一致：MEI > MSI > MTI > SEI > SSI > STI
+#define PRIORITY_SUPERVISOR_TIMER_INTERRUPT 1
+#define PRIORITY_SUPERVISOR_SOFTWARE_INTERRUPT 2
+#define PRIORITY_SUPERVISOR_EXTERNAL_INTERRUPT 3
+#define PRIORITY_MACHINE_TIMER_INTERRUPT 4
+#define PRIORITY_MACHINE_SOFTWARE_INTERRUPT 5
+#define PRIORITY_MACHINE_EXTERNAL_INTERRUPT 6
 
 #define MSTATUS_MPP (3 << 11)
 #define MSTATUS_MPIE (1 << 7)
+#define MSTATUS_MPRV (1 << 17)
+#define MSTATUS_TVM (1 << 20)
+#define MSTATUS_TW (1 << 21)
+#define MSTATUS_TSR (1 << 22)
+#define MSTATUS_UXL (3ULL << 32)
+#define MSTATUS_SXL (3ULL << 34)
+#define MSTATUS_SD (1ULL << 63)
 
 #define SSTATUS_SPIE (1 << 5)
 #define SSTATUS_SPP (1 << 8)
+#define SSTATUS_FS (3 << 13)
+#define SSTATUS_SUM (1 << 18)
+#define SSTATUS_MXR (1 << 19)
+// sstatus 是 mstatus 的受限视图，只暴露以下字段
+#define SSTATUS_MASK (SSTATUS_SIE | SSTATUS_SPIE | SSTATUS_SPP | SSTATUS_FS | SSTATUS_SUM | SSTATUS_MXR)
+
+// mstatus 中软件可写的字段，其余字段只读 (UXL/SXL 固定为 64 位，SD 由 FS 推导)
+#define MSTATUS_WRITE_MASK (SSTATUS_MASK | MSTATUS_MIE | MSTATUS_MPIE | MSTATUS_MPP | MSTATUS_MPRV | \
+                            MSTATUS_TVM | MSTATUS_TW | MSTATUS_TSR)
+#define MSTATUS_XLEN_64 ((2ULL << 32) | (2ULL << 34))
+
+// misa: RV64 + I/M/A/F/S/U
+#define MISA_EXT(ext) (1ULL << ((ext) - 'A'))
+#define MISA_VALUE ((2ULL << 62) | MISA_EXT('I') | MISA_EXT('M') | MISA_EXT('A') | MISA_EXT('F') | \
+                    MISA_EXT('S') | MISA_EXT('U'))
+
+// satp.MODE：只支持 Bare 和 Sv39
+#define SATP_MODE_SHIFT 60
+#define SATP_MODE_BARE 0ULL
+#define SATP_MODE_SV39 8ULL
+
+// mcounteren/scounteren 中 CY/TM/IR 位
+#define COUNTEREN_MASK 0x7
+#define COUNTEREN_TM (1 << 1)
+
+// xtvec 的模式字段：Vectored 模式下中断跳转到 BASE + 4 * cause
+#define TVEC_MODE_MASK 0x3
+#define TVEC_MODE_VECTORED 0x1
 
 
 // MIP 寄存器中的中断挂起位
 #define MIP_MSIP (1 << 3)  // Machine Software Interrupt Pending
 #define MIP_MTIP (1 << 7)  // Machine Timer Interrupt Pending
 #define MIP_MEIP (1 << 11) // Machine External Interrupt Pending
+#define MIP_STIP (1 << 5)  // Supervisor Timer Interrupt Pending (Sstc 下由 stimecmp 驱动)
 
 // SIP 寄存器中的中断挂起位
 #define SIP_SSIP (1 << 1)  // Supervisor Software Interrupt Pending
 #define SIP_STIP (1 << 5)  // Supervisor Timer Interrupt Pending
 #define SIP_SEIP (1 << 9)  // Supervisor External Interrupt Pending
 
+// menvcfg 中的 Sstc 使能位：置位后 stimecmp 可用，STIP 由 time >= stimecmp 直接驱动
+#define MENVCFG_STCE (1ULL << 63)
+#define MENVCFG_FIOM (1ULL << 0)
+
+// fcsr 由 frm[7:5] 和 fflags[4:0] 组成
+#define FCSR_FFLAGS_MASK 0x1F
+#define FCSR_FRM_SHIFT 5
+#define FCSR_FRM_MASK 0x7
+
+// 不做特权级检查的内部访问接口 (供 MRET/SRET 等使用)，未实现的 CSR 读为 0、写被忽略
 uint64_t read_csr(CPU *cpu, uint32_t csr);
 void write_csr(CPU *cpu, uint32_t csr, uint64_t value);
+void update_timer_interrupt_pending(CPU *cpu);
 
 
 void execute_system_instruction(CPU *cpu, uint32_t instruction);
@@ -0,0 +1,87 @@
+#ifndef RISCV_SIMULATOR_DEBUG_H
+#define RISCV_SIMULATOR_DEBUG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// 断点和数据观察点
+// 有断点的页在 memory_page_flags 中带 PAGE_FLAG_BREAKPOINT，只有入口所在页或结尾所在页带标志的基本块
+// 才逐条检查 pc，其余基本块照常执行；观察点所在页带 PAGE_FLAG_WATCH，只有访问这些页的读写走检查路径。
+// 观察点按物理页号挂在散列桶上，检查时只看被访问页上的观察点，几百个观察点同时生效也不用逐个比较。
+// 命中后置位 debug_stop_pending，执行循环在当前指令之后离开基本块，由模拟器在块边界停下
+
+#define DEBUG_MAX_BREAKPOINTS 64
+#define DEBUG_MAX_WATCHPOINTS 1024
+#define DEBUG_WATCH_LINKS 4096      // 观察点覆盖的页数总和上限
+#define DEBUG_WATCH_BUCKETS 1024    // 按页号散列，必须是 2 的幂
+#define DEBUG_NO_PC UINT64_MAX
+
+typedef enum {
+    DEBUG_STOP_NONE,
+    DEBUG_STOP_ATTACH,      // 调试器连接时的初始停止
+    DEBUG_STOP_BREAKPOINT,
+    DEBUG_STOP_WATCHPOINT,
+    DEBUG_STOP_STEP,
+    DEBUG_STOP_INTERRUPT,   // 调试器请求暂停 (Ctrl-C)
+    DEBUG_STOP_HISTORY_BEGIN, // 反向执行到达记录的开头
+} DebugStopReason;
+
+typedef enum {
+    WATCH_WRITE = 1,
+    WATCH_READ = 2,
+    WATCH_ACCESS = 3,
+    WATCH_CHANGE = 4,       // 写入的值和原值不同时才命中
+} WatchType;
+
+// 同一地址可以同时有软件断点和硬件断点，两种都删掉后断点才消失
+typedef enum {
+    BREAKPOINT_SOFTWARE = 1,
+    BREAKPOINT_HARDWARE = 2,
+} BreakpointType;
+
+typedef struct {
+    DebugStopReason reason;
+    uint64_t address;       // 断点的 pc 或命中观察点的数据地址
+    WatchType watch_type;
+    uint64_t pc;            // 发出停止请求时正在执行的指令
+    uint64_t instret;
+    // 以下只对观察点有效：触发的那次访问
+    uint64_t access_address;
+    uint32_t access_size;
+    bool access_write;
+    uint64_t old_value;     // 访问前内存中的值
+    uint64_t new_value;     // 写入的值，读访问时等于 old_value
+} DebugStop;
+
+extern bool debug_stop_pending;
+extern DebugStop debug_stop;
+extern int debug_breakpoint_count;
+
+// 在下一个块边界停下，已有未处理的停止请求时保留先到的原因
+void debug_request_stop(DebugStopReason reason, uint64_t address, WatchType watch_type);
+// 只填写停止原因，不请求停止 (反向执行改写要报告的原因)
+void debug_set_stop(DebugStopReason reason, uint64_t address, WatchType watch_type);
+
+bool debug_breakpoint_insert(uint64_t pc, BreakpointType type);
+bool debug_breakpoint_remove(uint64_t pc, BreakpointType type);
+// pc 处断点的类型 (BreakpointType 按位或)，没有断点时返回 0
+uint32_t debug_breakpoint_types(uint64_t pc);
+// pc 处有断点且不是刚从这里恢复执行
+bool debug_breakpoint_hit(uint64_t pc);
+// 从 pc 恢复执行：pc 处的断点对第一条指令不生效
+void debug_resume(uint64_t pc);
+
+bool debug_watchpoint_insert(uint64_t address, uint64_t length, WatchType type);
+bool debug_watchpoint_remove(uint64_t address, uint64_t length, WatchType type);
+// memory_read/memory_write 访问带 PAGE_FLAG_WATCH 的页时调用，offset 相对 MEMORY_BASE_ADDR，
+// 写访问时 value 是将要写入的值 (此时内存里还是原值)
+void debug_watch_access(uint64_t offset, uint32_t size, bool is_write, uint64_t value);
+// 解析 --watch 参数并插入观察点：逗号分隔的 <r|w|a|c>:<地址>[+<长度>]，长度默认 4
+int debug_watch_open(const char *spec);
+// 把停止原因格式化成一行文字，供界面状态栏和无界面模式的日志使用
+void debug_format_stop(const DebugStop *stop, char *buffer, size_t size);
+
+void debug_clear_all(void);
+
+#endif //RISCV_SIMULATOR_DEBUG_H
@@ -32,6 +32,34 @@
 #define STACK_WIN_WIDTH 33
 #define STACK_WIN_HEIGHT 40
 
+#define DISPLAY_SNAPSHOT_INTERVAL_MS 100 // 快速模式下刷新寄存器等窗口的间隔
+
+#define CACHE_MAX_LINES 48
+#define CACHE_MAX_WIDTH 128
+
+typedef struct {
+    bool valid;
+    int attr;
+    char text[CACHE_MAX_WIDTH];
+} CachedLine;
+
+// 窗口内容缓存，只重画发生变化的行
+typedef struct {
+    WINDOW *win;
+    bool dirty;
+    CachedLine lines[CACHE_MAX_LINES];
+} WindowCache;
+
+typedef struct {
+    WindowCache reg;
+    WindowCache status;
+    WindowCache uart;
+    WindowCache clint;
+    WindowCache plic;
+    WindowCache source;
+    WindowCache stack;
+} DisplayWindows;
+
 typedef struct {
     CPU *cpu;
     Memory *memory;
@@ -0,0 +1,72 @@
+#ifndef RISCV_SIMULATOR_EVENT_H
+#define RISCV_SIMULATOR_EVENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu.h"
+
+// 设备事件调度器
+// 虚拟时间以退休指令数计 (minstret 加上偏移，软件改写 minstret 或 WFI 快进时调整偏移)，
+// 设备把定时器到期、UART 字符超时、磁盘完成等回调挂到按截止时间排列的最小堆上，
+// CPU 线程在基本块边界只比较一次最早的截止时间。设备时序因此与宿主机速度无关，可以快于实时运行
+
+#define EVENT_NEVER UINT64_MAX
+#define EVENT_MAX_TIMERS 64
+
+typedef void (*EventCallback)(CPU *cpu, void *opaque);
+
+typedef struct {
+    uint64_t deadline;      // 到期的虚拟时间
+    EventCallback callback;
+    void *opaque;
+    const char *name;
+    int index;              // 在堆中的位置，-1 表示未预约
+} EventTimer;
+
+#define EVENT_TIMER_INIT(timer_name, timer_callback, timer_opaque) \
+    { .deadline = EVENT_NEVER, .callback = (timer_callback), .opaque = (timer_opaque), \
+      .name = (timer_name), .index = -1 }
+
+extern uint64_t event_clock_bias;
+extern uint64_t event_next_deadline;
+// WFI 快进累计跳过的虚拟时间，虚拟时间减去它就是实际执行的指令数
+extern uint64_t event_idle_time;
+
+// 记录/回放检查点保存的队列状态
+typedef struct {
+    uint64_t clock_bias;
+    uint64_t idle_time;
+    int count;
+    EventTimer *timers[EVENT_MAX_TIMERS];
+    uint64_t deadlines[EVENT_MAX_TIMERS];
+} EventState;
+
+static inline uint64_t event_now(const CPU *cpu) {
+    return cpu->csr.minstret + event_clock_bias;
+}
+
+// 预约 (或改期) 定时器，deadline 为虚拟时间；已在队列中时原地调整
+void event_timer_mod(EventTimer *timer, uint64_t deadline);
+void event_timer_del(EventTimer *timer);
+
+static inline bool event_timer_pending(const EventTimer *timer) {
+    return timer->index >= 0;
+}
+
+// 清空队列并把虚拟时钟归零 (系统复位时调用)
+void event_reset(void);
+void event_run_due(CPU *cpu);
+// WFI：没有使能且挂起的中断时把虚拟时钟快进到最早的截止时间
+void event_skip_idle(CPU *cpu);
+void event_save(EventState *state);
+// 换成保存时的定时器集合，之后预约的定时器被取消
+void event_restore(const EventState *state);
+
+// CPU 线程在块边界调用，没有到期事件时只有一次比较
+static inline void event_poll(CPU *cpu) {
+    if (event_now(cpu) >= event_next_deadline) {
+        event_run_due(cpu);
+    }
+}
+
+#endif //RISCV_SIMULATOR_EVENT_H
@@ -3,6 +3,7 @@
 #include "cpu.h"
 
 void raise_exception(CPU *cpu, uint64_t cause);
+void raise_exception_with_tval(CPU *cpu, uint64_t cause, uint64_t tval);
 bool handle_interrupt(CPU *cpu);
 
 
@@ -0,0 +1,18 @@
+#ifndef RISCV_SIMULATOR_FINISHER_H
+#define RISCV_SIMULATOR_FINISHER_H
+
+#include <stdint.h>
+
+// 测试结束设备 (与 QEMU virt 的 sifive_test 兼容)
+// 客户程序写入 FINISHER_PASS 表示成功，写入 (code << 16) | FINISHER_FAIL 以 code 作为退出码退出
+#define FINISHER_BASE_ADDR 0x100000
+#define FINISHER_SIZE 0x1000
+
+#define FINISHER_FAIL  0x3333
+#define FINISHER_PASS  0x5555
+#define FINISHER_RESET 0x7777
+
+uint64_t finisher_read(uint64_t address, uint32_t size);
+void finisher_write(uint64_t address, uint64_t value, uint32_t size);
+
+#endif //RISCV_SIMULATOR_FINISHER_H
@@ -0,0 +1,61 @@
+#ifndef RISCV_SIMULATOR_FRAMEBUFFER_H
+#define RISCV_SIMULATOR_FRAMEBUFFER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 线性帧缓冲区
+// 像素放在客户机内存里，由驱动通过一小块控制寄存器给出地址和几何参数。使能后帧缓冲区覆盖的页打上
+// PAGE_FLAG_FRAMEBUFFER，写入这些页时只在位图里记一个脏页；导出定时器到期 (或驱动写 FLUSH) 时
+// 只把脏页拷到 POSIX 共享内存，并通过通知管道告诉查看器哪些行变了。没有写入时不导出也不唤醒
+
+#define FRAMEBUFFER_BASE_ADDR 0x10004000
+#define FRAMEBUFFER_SIZE 0x100
+
+// 寄存器偏移
+#define FB_REG_ID      0x00 // 只读，"FB01"
+#define FB_REG_WIDTH   0x04
+#define FB_REG_HEIGHT  0x08
+#define FB_REG_STRIDE  0x0c // 每行字节数
+#define FB_REG_FORMAT  0x10
+#define FB_REG_ADDR_LO 0x18 // 像素在客户机内存中的物理地址
+#define FB_REG_ADDR_HI 0x1c
+#define FB_REG_ENABLE  0x20 // 写 1 使能，地址或几何参数不合法时读回 0
+#define FB_REG_FLUSH   0x24 // 写任意值立即导出
+#define FB_REG_FRAME   0x28 // 只读，已导出的帧数
+
+#define FB_ID 0x31304246
+#define FB_FORMAT_XRGB8888 0
+#define FB_MAX_BYTES (32u << 20)
+#define FB_FRAME_INSTRET 1000000 // 第一次写入后多久导出一帧 (虚拟时间)
+
+// 共享内存布局：头部之后 FB_SHM_HEADER_SIZE 处是像素，行距与客户机相同
+#define FB_SHM_HEADER_SIZE 4096
+
+typedef struct {
+    uint32_t magic;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t format;
+    uint32_t frame;   // 像素拷贝完成后才递增
+} FramebufferShmHeader;
+
+// 通知管道里的记录：一次导出的所有记录一次写入，脏区域按整行给出
+typedef struct {
+    uint32_t frame;
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+} FramebufferDamage;
+
+// spec 形如 "<共享内存名>[:<通知管道路径>]"
+int framebuffer_open(const char *spec);
+void framebuffer_reset(void);
+// memory_write 在带 PAGE_FLAG_FRAMEBUFFER 的页上调用，offset 相对 MEMORY_BASE_ADDR
+void framebuffer_mark_dirty(uint64_t offset, uint32_t size);
+uint64_t framebuffer_read(uint64_t address, uint32_t size);
+void framebuffer_write(uint64_t address, uint64_t value, uint32_t size);
+
+#endif //RISCV_SIMULATOR_FRAMEBUFFER_H
@@ -0,0 +1,28 @@
+#ifndef RISCV_SIMULATOR_GDBSTUB_H
+#define RISCV_SIMULATOR_GDBSTUB_H
+
+#include <stdbool.h>
+#include "cpu.h"
+
+// GDB 远程串行协议 (RSP) 调试桩
+// 启动时在本机 TCP 端口或 UNIX 套接字上等待调试器连接，连接后 CPU 停在第一条指令。
+// 停止期间 CPU 线程自己读写套接字处理命令；运行期间不另起线程，由虚拟时间定时器每 GDB_POLL_INSTRET
+// 条指令非阻塞地检查一次调试器是否发来 Ctrl-C。断点和观察点见 debug.h
+
+#define GDB_POLL_INSTRET (1 << 20)
+#define GDB_PACKET_SIZE 4096
+
+// 单步请求：模拟器执行一条指令后报告停止
+extern bool gdb_stepping;
+
+// target 为端口号时监听 127.0.0.1，否则视为 UNIX 套接字路径；阻塞到调试器连上
+int gdb_open(const char *target);
+bool gdb_connected(void);
+// CPU 线程在块边界处理 debug_stop_pending：向调试器报告并处理命令，直到继续、单步或断开
+void gdb_handle_stop(CPU *cpu);
+// 系统复位后重新预约轮询定时器
+void gdb_reset(void);
+// 客户机通过测试结束设备退出时告诉调试器
+void gdb_notify_exit(int code);
+
+#endif //RISCV_SIMULATOR_GDBSTUB_H
@@ -2,9 +2,38 @@
 #define RISC_SIMULATOR_HELPER_H
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// 命令行选项
+typedef struct {
+    const char *input_file;   // 输入文件
+    size_t load_address;      // 加载地址
+    size_t end_address;       // 结束地址
+    const char *log_file;     // 日志文件
+    int log_level;            // 运行时日志级别
+    uint32_t log_categories;  // 启用的日志分类位图
+    const char *trace_file;   // 二进制执行轨迹输出文件，NULL 表示不记录
+    const char *profile_file; // 指令组合 / 热点基本块报告文件，NULL 表示不分析
+    const char *symbol_file;  // 客户程序 ELF，用于符号化
+    const char *sample_file;  // pc 采样 folded stack 输出文件，NULL 表示不采样
+    int sample_hz;            // 采样频率
+    bool headless;            // 无界面批处理模式
+    const char *console_file; // UART 输出另存的文件；无界面模式下 NULL 表示 stdout
+    const char *uart_input_file; // UART 接收数据来源文件或管道，"-" 表示 stdin
+    const char *disk_file;    // virtio 块设备的磁盘镜像，NULL 表示不挂载
+    const char *net_spec;     // virtio 网卡的本机套接字和对端套接字列表，逗号分隔，NULL 表示不启用
+    const char *vconsole_spec; // virtio 控制台端口列表，每项 [名字=]输出[:输入]，NULL 表示不启用
+    const char *framebuffer_spec; // 帧缓冲区导出的共享内存名和可选的通知管道，NULL 表示不启用
+    const char *gdb_target;       // GDB 调试桩监听的本机端口或 UNIX 套接字路径，NULL 表示不启用
+    const char *watch_spec;       // 启动时设置的数据观察点列表，逗号分隔，NULL 表示没有
+    const char *record_file;      // 记录外部输入的日志文件，NULL 表示不记录
+    const char *replay_file;      // 回放的日志文件，NULL 表示不回放
+    const char *stats_file;       // 退出时写入运行统计 (JSON) 的文件，"-" 表示 stderr，NULL 表示不统计
+} Options;
 
 void print_usage(const char *program_name);
 
-int parse_arguments(int argc, char *argv[], const char **input_file, size_t *load_address, size_t *end_address);
+int parse_arguments(int argc, char *argv[], Options *options);
 
-#endif // RISC_SIMULATOR_HELPER_H
\ No newline at end of file
+#endif // RISC_SIMULATOR_HELPER_H
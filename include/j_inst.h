@@ -7,5 +7,10 @@
 
 #include "cpu.h"
 
+// 调用约定中的链接寄存器：x1 (ra) 和 x5 (t0)
+static inline bool is_link_register(uint32_t reg) {
+    return reg == 1 || reg == 5;
+}
+
 void execute_j_type_instruction(CPU *cpu, uint32_t instruction);
 #endif //RISCSIMULATOR_J_INST_H
@@ -0,0 +1,98 @@
+#ifndef RISCV_SIMULATOR_LOG_H
+#define RISCV_SIMULATOR_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 异步日志：调用线程只把格式化后的记录写入本线程的无锁环形缓冲区，
+// 由后台写线程批量写入日志文件，热路径上不再有 fopen/fclose 等系统调用
+
+#define LOG_DEFAULT_FILE "riscv_simulator_output.log"
+
+// 日志级别 (数值越大越详细)
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+#define LOG_LEVEL_TRACE 5
+
+// 编译期日志级别，高于该级别的日志调用在编译时被完全移除
+// 可通过 -DLOG_COMPILE_LEVEL=LOG_LEVEL_INFO 等方式调整
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+// 日志分类，可在运行时按位开关
+typedef enum {
+    LOG_CAT_CPU,        // 指令执行
+    LOG_CAT_TRAP,       // 异常与中断
+    LOG_CAT_PLIC,
+    LOG_CAT_CLINT,
+    LOG_CAT_UART,
+    LOG_CAT_KEYBOARD,
+    LOG_CAT_MEMORY,
+    LOG_CAT_DISPLAY,
+    LOG_CAT_COUNT
+} LogCategory;
+
+#define LOG_CAT_ALL ((1u << LOG_CAT_COUNT) - 1)
+
+// 运行时过滤条件，由 log_init 设置
+extern int log_runtime_level;
+extern uint32_t log_runtime_categories;
+
+static inline bool log_enabled(int level, LogCategory category) {
+    return level <= log_runtime_level && (log_runtime_categories & (1u << category)) != 0;
+}
+
+// 启动后台写线程；path 为 NULL 时使用 LOG_DEFAULT_FILE
+int log_init(const char *path, int level, uint32_t categories);
+// 排空所有缓冲区并停止后台写线程 (log_init 会通过 atexit 自动注册)
+void log_shutdown(void);
+void log_write(int level, LogCategory category, const char *format, ...)
+        __attribute__((format(printf, 3, 4)));
+
+// 解析 "error"/"warn"/"info"/"debug"/"trace"/"none"，失败返回 -1
+int log_parse_level(const char *name);
+// 解析逗号分隔的分类列表，如 "trap,plic,uart" 或 "all"，失败返回 0
+uint32_t log_parse_categories(const char *list);
+
+#define LOG_AT(level, category, ...)                     \
+    do {                                                 \
+        if (log_enabled((level), (category))) {          \
+            log_write((level), (category), __VA_ARGS__); \
+        }                                                \
+    } while (0)
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(category, ...) LOG_AT(LOG_LEVEL_ERROR, category, __VA_ARGS__)
+#else
+#define LOG_ERROR(category, ...) ((void) 0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(category, ...) LOG_AT(LOG_LEVEL_WARN, category, __VA_ARGS__)
+#else
+#define LOG_WARN(category, ...) ((void) 0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(category, ...) LOG_AT(LOG_LEVEL_INFO, category, __VA_ARGS__)
+#else
+#define LOG_INFO(category, ...) ((void) 0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(category, ...) LOG_AT(LOG_LEVEL_DEBUG, category, __VA_ARGS__)
+#else
+#define LOG_DEBUG(category, ...) ((void) 0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_TRACE
+#define LOG_TRACE(category, ...) LOG_AT(LOG_LEVEL_TRACE, category, __VA_ARGS__)
+#else
+#define LOG_TRACE(category, ...) ((void) 0)
+#endif
+
+#endif //RISCV_SIMULATOR_LOG_H
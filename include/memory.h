@@ -8,6 +8,19 @@
 #define MEMORY_SIZE  (128 * 1024 * 1024)
 #define MEMORY_END_ADDR (MEMORY_BASE_ADDR + MEMORY_SIZE)
 
+// 内存页标志：写入带标志的页时走 memory_store_hook，没有标志的页只多一次字节比较
+#define MEMORY_PAGE_SHIFT 12
+#define MEMORY_PAGE_SIZE (1u << MEMORY_PAGE_SHIFT)
+#define MEMORY_NUM_PAGES (MEMORY_SIZE >> MEMORY_PAGE_SHIFT)
+#define PAGE_FLAG_FRAMEBUFFER 0x01 // 帧缓冲区，写入时记录脏页
+#define PAGE_FLAG_BREAKPOINT  0x02 // 页上有断点，基本块入口检查
+#define PAGE_FLAG_WATCH       0x04 // 页上有数据观察点，读写都检查
+#define PAGE_FLAG_SNAPSHOT    0x08 // 最近的检查点之后还没写过，写入前先保存原内容
+#define PAGE_FLAG_CODE        0x10 // 页上有缓存的基本块，写入时让重叠的基本块失效
+
+// 多一项，跨越内存末尾的写入检查结尾页时不会越界
+extern uint8_t memory_page_flags[MEMORY_NUM_PAGES + 1];
+
 
 typedef struct {
     uint8_t *data;
@@ -19,6 +32,8 @@ void memory_free(Memory *memory);
 uint32_t load_inst(Memory *memory, uint64_t address);
 void memory_write(Memory *memory, uint64_t address, uint64_t value, uint32_t size);
 uint64_t memory_read(Memory *memory, uint64_t address, uint32_t size, bool is_signed);
+// 给 [offset, offset + length) 覆盖的页加上或去掉标志，offset 相对 MEMORY_BASE_ADDR
+void memory_set_page_flags(uint64_t offset, uint64_t length, uint8_t flags, bool set);
 
 
 #endif // MEMORY_H
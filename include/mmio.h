@@ -6,8 +6,13 @@
 #include "plic.h"
 #include "clint.h"
 #include "uart.h"
+#include "finisher.h"
+#include "virtio_blk.h"
+#include "virtio_net.h"
+#include "virtio_console.h"
+#include "framebuffer.h"
 
-#define NUM_MMIO_REGIONS 3
+#define NUM_MMIO_REGIONS 8
 
 typedef struct {
     uint64_t base_addr;
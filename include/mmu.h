@@ -21,5 +21,7 @@ typedef struct {
 
 void init_mmu(MMU *mmu);
 void flush_tlb(MMU *mmu);
+// 刷新 vaddr 所在页、地址空间 asid 的条目，任一参数为 TLB_MATCH_ALL 时不比较该项
+#define TLB_MATCH_ALL UINT64_MAX
 void flush_tlb_entry(MMU *mmu, uint64_t vaddr, uint64_t asid);
 #endif //RISCSIMULATOR_MMU_H
@@ -14,31 +14,49 @@
 #define PLIC_PRIORITY_OFFSET 0x000000
 #define PLIC_PENDING_OFFSET  0x001000
 #define PLIC_ENABLE_BASE   0x002000
+#define PLIC_ENABLE_STRIDE 0x80
 #define PLIC_THRESHOLD_BASE 0x200000
 #define PLIC_THRESHOLD_STRIDE 0x1000
 #define PLIC_CLAIM_BASE   0x200004
 #define PLIC_CLAIM_STRIDE 0x1000
 
-#define MAX_INTERRUPTS 128
+// 中断源个数 (含保留的 0 号源)，规范上限为 1024 (即 1..1023 可用)，可在编译时用 -DPLIC_NUM_SOURCES=... 调整
+#ifndef PLIC_NUM_SOURCES
+#define PLIC_NUM_SOURCES 1024
+#endif
+#if PLIC_NUM_SOURCES > 1024 || PLIC_NUM_SOURCES % 32 != 0
+#error "PLIC_NUM_SOURCES must be a multiple of 32 and at most 1024"
+#endif
+#define PLIC_WORDS (PLIC_NUM_SOURCES / 32)
 
+// 上下文：目前每个 hart 一个上下文 (机器模式)，上下文号即 hart 号
+#define PLIC_NUM_CONTEXTS MAX_HARTS
 
-#define PLIC_ENABLE(hart) (PLIC_ENABLE_BASE + (hart) * 0x80)
-#define PLIC_THRESHOLD_OFFSET(hart) (PLIC_THRESHOLD_BASE + (hart) * 0x1000)
-#define PLIC_CLAIM_OFFSET(hart) (PLIC_CLAIM_BASE + (hart) * 0x1000)
+#define PLIC_ENABLE(context) (PLIC_ENABLE_BASE + (context) * PLIC_ENABLE_STRIDE)
+#define PLIC_THRESHOLD_OFFSET(context) (PLIC_THRESHOLD_BASE + (context) * PLIC_THRESHOLD_STRIDE)
+#define PLIC_CLAIM_OFFSET(context) (PLIC_CLAIM_BASE + (context) * PLIC_CLAIM_STRIDE)
 
 #define UART0_IRQ 10
+
+// 每个上下文的状态
+typedef struct {
+    uint32_t enable[PLIC_WORDS]; // 使能位图
+    uint32_t threshold;          // 阈值，优先级必须严格大于阈值才能送达
+    uint32_t claim_complete;     // 最近一次 claim 到的中断号
+    // 缓存的最佳候选：pending & enable 中优先级最高 (同优先级取编号最小) 且超过阈值的中断号，0 表示没有
+    // 只有 pending / enable / priority / threshold 变化时才置 dirty，下次检查时重新扫描
+    uint32_t best_irq;
+    bool dirty;
+} PLICContext;
+
 // PLIC数据结构
 typedef struct {
     // 每个中断源都有0-7的优先级，0表示禁用，7表示最高优先级，会和阈值寄存器比较
-    uint32_t priority[MAX_INTERRUPTS];
-    // pending 是关于中断挂起的位图，每个中断源有一个位，1表示挂起，0表示未挂起，所以共需要128位，即128/32=4个32位的uint32_t
-    uint32_t pending[MAX_INTERRUPTS / 32];
+    uint32_t priority[PLIC_NUM_SOURCES];
+    // pending 是关于中断挂起的位图，每个中断源有一个位，1表示挂起，0表示未挂起
+    uint32_t pending[PLIC_WORDS];
 
-    uint32_t threshold[MAX_HARTS]; // 每个hart有一个阈值寄存器，用于比较优先级
-
-    uint32_t enable[MAX_HARTS][MAX_INTERRUPTS / 32]; // 每个hart有一个128位的enable位图
-
-    uint32_t claim_complete[MAX_HARTS]; // 每个hart有一个claim/complete寄存器
+    PLICContext context[PLIC_NUM_CONTEXTS];
 } PLIC;
 
 
@@ -52,10 +70,24 @@ uint64_t plic_read(uint64_t address, uint32_t size);
 
 // 写入PLIC寄存器
 void plic_write(uint64_t address, uint64_t value, uint32_t size);
-uint32_t plic_claim_interrupt(uint32_t hart_id);
-void plic_complete_interrupt(uint32_t hart_id, int irq);
-bool plic_check_interrupt(PLIC *plic, int hart_id);
-
+void plic_set_pending(PLIC *plic, uint32_t irq);
+uint32_t plic_claim_interrupt(uint32_t context);
+void plic_complete_interrupt(uint32_t context, int irq);
+void plic_update_best(PLIC *plic, uint32_t context);
+
+// 候选未变化时只读一次缓存
+static inline uint32_t plic_best_interrupt(PLIC *plic, uint32_t context) {
+    PLICContext *ctx = &plic->context[context];
+    if (ctx->dirty) {
+        plic_update_best(plic, context);
+    }
+    return ctx->best_irq;
+}
+
+// handle_interrupt 在 MEIP 置位时调用
+static inline bool plic_check_interrupt(PLIC *plic, int context) {
+    return plic_best_interrupt(plic, (uint32_t) context) != 0;
+}
 
 
 #endif // PLIC_H
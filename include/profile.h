@@ -0,0 +1,35 @@
+#ifndef RISCV_SIMULATOR_PROFILE_H
+#define RISCV_SIMULATOR_PROFILE_H
+
+#include <signal.h>
+#include <stdbool.h>
+#include "block.h"
+
+// 指令组合 / 热点基本块分析
+// 计数全部来自基本块缓存的 exec_count (每次进入基本块加一)，热路径上没有额外开销，
+// 报告时再按块内指令展开为按 opcode 类别和 funct3/funct7 变体的统计
+
+#define PROFILE_TOP_BLOCKS 32
+
+extern bool profile_enabled;
+extern volatile sig_atomic_t profile_dump_requested;
+
+// 开启分析：退出时以及收到 SIGUSR1 / 按下 'p' 时把报告写入 path
+int profile_open(const char *path);
+// 立即生成报告 (只应在 CPU 线程的基本块边界或退出时调用)
+void profile_dump(void);
+// 请求在下一个基本块边界生成报告，可在信号处理函数和其他线程中调用
+static inline void profile_request_dump(void) {
+    profile_dump_requested = 1;
+}
+// CPU 线程在基本块边界调用
+static inline void profile_poll(void) {
+    if (profile_dump_requested) {
+        profile_dump_requested = 0;
+        profile_dump();
+    }
+}
+// 基本块的指令被替换前，保留其指令组合统计
+void profile_block_retired(const Block *block);
+
+#endif //RISCV_SIMULATOR_PROFILE_H
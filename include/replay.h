@@ -0,0 +1,88 @@
+#ifndef RISCV_SIMULATOR_REPLAY_H
+#define RISCV_SIMULATOR_REPLAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "cpu.h"
+#include "event.h"
+
+// 外部输入的记录与回放，以及基于检查点的反向执行
+// 设备时序都以虚拟时间 (event_now) 计，事件在精确的虚拟时间触发，唯一的不确定来源是宿主机送来的输入。
+// 记录模式把每次送达客户机的输入连同当时的虚拟时间写进日志；回放模式不接收宿主机输入，
+// 在相同的虚拟时间把日志里的输入送进设备，整个运行逐条指令复现。
+// 两种模式下都每隔 REPLAY_CHECKPOINT_INSTRET 条指令在块边界保存一个检查点：CPU、CLINT、PLIC、UART
+// 和事件队列整体拷贝，内存用写时保存 (所有页带 PAGE_FLAG_SNAPSHOT，第一次写某页时先存下原内容)。
+// 反向执行恢复到目标之前最近的检查点，再正向执行到目标位置；重新经过的历史不再输出。
+// 后端线程异步完成的 virtio 设备和帧缓冲区不在检查点里，不能与记录/回放同时使用
+
+#define REPLAY_CHECKPOINT_INSTRET (1u << 22)
+#define REPLAY_MAX_SAVED_PAGES 32768    // 所有检查点保存的页数上限，超过时丢弃最早的检查点
+#define REPLAY_MAGIC 0x50525652         // "RVRP"
+#define REPLAY_VERSION 1
+
+typedef enum {
+    REPLAY_OFF,
+    REPLAY_RECORD,
+    REPLAY_PLAY,
+} ReplayMode;
+
+typedef enum {
+    REPLAY_INPUT_UART_RX = 1,   // 送进 UART 接收 FIFO 的字符
+    REPLAY_INPUT_SYNC = 2,      // 记录时在检查点写下的 pc 和寄存器摘要，回放时用来发现分叉
+} ReplayInputKind;
+
+// 日志文件：ReplayFileHeader 后面是一串 ReplayEntryHeader + length 字节的数据，按虚拟时间排列
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t load_address;
+} ReplayFileHeader;
+
+typedef struct {
+    uint64_t vtime;
+    uint16_t kind;
+    uint16_t length;
+    uint32_t reserved;
+} ReplayEntryHeader;
+
+extern ReplayMode replay_mode;
+// 本轮循环可以接收宿主机输入：记录模式下位于已执行过的最远处 (前沿)，且是该虚拟时间的第一轮
+extern bool replay_live;
+// 到达过的最大指令数，反向执行后重新经过这之前的历史时不输出
+extern uint64_t replay_frontier;
+
+// 实际执行的指令数，不含 WFI 快进的时间，反向单步以它为坐标
+static inline uint64_t replay_icount(const CPU *cpu) {
+    return event_now(cpu) - event_idle_time;
+}
+
+static inline bool replay_silent(const CPU *cpu) {
+    return replay_mode != REPLAY_OFF && replay_icount(cpu) < replay_frontier;
+}
+
+int replay_open(const char *path, ReplayMode mode, uint64_t load_address);
+// 系统复位：丢弃检查点，记录模式重新开始写日志，回放模式从日志开头重新回放
+void replay_reset(void);
+void replay_service(CPU *cpu);
+// 设备送达宿主机输入时调用，记录模式下写进日志
+void replay_record_input(ReplayInputKind kind, const uint8_t *data, size_t length);
+// 内存写入带 PAGE_FLAG_SNAPSHOT 的页之前调用，offset 相对 MEMORY_BASE_ADDR
+void replay_save_pages(uint64_t offset, uint64_t length);
+
+// 反向单步 / 反向继续 (到上一个断点或观察点)。返回 false 表示已经在最早的检查点，debug_stop 设为
+// DEBUG_STOP_HISTORY_BEGIN；返回 true 时模拟器需要继续运行，到达目标后照常报告停止
+bool replay_reverse_step(CPU *cpu);
+bool replay_reverse_continue(CPU *cpu);
+// 块边界处理停止请求时先调用：反向执行途中的停止由这里消化，返回 true 表示继续运行。
+// 清除 debug_stop_pending，返回 false 时 debug_stop 是要报告的停止原因
+bool replay_filter_stop(CPU *cpu);
+
+// CPU 线程在块边界调用，没有开启记录/回放时只有一次比较
+static inline void replay_poll(CPU *cpu) {
+    if (replay_mode != REPLAY_OFF) {
+        replay_service(cpu);
+    }
+}
+
+#endif //RISCV_SIMULATOR_REPLAY_H
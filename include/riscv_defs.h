@@ -129,20 +129,18 @@
 #define FUNCT3_BLTU 0x6
 #define FUNCT3_BGEU 0x7
 
-// funct3 for LR/SC instructions
-#define FUNCT3_LR 0x2
-#define FUNCT3_SC 0x3
-
-// funct7 for AMO instructions
-#define FUNCT7_AMOSWAP 0x01
-#define FUNCT7_AMOADD 0x00
-#define FUNCT7_AMOXOR 0x04
-#define FUNCT7_AMOAND 0x0C
-#define FUNCT7_AMOOR 0x08
-#define FUNCT7_AMOMIN 0x10
-#define FUNCT7_AMOMAX 0x14
-#define FUNCT7_AMOMINU 0x18
-#define FUNCT7_AMOMAXU 0x1C
+// LR/SC 和 AMO 指令的 funct5 (instruction[31:27])；instruction[26:25] 是 aq/rl，funct3 是宽度 (.W/.D)
+#define FUNCT5_LR 0x02
+#define FUNCT5_SC 0x03
+#define FUNCT5_AMOSWAP 0x01
+#define FUNCT5_AMOADD 0x00
+#define FUNCT5_AMOXOR 0x04
+#define FUNCT5_AMOAND 0x0C
+#define FUNCT5_AMOOR 0x08
+#define FUNCT5_AMOMIN 0x10
+#define FUNCT5_AMOMAX 0x14
+#define FUNCT5_AMOMINU 0x18
+#define FUNCT5_AMOMAXU 0x1C
 
 // M 扩展指令的 funct3 和 funct7
 #define FUNCT7_M 0x01
@@ -0,0 +1,41 @@
+#ifndef RISCV_SIMULATOR_SAMPLER_H
+#define RISCV_SIMULATOR_SAMPLER_H
+
+#include <stdatomic.h>
+#include "cpu.h"
+
+// 客户机 pc 采样分析
+// 宿主机上的定时线程 (timerfd) 按固定频率置位 sampler_pending，CPU 线程在基本块边界看到后
+// 记录一次 pc + 影子调用栈，按符号聚合后在退出时以 folded stack 格式 ("a;b;c count") 输出，
+// 可直接交给 flamegraph.pl 等工具
+
+#define SAMPLER_DEFAULT_HZ 1000
+#define SAMPLER_TABLE_SIZE (1u << 16) // 最多记录的不同调用栈数
+
+// 影子调用栈：按调用约定从 JAL/JALR 的链接寄存器 (ra/t0) 写入推断 call/return，
+// 只记录调用点 pc，溢出时覆盖最旧的栈帧。每个 hart 一个，由采样器持有，CPU 里只有指针；
+// 基本块缓存的返回地址栈也按它的深度对齐，所以不开采样时同样维护
+#define SHADOW_STACK_SIZE 64
+
+typedef struct ShadowStack {
+    uint64_t call_sites[SHADOW_STACK_SIZE];
+    uint32_t depth;          // 逻辑深度，可以超过 SHADOW_STACK_SIZE
+} ShadowStack;
+
+extern atomic_int sampler_pending;
+
+// hartid 的影子调用栈
+ShadowStack *sampler_shadow_stack(uint64_t hartid);
+int sampler_open(const char *path, int hz);
+void sampler_take(CPU *cpu);
+void sampler_dump(void);
+
+// CPU 线程在基本块边界调用，未到采样点时只有一次读
+static inline void sampler_poll(CPU *cpu) {
+    if (atomic_load_explicit(&sampler_pending, memory_order_relaxed)) {
+        atomic_store_explicit(&sampler_pending, 0, memory_order_relaxed);
+        sampler_take(cpu);
+    }
+}
+
+#endif //RISCV_SIMULATOR_SAMPLER_H
@@ -17,6 +17,7 @@ typedef struct {
     const char *input_file; // 输入文件
     uint64_t load_address; // 开始地址
     uint64_t end_address; // 结束地址
+    bool headless;        // 无界面批处理模式
 } Simulator;
 
 void* cpu_simulator(void *arg);
@@ -0,0 +1,62 @@
+#ifndef RISCV_SIMULATOR_SNAPSHOT_H
+#define RISCV_SIMULATOR_SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "cpu.h"
+#include "debug.h"
+
+// CPU 线程发布给显示线程的机器状态快照
+// 通过 seqlock 发布：写者在拷贝前后各把序号加一 (奇数表示正在写)，读者拷贝前后序号一致且为偶数才算成功，
+// 因此显示线程不会看到撕裂的状态，CPU 线程也从不等待显示线程。
+// 只在显示线程请求时 (snapshot_requested) 于基本块边界发布一次，发布频率由显示刷新频率决定
+
+#define SNAPSHOT_STACK_WORDS 32
+#define SNAPSHOT_SOURCE_LINES 32
+#define SNAPSHOT_PLIC_WORDS 4   // 显示前 128 个中断源
+
+typedef struct {
+    uint64_t pc;
+    uint64_t registers[32];
+    uint8_t priv;
+    CSRState csr;
+    UART uart;
+    struct {
+        uint64_t mtime;
+        uint64_t mtimecmp;
+        uint64_t msip;
+    } clint;                    // hart0
+    struct {
+        uint32_t uart_priority;
+        uint32_t pending[SNAPSHOT_PLIC_WORDS];
+        uint32_t threshold;
+        uint32_t enable[SNAPSHOT_PLIC_WORDS];
+        uint32_t claim_complete;
+    } plic;                     // hart0
+    uint64_t stack_base;
+    uint32_t stack[SNAPSHOT_STACK_WORDS];
+    uint64_t source_base;
+    uint32_t source[SNAPSHOT_SOURCE_LINES];
+    DebugStop debug_stop;       // 最近一次断点或观察点停止，继续执行后清掉
+} StateSnapshot;
+
+extern atomic_int snapshot_requested;
+
+// CPU 线程调用：立即发布当前状态
+void snapshot_publish(CPU *cpu);
+// 显示线程调用：读取最近一次发布的快照，从未发布过时返回 false
+bool snapshot_read(StateSnapshot *out);
+
+// CPU 线程在基本块边界调用
+static inline void snapshot_poll(CPU *cpu) {
+    if (atomic_load_explicit(&snapshot_requested, memory_order_relaxed)) {
+        atomic_store_explicit(&snapshot_requested, 0, memory_order_relaxed);
+        snapshot_publish(cpu);
+    }
+}
+
+static inline void snapshot_request(void) {
+    atomic_store_explicit(&snapshot_requested, 1, memory_order_relaxed);
+}
+
+#endif //RISCV_SIMULATOR_SNAPSHOT_H
@@ -0,0 +1,12 @@
+#ifndef RISCV_SIMULATOR_STATS_H
+#define RISCV_SIMULATOR_STATS_H
+
+// 运行统计：退出时把墙钟时间、客户机执行的指令数 (minstret) 和 MIPS 以一行 JSON 写入文件，
+// 供基准测试工具 (tools/bench.c) 汇总。计时从 stats_start 开始，不含启动时的参数解析和设备初始化
+
+// path 为 "-" 时写到 stderr；rom 原样记进报告
+int stats_open(const char *path, const char *rom);
+// 客户机开始执行前调用
+void stats_start(void);
+
+#endif //RISCV_SIMULATOR_STATS_H
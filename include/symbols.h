@@ -0,0 +1,15 @@
+#ifndef RISCV_SIMULATOR_SYMBOLS_H
+#define RISCV_SIMULATOR_SYMBOLS_H
+
+#include <stdint.h>
+
+// 从客户程序的 ELF 文件中读取代码段符号 (.symtab 中位于可执行节的 FUNC/NOTYPE 符号)，
+// 用于把客户机 pc 翻译成函数名
+
+// 成功返回读取的符号个数，失败返回 -1
+int symbols_load(const char *path);
+// 返回不大于 pc 的最近符号的序号，找不到返回 -1
+int symbols_lookup(uint64_t pc);
+const char *symbols_name(int index);
+
+#endif //RISCV_SIMULATOR_SYMBOLS_H
@@ -0,0 +1,92 @@
+#ifndef RISCV_SIMULATOR_TRACE_H
+#define RISCV_SIMULATOR_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "cpu.h"
+
+// 二进制执行轨迹
+//
+// 文件 = TRACE_HEADER_SIZE 字节的文件头 + 连续的记录流，每条指令一条记录：
+//   flags (1B)
+//   [KEYFRAME] varint(pc) + 32 * varint(x[i])     重置解码状态，用于随机定位
+//   [JUMP]     zigzag(pc - 预期 pc)                 预期 pc = 上一条 pc + 4
+//   inst (4B, 小端)
+//   [RD]       rd (1B) + zigzag(新值 - 旧值)         仅当 rd 的值发生变化
+//   [MEM]      zigzag(addr - 上次 addr) + varint(data)，访问宽度在 flags 的 MEM_SIZE 字段
+// 另有 <trace>.idx 索引文件，记录每个关键帧的 (指令序号, 记录流偏移)，解码器据此按指令数定位
+
+#define TRACE_MAGIC "RVTRACE1"
+#define TRACE_HEADER_SIZE 64
+#define TRACE_KEYFRAME_INTERVAL 65536 // 每隔多少条指令插入一个关键帧
+#define TRACE_INDEX_SUFFIX ".idx"
+#define TRACE_MAX_RECORD_SIZE (1 + 10 * 33 + 10 + 4 + 1 + 10 + 10 + 10)
+
+#define TRACE_FLAG_KEYFRAME 0x01
+#define TRACE_FLAG_JUMP     0x02
+#define TRACE_FLAG_RD       0x04
+#define TRACE_FLAG_MEM      0x08
+#define TRACE_FLAG_STORE    0x10
+#define TRACE_MEM_SIZE_SHIFT 5       // flags[6:5] = log2(访问宽度)
+#define TRACE_MEM_SIZE_MASK  0x3
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t keyframe_interval;
+    uint8_t reserved[TRACE_HEADER_SIZE - 16];
+} TraceHeader;
+
+typedef struct {
+    uint64_t instret; // 关键帧对应的指令序号 (从 0 开始)
+    uint64_t offset;  // 关键帧记录在记录流中的偏移
+} TraceIndexEntry;
+
+// 编码器和解码器共同维护的增量状态
+typedef struct {
+    uint64_t next_pc;
+    uint64_t registers[32];
+    uint64_t mem_addr;
+} TraceState;
+
+static inline uint64_t trace_zigzag(int64_t value) {
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+static inline int64_t trace_unzigzag(uint64_t value) {
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+static inline size_t trace_put_varint(uint8_t *out, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t) value;
+    return n;
+}
+
+// 成功返回读取的字节数，数据不完整返回 0
+static inline size_t trace_get_varint(const uint8_t *in, const uint8_t *end, uint64_t *value) {
+    uint64_t result = 0;
+    for (size_t n = 0; n < 10 && in + n < end; n++) {
+        result |= (uint64_t) (in[n] & 0x7F) << (7 * n);
+        if ((in[n] & 0x80) == 0) {
+            *value = result;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+// 记录端接口 (CPU 线程调用)
+extern bool trace_enabled;
+
+int trace_open(const char *path);
+void trace_close(void);
+// 执行一条指令并记录其轨迹
+void trace_execute(CPU *cpu, uint32_t instruction);
+
+#endif //RISCV_SIMULATOR_TRACE_H
@@ -2,6 +2,9 @@
 #define RISCSIMULATOR_S_UART_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
 #include <ncurses.h>
 
 #define UART_BASE_ADDR 0x10000000L
@@ -23,9 +26,26 @@
 // Line Status Register bits
 #define LSR_RX_READY (1 << 0)
 #define LSR_TX_IDLE  (1 << 5)
+#define LSR_TX_EMPTY (1 << 6) // 发送器完全空闲 (TEMT)
 #define LSR_THRE 0x60 // Transmitter Holding Register Empty
 #define UART_FIFO_SIZE 16  // FIFO 缓冲区大小
 
+// Interrupt Enable Register bits
+#define IER_RX_AVAILABLE (1 << 0)
+#define IER_THR_EMPTY    (1 << 1)
+
+// Interrupt Identification Register values
+#define IIR_NO_INTERRUPT 0x01
+#define IIR_THR_EMPTY    0x02
+#define IIR_RX_AVAILABLE 0x04
+#define IIR_RX_TIMEOUT   0x0C
+#define IIR_FIFO_ENABLED 0xC0
+
+// 收发环形缓冲区大小，必须是 2 的幂
+#define UART_RING_SIZE 4096
+// 字符超时：接收 FIFO 低于触发深度且这么多条指令 (虚拟时间) 内没有收发字符时产生超时中断
+#define UART_RX_TIMEOUT_INSTRET 4096
+
 
 
 typedef struct {
@@ -41,17 +61,56 @@ typedef struct {
     uint8_t SCR;  // Scratch Register
     uint16_t DLL; // Divisor Latch Low
     uint16_t DLM; // Divisor Latch High
-    uint8_t fifo[UART_FIFO_SIZE];  // 接收 FIFO 缓冲区
-    uint8_t fifo_head;  // FIFO 头指针
-    uint8_t fifo_tail;  // FIFO 尾指针
-    uint8_t fifo_count; // FIFO 中的字节数
+    bool thre_pending;  // THRE 中断挂起，读 IIR 或写 THR 时清除
 } UART;
 
+// 发送环满且允许 THRE 中断时置位，CPU 线程在块边界检查是否已腾出空间
+extern bool uart_tx_waiting;
+// 生产者写入接收环后置位
+extern atomic_int uart_rx_kick;
+
 
 UART* get_uart(void);
 void uart_init(UART *uart);
 uint64_t uart_read(uint64_t addr, uint32_t size);
 void uart_write(uint64_t address, uint64_t value, uint32_t size);
+uint8_t uart_line_status(UART *uart);
+
+// 无界面模式没有消费者线程，THR 直接写入控制台
+void uart_set_tx_direct(bool direct);
+// 消费者线程调用：先拷出最多 max 个待发送字节，输出完成后再 consume 释放空间
+size_t uart_tx_peek(uint8_t *buffer, size_t max);
+void uart_tx_consume(size_t count);
+// 等待消费者把发送环中的字符全部输出 (退出前调用)
+void uart_tx_flush(void);
+// 接收环生产者 (键盘线程、输入文件线程) 调用，返回实际写入的字节数
+size_t uart_rx_write(const uint8_t *data, size_t length);
+// 从文件或管道 ("-" 表示 stdin) 全速读取输入送入接收环
+int uart_input_open(const char *path);
+// CPU 线程在块边界调用：把接收环中的字符送进 FIFO，根据收发状态更新中断
+void uart_service(void);
+// 回放：把日志里的字符直接送进 FIFO (CPU 线程)
+void uart_rx_inject(const uint8_t *data, size_t length);
+
+// 记录/回放检查点保存的客户机可见状态
+typedef struct {
+    UART regs;
+    uint32_t rx_count;
+    uint8_t rx_data[UART_RING_SIZE];
+    uint32_t rx_seen;
+    uint64_t rx_last_activity;
+    bool rx_timeout;
+    bool rx_asserted;
+} UartState;
+
+void uart_save(UartState *state);
+void uart_restore(const UartState *state);
+
+static inline void uart_poll(void) {
+    if (uart_tx_waiting || atomic_load_explicit(&uart_rx_kick, memory_order_relaxed)) {
+        uart_service();
+    }
+}
 
 
 #endif // RISCSIMULATOR_S_UART_H
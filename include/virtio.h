@@ -0,0 +1,158 @@
+#ifndef RISCV_SIMULATOR_VIRTIO_H
+#define RISCV_SIMULATOR_VIRTIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// virtio-mmio 传输层 (virtio 1.x，寄存器版本 2)
+// 各设备 (块设备、网卡、控制台) 共用寄存器解码、virtqueue 解析和中断上报，
+// 只需提供 notify/reset 回调和配置空间
+
+#define VIRTIO_MMIO_SIZE 0x1000
+
+// 寄存器偏移
+#define VIRTIO_MMIO_MAGIC_VALUE         0x000
+#define VIRTIO_MMIO_VERSION             0x004
+#define VIRTIO_MMIO_DEVICE_ID           0x008
+#define VIRTIO_MMIO_VENDOR_ID           0x00c
+#define VIRTIO_MMIO_DEVICE_FEATURES     0x010
+#define VIRTIO_MMIO_DEVICE_FEATURES_SEL 0x014
+#define VIRTIO_MMIO_DRIVER_FEATURES     0x020
+#define VIRTIO_MMIO_DRIVER_FEATURES_SEL 0x024
+#define VIRTIO_MMIO_QUEUE_SEL           0x030
+#define VIRTIO_MMIO_QUEUE_NUM_MAX       0x034
+#define VIRTIO_MMIO_QUEUE_NUM           0x038
+#define VIRTIO_MMIO_QUEUE_READY         0x044
+#define VIRTIO_MMIO_QUEUE_NOTIFY        0x050
+#define VIRTIO_MMIO_INTERRUPT_STATUS    0x060
+#define VIRTIO_MMIO_INTERRUPT_ACK       0x064
+#define VIRTIO_MMIO_STATUS              0x070
+#define VIRTIO_MMIO_QUEUE_DESC_LOW      0x080
+#define VIRTIO_MMIO_QUEUE_DESC_HIGH     0x084
+#define VIRTIO_MMIO_QUEUE_DRIVER_LOW    0x090
+#define VIRTIO_MMIO_QUEUE_DRIVER_HIGH   0x094
+#define VIRTIO_MMIO_QUEUE_DEVICE_LOW    0x0a0
+#define VIRTIO_MMIO_QUEUE_DEVICE_HIGH   0x0a4
+#define VIRTIO_MMIO_CONFIG_GENERATION   0x0fc
+#define VIRTIO_MMIO_CONFIG              0x100
+
+#define VIRTIO_MMIO_MAGIC  0x74726976 // "virt"
+#define VIRTIO_MMIO_VENDOR 0x554d4551 // "QEMU"
+
+// 设备状态位
+#define VIRTIO_STATUS_ACKNOWLEDGE 1
+#define VIRTIO_STATUS_DRIVER      2
+#define VIRTIO_STATUS_DRIVER_OK   4
+#define VIRTIO_STATUS_FEATURES_OK 8
+#define VIRTIO_STATUS_NEEDS_RESET 64
+#define VIRTIO_STATUS_FAILED      128
+
+// 中断状态位
+#define VIRTIO_INT_USED_RING 1
+#define VIRTIO_INT_CONFIG    2
+
+#define VIRTIO_F_VERSION_1 32
+
+// 描述符标志
+#define VIRTQ_DESC_F_NEXT  1
+#define VIRTQ_DESC_F_WRITE 2
+#define VIRTQ_AVAIL_F_NO_INTERRUPT 1
+
+#define VIRTIO_QUEUE_SIZE 256   // 每个队列最多的描述符数 (QueueNumMax)
+#define VIRTIO_MAX_QUEUES 16
+#define VIRTIO_MAX_DEVICES 8
+#define VIRTIO_MAX_SEGMENTS 64  // 单个请求最多的描述符数
+
+typedef struct {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} VirtqDesc;
+
+// 描述符链解析后的一段缓冲区，data 直接指向客户机内存
+typedef struct {
+    uint8_t *data;
+    uint32_t len;
+    bool device_writable;
+} VirtqBuffer;
+
+// 后端线程完成的请求，由 CPU 线程写回 used 环
+typedef struct {
+    uint16_t head;
+    uint32_t len;
+} VirtqCompletion;
+
+typedef struct {
+    uint32_t num;
+    bool ready;
+    uint64_t desc_addr;
+    uint64_t avail_addr;
+    uint64_t used_addr;
+    uint16_t last_avail; // 设备已取走的 avail 下标
+    uint16_t used_idx;
+    // 后端线程 -> CPU 线程的完成环，在途请求不超过队列大小，不会溢出
+    VirtqCompletion completions[VIRTIO_QUEUE_SIZE];
+    _Atomic uint32_t completion_head;
+    _Atomic uint32_t completion_tail;
+} VirtQueue;
+
+typedef struct VirtioDevice VirtioDevice;
+
+struct VirtioDevice {
+    const char *name;
+    uint32_t device_id;       // 0 表示空槽 (没有后端)
+    uint32_t irq;
+    uint64_t device_features;
+    uint64_t driver_features;
+    uint32_t device_features_sel;
+    uint32_t driver_features_sel;
+    uint32_t status;
+    uint32_t interrupt_status;
+    uint32_t config_generation;
+    uint32_t queue_sel;
+    uint32_t num_queues;
+    VirtQueue queues[VIRTIO_MAX_QUEUES];
+    uint8_t *config;
+    uint32_t config_size;
+    void (*notify)(VirtioDevice *device, uint32_t queue);
+    void (*reset)(VirtioDevice *device); // 必须等待所有在途请求结束
+    void (*config_write)(VirtioDevice *device, uint32_t offset, uint32_t size);
+    void (*poll)(VirtioDevice *device);  // 块边界回调，后端线程置位 virtio_completion_pending 后调用
+};
+
+// 后端完成请求或有新事件时置位，CPU 线程在块边界收集完成项并调用各设备的 poll
+extern atomic_int virtio_completion_pending;
+
+void virtio_register(VirtioDevice *device);
+uint64_t virtio_mmio_read(VirtioDevice *device, uint64_t offset, uint32_t size);
+void virtio_mmio_write(VirtioDevice *device, uint64_t offset, uint64_t value, uint32_t size);
+
+// 客户机物理地址转宿主机指针，整段不在内存中时返回 NULL
+uint8_t *virtio_guest_ptr(uint64_t address, uint64_t length);
+
+// 取出下一个可用描述符链的头，没有时返回 false (CPU 线程)
+bool virtq_pop(VirtQueue *queue, uint16_t *head);
+// 退回最近取出但未使用的 count 个描述符链 (CPU 线程)
+void virtq_unpop(VirtQueue *queue, uint16_t count);
+// 解析描述符链，返回段数，链非法时返回 -1 (CPU 线程)
+int virtq_map_chain(VirtQueue *queue, uint16_t head, VirtqBuffer *buffers, int max);
+// 把完成的链写回 used 环 (CPU 线程)
+void virtq_push(VirtQueue *queue, uint16_t head, uint32_t len);
+// 一批完成项写回后调用一次，客户机没有关闭通知时上报中断
+void virtq_notify_guest(VirtioDevice *device, VirtQueue *queue);
+// 后端线程调用：登记一个完成项，由 CPU 线程在块边界写回
+void virtq_complete_async(VirtQueue *queue, uint16_t head, uint32_t len);
+void virtio_raise_interrupt(VirtioDevice *device, uint32_t reason);
+
+void virtio_collect_completions(void);
+void virtio_reset_all(void);
+
+static inline void virtio_poll(void) {
+    if (atomic_load_explicit(&virtio_completion_pending, memory_order_relaxed)) {
+        virtio_collect_completions();
+    }
+}
+
+#endif //RISCV_SIMULATOR_VIRTIO_H
@@ -0,0 +1,42 @@
+#ifndef RISCV_SIMULATOR_VIRTIO_BLK_H
+#define RISCV_SIMULATOR_VIRTIO_BLK_H
+
+#include <stdint.h>
+
+// virtio-mmio 块设备
+// 磁盘镜像以 MAP_SHARED 映射，CPU 线程只解析描述符链，每个队列一个后台线程在映射和客户机内存之间
+// 直接拷贝 (没有中间缓冲区)，完成项由 CPU 线程在块边界写回 used 环并通过 PLIC 上报中断
+
+#define VIRTIO_BLK_BASE_ADDR 0x10001000
+#define VIRTIO_BLK_IRQ 1
+#define VIRTIO_BLK_NUM_QUEUES 4
+
+#define VIRTIO_ID_BLOCK 2
+#define VIRTIO_BLK_SECTOR_SIZE 512
+
+// 特性位
+#define VIRTIO_BLK_F_SEG_MAX  2
+#define VIRTIO_BLK_F_RO       5
+#define VIRTIO_BLK_F_BLK_SIZE 6
+#define VIRTIO_BLK_F_FLUSH    9
+#define VIRTIO_BLK_F_MQ       12
+
+// 请求类型
+#define VIRTIO_BLK_T_IN     0
+#define VIRTIO_BLK_T_OUT    1
+#define VIRTIO_BLK_T_FLUSH  4
+#define VIRTIO_BLK_T_GET_ID 8
+
+// 请求状态
+#define VIRTIO_BLK_S_OK     0
+#define VIRTIO_BLK_S_IOERR  1
+#define VIRTIO_BLK_S_UNSUPP 2
+
+#define VIRTIO_BLK_ID_BYTES 20
+
+// 打开磁盘镜像并启用设备，不调用时该槽位是空设备 (DeviceID 为 0)
+int virtio_blk_open(const char *path);
+uint64_t virtio_blk_read(uint64_t address, uint32_t size);
+void virtio_blk_write(uint64_t address, uint64_t value, uint32_t size);
+
+#endif //RISCV_SIMULATOR_VIRTIO_BLK_H
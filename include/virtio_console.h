@@ -0,0 +1,38 @@
+#ifndef RISCV_SIMULATOR_VIRTIO_CONSOLE_H
+#define RISCV_SIMULATOR_VIRTIO_CONSOLE_H
+
+#include <stdint.h>
+
+// virtio-mmio 多端口控制台
+// 客户机一次提交整块缓冲区，CPU 线程把一批描述符链合成一次 writev 直接从客户机内存写到宿主机文件或管道；
+// 每个端口可以单独指定输出和输入，日志、shell、数据流可以分开。端口 0 作为控制台 (hvc0)，其余端口以名字
+// 出现在 /dev/virtio-ports/ 下
+
+#define VIRTIO_CONSOLE_BASE_ADDR 0x10003000
+#define VIRTIO_CONSOLE_IRQ 3
+#define VIRTIO_CONSOLE_MAX_PORTS 4
+
+#define VIRTIO_ID_CONSOLE 3
+
+// 特性位
+#define VIRTIO_CONSOLE_F_SIZE        0
+#define VIRTIO_CONSOLE_F_MULTIPORT   1
+#define VIRTIO_CONSOLE_F_EMERG_WRITE 2
+
+// 控制消息
+#define VIRTIO_CONSOLE_DEVICE_READY  0
+#define VIRTIO_CONSOLE_DEVICE_ADD    1
+#define VIRTIO_CONSOLE_DEVICE_REMOVE 2
+#define VIRTIO_CONSOLE_PORT_READY    3
+#define VIRTIO_CONSOLE_CONSOLE_PORT  4
+#define VIRTIO_CONSOLE_RESIZE        5
+#define VIRTIO_CONSOLE_PORT_OPEN     6
+#define VIRTIO_CONSOLE_PORT_NAME     7
+
+// spec 形如 "[名字=]输出[:输入],..."，每项一个端口；输出是普通文件 (截断) 或已存在的管道/字符设备，
+// 输入可省略。不调用时该槽位是空设备
+int virtio_console_open(const char *spec);
+uint64_t virtio_console_read(uint64_t address, uint32_t size);
+void virtio_console_write(uint64_t address, uint64_t value, uint32_t size);
+
+#endif //RISCV_SIMULATOR_VIRTIO_CONSOLE_H
@@ -0,0 +1,42 @@
+#ifndef RISCV_SIMULATOR_VIRTIO_NET_H
+#define RISCV_SIMULATOR_VIRTIO_NET_H
+
+#include <stdint.h>
+
+// virtio-mmio 网卡
+// 后端是本机 UNIX 数据报套接字：每个模拟器实例绑定自己的套接字路径，发出的帧复制给所有对端
+// (相当于一个集线器)，不需要宿主机网络。收发都在 CPU 线程批量进行，recvmmsg/sendmmsg 的 iovec
+// 直接指向客户机内存，没有中间缓冲区；后台线程只负责等待套接字可读
+
+#define VIRTIO_NET_BASE_ADDR 0x10002000
+#define VIRTIO_NET_IRQ 2
+#define VIRTIO_NET_MAX_PAIRS 2   // 收发队列对数，队列 2n 收、2n+1 发，最后一个是控制队列
+#define VIRTIO_NET_MAX_PEERS 16
+#define VIRTIO_NET_BATCH 32      // 一次系统调用最多收发的帧数
+
+#define VIRTIO_ID_NET 1
+#define VIRTIO_NET_MTU 1500
+#define VIRTIO_NET_HDR_SIZE 12   // VERSION_1 下的 virtio_net_hdr，含 num_buffers
+
+// 特性位
+#define VIRTIO_NET_F_MTU     3
+#define VIRTIO_NET_F_MAC     5
+#define VIRTIO_NET_F_STATUS  16
+#define VIRTIO_NET_F_CTRL_VQ 17
+#define VIRTIO_NET_F_MQ      22
+
+#define VIRTIO_NET_S_LINK_UP 1
+
+// 控制队列命令
+#define VIRTIO_NET_CTRL_RX 0
+#define VIRTIO_NET_CTRL_MQ 4
+#define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET 0
+#define VIRTIO_NET_OK  0
+#define VIRTIO_NET_ERR 1
+
+// spec 形如 "<本机套接字>[,<对端套接字>...]"，不调用时该槽位是空设备
+int virtio_net_open(const char *spec);
+uint64_t virtio_net_read(uint64_t address, uint32_t size);
+void virtio_net_write(uint64_t address, uint64_t value, uint32_t size);
+
+#endif //RISCV_SIMULATOR_VIRTIO_NET_H
@@ -138,43 +138,43 @@ inline void execute_amomaxu_w(CPU *cpu, uint32_t rd, uint32_t rs1, uint32_t rs2)
 
 
 void execute_atomic_instruction(CPU *cpu, uint32_t instruction) {
-    uint32_t funct3 = (instruction >> 12) & 0x7;
-    uint32_t funct7 = (instruction >> 25) & 0x7F;
+    // 操作由 funct5 区分，aq/rl 位在单核上没有影响
+    uint32_t funct5 = (instruction >> 27) & 0x1F;
     uint32_t rd = (instruction >> 7) & 0x1F;
     uint32_t rs1 = (instruction >> 15) & 0x1F;
     uint32_t rs2 = (instruction >> 20) & 0x1F;
 
-    if (funct3 == FUNCT3_LR && funct7 == 0x0) {
+    if (funct5 == FUNCT5_LR) {
         execute_lr_w(cpu, rd, rs1);
-    } else if (funct3 == FUNCT3_SC && funct7 == 0x0) {
+    } else if (funct5 == FUNCT5_SC) {
         execute_sc_w(cpu, rd, rs1, rs2);
     } else {
-        switch (funct7) {
-            case FUNCT7_AMOSWAP:
+        switch (funct5) {
+            case FUNCT5_AMOSWAP:
                 execute_amoswap_w(cpu, rd, rs1, rs2);
                 break;
-            case FUNCT7_AMOADD:
+            case FUNCT5_AMOADD:
                 execute_amoadd_w(cpu, rd, rs1, rs2);
                 break;
-            case FUNCT7_AMOXOR:
+            case FUNCT5_AMOXOR:
                 execute_amoxor_w(cpu, rd, rs1, rs2);
                 break;
-            case FUNCT7_AMOAND:
+            case FUNCT5_AMOAND:
                 execute_amoand_w(cpu, rd, rs1, rs2);
                 break;
-            case FUNCT7_AMOOR:
+            case FUNCT5_AMOOR:
                 execute_amoor_w(cpu, rd, rs1, rs2);
                 break;
-            case FUNCT7_AMOMIN:
+            case FUNCT5_AMOMIN:
                 execute_amomin_w(cpu, rd, rs1, rs2);
                 break;
-            case FUNCT7_AMOMAX:
+            case FUNCT5_AMOMAX:
                 execute_amomax_w(cpu, rd, rs1, rs2);
                 break;
-            case FUNCT7_AMOMINU:
+            case FUNCT5_AMOMINU:
                 execute_amominu_w(cpu, rd, rs1, rs2);
                 break;
-            case FUNCT7_AMOMAXU:
+            case FUNCT5_AMOMAXU:
                 execute_amomaxu_w(cpu, rd, rs1, rs2);
                 break;
             default:
@@ -1,7 +1,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include "b_inst.h"
-#include "mfprintf.h"
+#include "log.h"
 #include "display.h"
 
 void execute_b_type_instruction(CPU *cpu, uint32_t instruction) {
@@ -59,7 +59,7 @@ void execute_b_type_instruction(CPU *cpu, uint32_t instruction) {
             }
             break;
         default:
-            mfprintf("Unknown B-type instruction with funct3: 0x%x\n", funct3);
+            LOG_WARN(LOG_CAT_CPU, "Unknown B-type instruction with funct3: 0x%x\n", funct3);
     }
     cpu->pc += 4;  // 如果没有跳转，则PC增加4
 }
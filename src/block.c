@@ -0,0 +1,421 @@
+#include <stdlib.h>
+#include <string.h>
+#include "block.h"
+#include "j_inst.h"
+#include "profile.h"
+#include "sampler.h"
+#include "log.h"
+
+bool block_exit_requested = false;
+Block *block_chain_from = NULL;
+Block *block_running = NULL;
+uint64_t block_running_instret = 0;
+
+static Block *block_table[BLOCK_HASH_SIZE];
+// 按入口所在的物理页索引的基本块链，写入代码页时只检查这一页和前一页 (跨页的基本块) 的链
+static Block *page_blocks[MEMORY_NUM_PAGES];
+static uint64_t block_stop_pc = 0;
+// 返回地址栈：与 CPU 影子调用栈按深度对齐，call_blocks[i] 是第 i 帧的调用块
+static Block *call_blocks[SHADOW_STACK_SIZE];
+
+static inline uint32_t block_hash(uint64_t pc) {
+    return (uint32_t) ((pc >> 2) ^ (pc >> (2 + BLOCK_HASH_BITS))) & (BLOCK_HASH_SIZE - 1);
+}
+
+// 基本块以控制转移和可能改变执行环境的指令结尾
+static inline bool ends_block(uint32_t instruction) {
+    switch (OPCODE(instruction)) {
+        case OPCODE_BRANCH:
+        case OPCODE_JAL:
+        case OPCODE_JALR:
+        case OPCODE_SYSTEM:
+        case OPCODE_MISC_MEM:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static uint32_t block_exit_kind(uint32_t instruction) {
+    uint32_t kind = 0;
+    if (OPCODE(instruction) == OPCODE_JAL || OPCODE(instruction) == OPCODE_JALR) {
+        if (is_link_register(RD(instruction))) {
+            kind |= BLOCK_EXIT_CALL;
+        }
+        if (OPCODE(instruction) == OPCODE_JALR && is_link_register(RS1(instruction)) &&
+            RS1(instruction) != RD(instruction)) {
+            kind |= BLOCK_EXIT_RETURN;
+        }
+    }
+    return kind;
+}
+
+// LUI/AUIPC 写入 rd 的值，与 cpu_execute 的结果一致
+static inline uint64_t upper_immediate(uint32_t instruction, uint64_t pc) {
+    if (OPCODE(instruction) == OPCODE_LUI) {
+        return instruction & 0xFFFFF000;
+    }
+    return pc + (int64_t) (int32_t) (instruction & 0xFFFFF000);
+}
+
+// pc 处的 first 与下一条 second 能否融合；前一条写 x0 的不融合
+static FusedOp fuse_pair(uint64_t pc, uint32_t first, uint32_t second) {
+    FusedOp op = {0};
+    uint32_t rd = RD(first);
+    if (rd == 0) {
+        return op;
+    }
+    op.rd = (uint8_t) rd;
+    switch (OPCODE(first)) {
+        case OPCODE_LUI:
+        case OPCODE_AUIPC: {
+            if (RS1(second) != rd) {
+                break;
+            }
+            uint64_t upper = upper_immediate(first, pc);
+            int32_t imm = IMM(second) << 20 >> 20;
+            if (OPCODE(second) == OPCODE_OP_IMM && FUNCT3(second) == FUNCT3_ADDI && RD(second) == rd) {
+                op.kind = FUSE_CONST;
+                op.value = upper + (int64_t) imm;
+            } else if (OPCODE(second) == OPCODE_OP_IMM_32 && FUNCT3(second) == FUNCT3_ADDIW && RD(second) == rd) {
+                op.kind = FUSE_CONST;
+                op.value = (uint64_t) (int64_t) (int32_t) ((uint32_t) upper + (uint32_t) imm);
+            } else if (OPCODE(first) == OPCODE_AUIPC &&
+                       (OPCODE(second) == OPCODE_LOAD || OPCODE(second) == OPCODE_JALR)) {
+                op.kind = FUSE_PC_REL;
+                op.value = upper;
+            }
+            break;
+        }
+        case OPCODE_OP_IMM:
+            // 移位量只有低 6 位，高位非零的是 SRAI 或保留编码
+            if (FUNCT3(first) == FUNCT3_SLLI && (first >> 26) == 0 &&
+                OPCODE(second) == OPCODE_OP_IMM && FUNCT3(second) == FUNCT3_SRLI_SRAI && (second >> 26) == 0 &&
+                RD(second) == rd && RS1(second) == rd) {
+                op.kind = FUSE_SHIFT;
+                op.rs1 = (uint8_t) RS1(first);
+                op.rs2 = (uint8_t) ((first >> 20) & 0x3F);
+                op.shift = (uint8_t) ((second >> 20) & 0x3F);
+            }
+            break;
+        case OPCODE_OP:
+            if (FUNCT3(first) == FUNCT3_ADD_SUB && FUNCT7(first) == FUNCT7_ADD &&
+                OPCODE(second) == OPCODE_LOAD && RS1(second) == rd) {
+                op.kind = FUSE_INDEXED;
+                op.rs1 = (uint8_t) RS1(first);
+                op.rs2 = (uint8_t) RS2(first);
+            }
+            break;
+        default:
+            break;
+    }
+    return op;
+}
+
+// 从头配对，每条指令最多属于一个融合对
+static void fuse_block(Block *block) {
+    memset(block->fused, 0, sizeof(block->fused));
+    for (uint32_t i = 0; i + 1 < block->length; i++) {
+        block->fused[i] = fuse_pair(block->start_pc + i * 4, block->insts[i], block->insts[i + 1]);
+        if (block->fused[i].kind != FUSE_NONE) {
+            i++;
+        }
+    }
+}
+
+// 从 pc 开始取指，返回指令条数
+static uint32_t fetch_block(CPU *cpu, uint64_t pc, uint32_t *insts) {
+    uint32_t length = 0;
+    do {
+        uint32_t instruction = load_inst(cpu->memory, pc);
+        insts[length++] = instruction;
+        pc += 4;
+        if (ends_block(instruction)) {
+            break;
+        }
+    } while (length < BLOCK_MAX_INSTS && pc != block_stop_pc &&
+             pc >= MEMORY_BASE_ADDR && pc < MEMORY_END_ADDR);
+    return length;
+}
+
+void block_cache_init(uint64_t stop_pc) {
+    block_stop_pc = stop_pc;
+}
+
+static inline bool block_in_memory(const Block *block) {
+    return block->start_pc >= MEMORY_BASE_ADDR && block->start_pc < MEMORY_END_ADDR;
+}
+
+static inline uint64_t block_end_pc(const Block *block) {
+    return block->start_pc + block->length * 4;
+}
+
+// 基本块覆盖的页加上 PAGE_FLAG_CODE，之后对这些页的写入经过 block_cache_code_write
+static inline void mark_code_pages(const Block *block) {
+    if (block_in_memory(block)) {
+        memory_set_page_flags(block->start_pc - MEMORY_BASE_ADDR, block->length * 4, PAGE_FLAG_CODE, true);
+    }
+}
+
+void block_cache_reset(void) {
+    for (uint32_t i = 0; i < BLOCK_HASH_SIZE; i++) {
+        Block *block = block_table[i];
+        while (block != NULL) {
+            Block *next = block->next;
+            free(block->trace);
+            free(block->early_exits);
+            free(block);
+            block = next;
+        }
+        block_table[i] = NULL;
+    }
+    memset(page_blocks, 0, sizeof(page_blocks));
+    memset(call_blocks, 0, sizeof(call_blocks));
+    block_chain_from = NULL;
+    memory_set_page_flags(0, MEMORY_SIZE, PAGE_FLAG_CODE, false);
+}
+
+// 失效后重新取指：指令未变时保留计数，否则先把旧计数交给 profiler 再清零
+static void revalidate_block(CPU *cpu, Block *block) {
+    uint32_t insts[BLOCK_MAX_INSTS];
+    uint32_t length = fetch_block(cpu, block->start_pc, insts);
+    if (length != block->length || memcmp(insts, block->insts, length * sizeof(uint32_t)) != 0) {
+        profile_block_retired(block);
+        block->exec_count = 0;
+        free(block->early_exits);
+        block->early_exits = NULL;
+        block->length = length;
+        memcpy(block->insts, insts, length * sizeof(uint32_t));
+        block->exit_kind = block_exit_kind(insts[length - 1]);
+        fuse_block(block);
+    }
+    block->valid = true;
+    mark_code_pages(block);
+}
+
+Block *block_lookup(CPU *cpu, uint64_t pc) {
+    uint32_t index = block_hash(pc);
+    for (Block *block = block_table[index]; block != NULL; block = block->next) {
+        if (block->start_pc == pc) {
+            if (!block->valid) {
+                revalidate_block(cpu, block);
+            }
+            return block;
+        }
+    }
+
+    Block *block = calloc(1, sizeof(Block));
+    if (block == NULL) {
+        LOG_ERROR(LOG_CAT_CPU, "Failed to allocate block for pc 0x%lx\n", pc);
+        exit(EXIT_FAILURE);
+    }
+    block->start_pc = pc;
+    block->valid = true;
+    block->length = fetch_block(cpu, pc, block->insts);
+    block->exit_kind = block_exit_kind(block->insts[block->length - 1]);
+    fuse_block(block);
+    block->next = block_table[index];
+    block_table[index] = block;
+    if (block_in_memory(block)) {
+        uint64_t page = (pc - MEMORY_BASE_ADDR) >> MEMORY_PAGE_SHIFT;
+        block->page_next = page_blocks[page];
+        page_blocks[page] = block;
+        mark_code_pages(block);
+    }
+    return block;
+}
+
+// 缓存的后继指针只在复位时随基本块一起释放，失效的基本块要先经 block_lookup 重新校验
+static inline bool chain_hit(const Block *block, uint64_t pc) {
+    return block != NULL && block->start_pc == pc && block->valid;
+}
+
+static Block *chain_next(CPU *cpu) {
+    Block *from = block_chain_from;
+    uint64_t pc = cpu->pc;
+    if (from == NULL) {
+        return block_lookup(cpu, pc);
+    }
+    block_chain_from = NULL;
+    uint32_t depth = cpu->shadow_stack->depth;
+    if (from->exit_kind == BLOCK_EXIT_RETURN) {
+        // 返回：影子调用栈刚弹出的那一帧对应调用块，返回点紧跟在调用块之后
+        Block *caller = call_blocks[depth & (SHADOW_STACK_SIZE - 1)];
+        if (caller != NULL && block_end_pc(caller) == pc) {
+            if (!chain_hit(caller->return_block, pc)) {
+                caller->return_block = block_lookup(cpu, pc);
+            }
+            return caller->return_block;
+        }
+    } else if (from->exit_kind & BLOCK_EXIT_CALL) {
+        // 调用：影子调用栈刚压入的那一帧
+        call_blocks[(depth - 1) & (SHADOW_STACK_SIZE - 1)] = from;
+    }
+    for (uint32_t i = 0; i < 2; i++) {
+        if (chain_hit(from->successors[i], pc)) {
+            from->successor_hits[i]++;
+            return from->successors[i];
+        }
+    }
+    Block *next = block_lookup(cpu, pc);
+    from->successors[1] = from->successors[0];
+    from->successor_hits[1] = from->successor_hits[0];
+    from->successors[0] = next;
+    from->successor_hits[0] = 1;
+    return next;
+}
+
+// 命中次数至少占四分之三的后继
+static Block *hot_successor(const Block *block) {
+    uint64_t total = (uint64_t) block->successor_hits[0] + block->successor_hits[1];
+    for (uint32_t i = 0; i < 2; i++) {
+        const Block *next = block->successors[i];
+        if (next != NULL && next->valid &&
+            (uint64_t) block->successor_hits[i] * 4 >= total * 3) {
+            return block->successors[i];
+        }
+    }
+    return NULL;
+}
+
+// 调用和返回结尾的基本块由返回地址栈预测，放在超级块末尾；--end_address 处的基本块留给执行循环检查
+static void form_trace(Block *head) {
+    Trace trace = {0};
+    Block *block = head;
+    trace.blocks[trace.length++] = head;
+    while (trace.length < TRACE_MAX_BLOCKS && block->exit_kind == 0) {
+        Block *next = hot_successor(block);
+        if (next == NULL || next->start_pc == block_stop_pc) {
+            break;
+        }
+        if (next == head) {
+            trace.loops = true;
+            break;
+        }
+        bool seen = false;
+        for (uint32_t i = 0; i < trace.length; i++) {
+            seen |= trace.blocks[i] == next;
+        }
+        if (seen) {
+            break;
+        }
+        trace.blocks[trace.length++] = next;
+        block = next;
+    }
+    if (trace.length == 1 && !trace.loops) {
+        return;
+    }
+    head->trace = malloc(sizeof(Trace));
+    if (head->trace != NULL) {
+        *head->trace = trace;
+    }
+}
+
+Block *block_next(CPU *cpu) {
+    Block *block = chain_next(cpu);
+    if (block->trace == NULL && block->exec_count >= TRACE_HOT_THRESHOLD &&
+        block->exec_count % TRACE_HOT_THRESHOLD == 0) {
+        form_trace(block);
+    }
+    return block;
+}
+
+void block_trace_side_exit(Block *head) {
+    Trace *trace = head->trace;
+    trace->side_exits++;
+    if (trace->side_exits >= TRACE_HOT_THRESHOLD && trace->side_exits * 2 > trace->entries) {
+        head->trace = NULL;
+        free(trace);
+    }
+}
+
+// 让入口在 page 页、与 [start, end) 重叠的有效基本块失效；返回是否还有有效基本块覆盖 code_page 页
+static bool invalidate_page_blocks(uint64_t page, uint64_t start, uint64_t end, uint64_t code_page, bool *hit) {
+    uint64_t page_start = MEMORY_BASE_ADDR + (code_page << MEMORY_PAGE_SHIFT);
+    bool live = false;
+    for (Block *block = page_blocks[page]; block != NULL; block = block->page_next) {
+        if (!block->valid) {
+            continue;
+        }
+        if (block->start_pc < end && start < block_end_pc(block)) {
+            // 失效的基本块下次进入时重新取指，指令没变时保留计数
+            block->valid = false;
+            *hit = true;
+        } else if (block_end_pc(block) > page_start) {
+            live = true;
+        }
+    }
+    return live;
+}
+
+void block_cache_code_write(uint64_t offset, uint64_t length) {
+    if (length == 0 || offset >= MEMORY_SIZE) {
+        return;
+    }
+    uint64_t start = MEMORY_BASE_ADDR + offset;
+    uint64_t end = start + length;
+    uint64_t last = (offset + length - 1) >> MEMORY_PAGE_SHIFT;
+    if (last >= MEMORY_NUM_PAGES) {
+        last = MEMORY_NUM_PAGES - 1;
+    }
+    bool hit = false;
+    for (uint64_t page = offset >> MEMORY_PAGE_SHIFT; page <= last; page++) {
+        if (!(memory_page_flags[page] & PAGE_FLAG_CODE)) {
+            continue;
+        }
+        // 入口在前一页的基本块可能跨进这一页
+        bool live = invalidate_page_blocks(page, start, end, page, &hit);
+        if (page > 0 && invalidate_page_blocks(page - 1, start, end, page, &hit)) {
+            live = true;
+        }
+        if (!live) {
+            // 页上只剩失效的基本块，它们重新取指时会再加上标志
+            memory_page_flags[page] &= ~PAGE_FLAG_CODE;
+        }
+    }
+    if (hit) {
+        // 可能改写了正在执行的基本块，执行完当前指令就离开
+        block_exit_requested = true;
+    }
+}
+
+void block_early_exit(Block *block, uint32_t executed) {
+    if (block->early_exits == NULL) {
+        block->early_exits = calloc(block->length, sizeof(uint64_t));
+        if (block->early_exits == NULL) {
+            return;
+        }
+    }
+    block->early_exits[executed - 1]++;
+}
+
+void block_settle_running(uint64_t instret) {
+    Block *block = block_running;
+    if (block == NULL) {
+        return;
+    }
+    block_running = NULL;
+    // 触发退出的那条指令已经生效，只是没来得及计入 minstret；块内改写过 minstret 时不补记
+    uint64_t executed = instret - block_running_instret + 1;
+    if (executed >= 1 && executed < block->length) {
+        block_early_exit(block, (uint32_t) executed);
+    }
+}
+
+uint64_t block_inst_count(const Block *block, uint32_t index) {
+    uint64_t count = block->exec_count;
+    if (block->early_exits != NULL) {
+        for (uint32_t i = 0; i < index; i++) {
+            count -= block->early_exits[i];
+        }
+    }
+    return count;
+}
+
+void block_cache_foreach(void (*callback)(const Block *block, void *arg), void *arg) {
+    for (uint32_t i = 0; i < BLOCK_HASH_SIZE; i++) {
+        for (Block *block = block_table[i]; block != NULL; block = block->next) {
+            callback(block, arg);
+        }
+    }
+}
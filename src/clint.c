@@ -3,11 +3,14 @@
 #include "clint.h"
 #include "cpu.h"
 #include "csr.h"
-#include "mfprintf.h"
+#include "event.h"
+#include "log.h"
 #include <string.h>
-#include <unistd.h>
+
+static void clint_timer_expired(CPU *cpu, void *opaque);
 
 static CLINT global_clint;
+static EventTimer clint_timer = EVENT_TIMER_INIT("clint", clint_timer_expired, NULL);
 
 void clint_init(CLINT *clint) {
     memset(clint, 0, sizeof(CLINT));
@@ -15,7 +18,8 @@ void clint_init(CLINT *clint) {
     for (int i = 0; i < MAX_HARTS; i++) {
         clint->mtimecmp[i] = 0xFFFFFFFFFFFFFFFF;
     }
-    clint->mtime = 0;
+    clint->mtime_offset = 0;
+    event_timer_del(&clint_timer);
 }
 
 CLINT* get_clint(void) {
@@ -31,7 +35,7 @@ uint64_t clint_read(uint64_t addr, uint32_t size) {
     } else if (offset >= 0x4000 && offset < 0x4000 + sizeof(clint->mtimecmp)) {
         return clint->mtimecmp[(offset - 0x4000) / sizeof(uint64_t)];
     } else if (offset == 0xBFF8) {
-        return clint->mtime;
+        return clint_get_mtime(clint);
     }
     return 0;
 }
@@ -44,31 +48,47 @@ void clint_write(uint64_t addr, uint64_t value, uint32_t size) {
     if (offset < sizeof(clint->msip)) {
         clint->msip[offset / sizeof(uint64_t)] = value;
         if (value != 0) {
-            cpu->csr[CSR_MIP] |= MIP_MSIP;
+            cpu->csr.mip |= MIP_MSIP;
         } else {
-            cpu->csr[CSR_MIP] &= ~MIP_MSIP;
+            cpu->csr.mip &= ~MIP_MSIP;
         }
 
     } else if (offset >= 0x4000 && offset < 0x4000 + sizeof(clint->mtimecmp)) {
         clint->mtimecmp[(offset - 0x4000) / sizeof(uint64_t)] = value;
+        update_timer_interrupt_pending(cpu);
     } else if (offset == 0xBFF8) {
-        clint->mtime = value;
+        clint->mtime_offset = value - event_now(cpu) / CLINT_INSTRET_PER_TICK;
+        update_timer_interrupt_pending(cpu);
     }
 }
 
-void *timer_loop(void *arg) {
-    CPU *cpu = (CPU *)arg;
-    while (true) {
-        // 精度：1ms
-        usleep(TIMER_INTERVAL_MS * 1000); // 暂停一段时间（微秒）
+uint64_t clint_get_mtime(CLINT *clint) {
+    return event_now(get_cpu()) / CLINT_INSTRET_PER_TICK + clint->mtime_offset;
+}
 
-        // 更新 mtime 寄存器
-        // cpu时钟1440MHz，每次暂停10ms，相当于cpu时钟走了14400个周期
-        cpu->clint->mtime += TIMER_INTERVAL_MS * 7000;
+// 到期时重新比较，MTIP/STIP 置位后由 update_timer_interrupt_pending 决定是否继续预约
+static void clint_timer_expired(CPU *cpu, void *opaque) {
+    (void) opaque;
+    update_timer_interrupt_pending(cpu);
+}
 
-        // 检查是否需要触发定时器中断
-        if (cpu->clint->mtime >= cpu->clint->mtimecmp[cpu->csr[CSR_MHARTID]]) {
-            cpu->csr[CSR_MIP] |= MIP_MTIP; // 设置定时器中断挂起位
-        }
+void clint_arm_timer(CLINT *clint, uint64_t compare) {
+    CPU *cpu = get_cpu();
+    uint64_t now = event_now(cpu);
+    uint64_t mtime = now / CLINT_INSTRET_PER_TICK + clint->mtime_offset;
+    if (compare == UINT64_MAX) {
+        event_timer_del(&clint_timer);
+        return;
+    }
+    if (compare <= mtime) {
+        event_timer_mod(&clint_timer, now);
+        return;
+    }
+    // mtime 到达 compare 的最早虚拟时间，溢出时视为永不到期
+    uint64_t now_ticks = now / CLINT_INSTRET_PER_TICK;
+    if (compare - mtime > UINT64_MAX / CLINT_INSTRET_PER_TICK - now_ticks) {
+        event_timer_del(&clint_timer);
+        return;
     }
+    event_timer_mod(&clint_timer, (now_ticks + (compare - mtime)) * CLINT_INSTRET_PER_TICK);
 }
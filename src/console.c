@@ -0,0 +1,43 @@
+#include <stdlib.h>
+#include <string.h>
+#include "console.h"
+
+bool console_enabled = false;
+FILE *console_file = NULL;
+static char *console_buffer = NULL;
+
+int console_open(const char *path) {
+    if (path == NULL || strcmp(path, "-") == 0) {
+        console_file = stdout;
+    } else {
+        console_file = fopen(path, "w");
+        if (console_file == NULL) {
+            perror("Failed to open console file");
+            return -1;
+        }
+    }
+    console_buffer = malloc(CONSOLE_BUFFER_SIZE);
+    if (console_buffer != NULL) {
+        setvbuf(console_file, console_buffer, _IOFBF, CONSOLE_BUFFER_SIZE);
+    }
+    console_enabled = true;
+    atexit(console_close);
+    return 0;
+}
+
+void console_close(void) {
+    if (!console_enabled) {
+        return;
+    }
+    console_enabled = false;
+    if (console_file == stdout) {
+        fflush(console_file);
+        // 缓冲区在 exit 之后仍可能被 stdio 使用，改回无缓冲后再释放
+        setvbuf(console_file, NULL, _IONBF, 0);
+    } else {
+        fclose(console_file);
+    }
+    console_file = NULL;
+    free(console_buffer);
+    console_buffer = NULL;
+}
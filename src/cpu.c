@@ -17,8 +17,9 @@
 #include "clint.h"
 #include "plic.h"
 #include "i_64_inst.h"
-#include "mfprintf.h"
+#include "log.h"
 #include "exception.h"
+#include "sampler.h"
 
 static CPU global_cpu;
 
@@ -34,8 +35,11 @@ void cpu_init(CPU *cpu, Memory *memory, CLINT *clint, PLIC *plic, UART *uart) {
     cpu->fast_mode = false;
     memset(cpu->registers, 0, sizeof(cpu->registers));
     memset(cpu->fregisters, 0, sizeof(cpu->fregisters));
-    memset(cpu->csr, 0, sizeof(cpu->csr));
+    memset(&cpu->csr, 0, sizeof(cpu->csr));
+    cpu->csr.stimecmp = UINT64_MAX; // 复位后不产生超级模式定时器中断
     init_mmu(&cpu->mmu);
+    cpu->shadow_stack = sampler_shadow_stack(cpu->csr.mhartid);
+    cpu->shadow_stack->depth = 0;
     // 初始化中断优先级
     cpu->current_priority = 0;
     cpu->clint = clint;
@@ -46,12 +50,11 @@ void cpu_init(CPU *cpu, Memory *memory, CLINT *clint, PLIC *plic, UART *uart) {
 
 void trigger_interrupt(CPU *cpu, int interrupt_id) {
     PLIC *plic = get_plic();
-    mfprintf("Keyboard Trigger\n");
-    plic->pending[interrupt_id >> 5] |= (1 << (interrupt_id & 0x1F));
-    cpu->csr[CSR_MIP] |= MIP_MEIP;
-    mfprintf("Keyboard Trigger interrupt %d, cpu->csr[CSR_MIP]: 0x%x, plic->pending[0]: 0x%x\n",
+    plic_set_pending(plic, interrupt_id);
+    cpu->csr.mip |= MIP_MEIP;
+    LOG_DEBUG(LOG_CAT_TRAP, "Trigger interrupt %d, mip: 0x%lx, plic->pending: 0x%x\n",
              interrupt_id,
-             cpu->csr[CSR_MIP],
+             cpu->csr.mip,
              plic->pending[interrupt_id >> 5]
     );
 }
@@ -124,7 +127,7 @@ void cpu_execute(CPU *cpu, uint32_t instruction) {
             execute_f_extension_instruction(cpu, instruction);
             break;
         default:
-            mfprintf("Unknown instruction with opcode: 0x%x\n", opcode);
+            LOG_WARN(LOG_CAT_CPU, "Unknown instruction with opcode: 0x%x\n", opcode);
     }
     if (!cpu->pc_updated) {
         cpu->pc += 4;
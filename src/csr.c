@@ -1,4 +1,5 @@
 #include <stdbool.h>
+#include <stddef.h>
 #include <unistd.h>  // 包含 usleep 函数的头文件
 
 #include "csr.h"
@@ -6,88 +7,428 @@
 #include "mmu.h"
 #include "plic.h"
 #include "exception.h"
+#include "event.h"
+
+// 根据 mtime 与 mtimecmp/stimecmp 的比较结果刷新 MTIP 和 STIP
+// Sstc: menvcfg.STCE 置位时 STIP 完全由 time >= stimecmp 决定，S 模式内核无需经过 M 模式固件即可设置定时器
+// 比较尚未成立的一侧在虚拟时间上预约下一次检查，不再依赖定时线程
+void update_timer_interrupt_pending(CPU *cpu) {
+    uint64_t mtime = clint_get_mtime(cpu->clint);
+    uint64_t mtimecmp = cpu->clint->mtimecmp[cpu->csr.mhartid];
+    uint64_t next_compare = UINT64_MAX;
+    if (mtime >= mtimecmp) {
+        cpu->csr.mip |= MIP_MTIP;
+    } else {
+        cpu->csr.mip &= ~MIP_MTIP;
+        next_compare = mtimecmp;
+    }
+
+    if (cpu->csr.menvcfg & MENVCFG_STCE) {
+        if (mtime >= cpu->csr.stimecmp) {
+            cpu->csr.mip |= MIP_STIP;
+        } else {
+            cpu->csr.mip &= ~MIP_STIP;
+            if (cpu->csr.stimecmp < next_compare) {
+                next_compare = cpu->csr.stimecmp;
+            }
+        }
+    }
+    clint_arm_timer(cpu->clint, next_compare);
+}
+
+// ---------------------------------------------------------------------------
+// 每个 CSR 的访问谓词和读写处理函数
+// ---------------------------------------------------------------------------
+
+typedef bool (*csr_predicate_t)(CPU *cpu, uint32_t csr);
+typedef uint64_t (*csr_read_t)(CPU *cpu);
+typedef void (*csr_write_t)(CPU *cpu, uint64_t value);
+
+typedef struct {
+    csr_predicate_t predicate; // 额外的访问条件，NULL 表示只按地址编码检查特权级
+    csr_read_t read;           // NULL 表示该 CSR 未实现
+    csr_write_t write;         // NULL 表示只读
+} CSROps;
+
+// 直接映射到 CSRState 字段的 CSR，write_mask 之外的位保持不变
+#define CSR_FIELD_OPS(name, write_mask)                                        \
+    static uint64_t read_##name(CPU *cpu) { return cpu->csr.name; }           \
+    static void write_##name(CPU *cpu, uint64_t value) {                       \
+        cpu->csr.name = (cpu->csr.name & ~(uint64_t) (write_mask)) | (value & (write_mask)); \
+    }
+
+CSR_FIELD_OPS(mscratch, ~0ULL)
+CSR_FIELD_OPS(mcause, ~0ULL)
+CSR_FIELD_OPS(mtval, ~0ULL)
+CSR_FIELD_OPS(mcounteren, COUNTEREN_MASK)
+CSR_FIELD_OPS(mie, SIE_SSIE | SIE_STIE | SIE_SEIE | MIE_MSIE | MIE_MTIE | MIE_MEIE)
+CSR_FIELD_OPS(sscratch, ~0ULL)
+CSR_FIELD_OPS(scause, ~0ULL)
+CSR_FIELD_OPS(stval, ~0ULL)
+CSR_FIELD_OPS(scounteren, COUNTEREN_MASK)
+// 没有 C 扩展，xepc[1:0] 恒为 0
+CSR_FIELD_OPS(mepc, ~3ULL)
+CSR_FIELD_OPS(sepc, ~3ULL)
+// 只代理超级模式中断；来自 M 模式的 ECALL 不能被代理
+CSR_FIELD_OPS(mideleg, SIP_SSIP | SIP_STIP | SIP_SEIP)
+CSR_FIELD_OPS(medeleg, ~(1ULL << CAUSE_MACHINE_ECALL))
+
+static uint64_t read_zero(CPU *cpu) {
+    (void) cpu;
+    return 0;
+}
+
+static uint64_t read_misa(CPU *cpu) {
+    (void) cpu;
+    return MISA_VALUE;
+}
+
+static uint64_t read_mhartid(CPU *cpu) {
+    return cpu->csr.mhartid;
+}
+
+static uint64_t read_mstatus(CPU *cpu) {
+    uint64_t mstatus = cpu->csr.mstatus | MSTATUS_XLEN_64;
+    if ((mstatus & SSTATUS_FS) == SSTATUS_FS) {
+        mstatus |= MSTATUS_SD;
+    }
+    return mstatus;
+}
+
+static void write_mstatus(CPU *cpu, uint64_t value) {
+    // MPP = 2 为保留值，保持原值
+    if (((value & MSTATUS_MPP) >> 11) == 2) {
+        value = (value & ~(uint64_t) MSTATUS_MPP) | (cpu->csr.mstatus & MSTATUS_MPP);
+    }
+    cpu->csr.mstatus = (cpu->csr.mstatus & ~(uint64_t) MSTATUS_WRITE_MASK) | (value & MSTATUS_WRITE_MASK);
+}
+
+static uint64_t read_sstatus(CPU *cpu) {
+    return read_mstatus(cpu) & (SSTATUS_MASK | MSTATUS_UXL | MSTATUS_SD);
+}
+
+static void write_sstatus(CPU *cpu, uint64_t value) {
+    cpu->csr.mstatus = (cpu->csr.mstatus & ~(uint64_t) SSTATUS_MASK) | (value & SSTATUS_MASK);
+}
+
+static uint64_t read_mip(CPU *cpu) {
+    return cpu->csr.mip;
+}
+
+static void write_mip(CPU *cpu, uint64_t value) {
+    // MSIP/MTIP/MEIP 由 CLINT/PLIC 驱动；Sstc 使能时 STIP 由 stimecmp 决定
+    uint64_t mask = SIP_SSIP | SIP_SEIP;
+    if (!(cpu->csr.menvcfg & MENVCFG_STCE)) {
+        mask |= MIP_STIP;
+    }
+    cpu->csr.mip = (cpu->csr.mip & ~mask) | (value & mask);
+}
+
+static uint64_t read_sie(CPU *cpu) {
+    return cpu->csr.mie & cpu->csr.mideleg;
+}
+
+static void write_sie(CPU *cpu, uint64_t value) {
+    cpu->csr.mie = (cpu->csr.mie & ~cpu->csr.mideleg) | (value & cpu->csr.mideleg);
+}
+
+static uint64_t read_sip(CPU *cpu) {
+    return cpu->csr.mip & cpu->csr.mideleg;
+}
+
+static void write_sip(CPU *cpu, uint64_t value) {
+    // S 模式只能写 SSIP
+    uint64_t mask = SIP_SSIP & cpu->csr.mideleg;
+    cpu->csr.mip = (cpu->csr.mip & ~mask) | (value & mask);
+}
+
+// xtvec 只支持 Direct 和 Vectored 模式，保留模式的写入保持原模式
+static uint64_t legalize_tvec(uint64_t old_value, uint64_t value) {
+    if ((value & TVEC_MODE_MASK) > TVEC_MODE_VECTORED) {
+        value = (value & ~(uint64_t) TVEC_MODE_MASK) | (old_value & TVEC_MODE_MASK);
+    }
+    return value;
+}
+
+static uint64_t read_mtvec(CPU *cpu) {
+    return cpu->csr.mtvec;
+}
+
+static void write_mtvec(CPU *cpu, uint64_t value) {
+    cpu->csr.mtvec = legalize_tvec(cpu->csr.mtvec, value);
+}
+
+static uint64_t read_stvec(CPU *cpu) {
+    return cpu->csr.stvec;
+}
+
+static void write_stvec(CPU *cpu, uint64_t value) {
+    cpu->csr.stvec = legalize_tvec(cpu->csr.stvec, value);
+}
+
+static uint64_t read_menvcfg(CPU *cpu) {
+    return cpu->csr.menvcfg;
+}
+
+static void write_menvcfg(CPU *cpu, uint64_t value) {
+    cpu->csr.menvcfg = value & (MENVCFG_STCE | MENVCFG_FIOM);
+    update_timer_interrupt_pending(cpu);
+}
+
+static uint64_t read_stimecmp(CPU *cpu) {
+    return cpu->csr.stimecmp;
+}
+
+static void write_stimecmp(CPU *cpu, uint64_t value) {
+    cpu->csr.stimecmp = value;
+    update_timer_interrupt_pending(cpu);
+}
+
+static uint64_t read_satp(CPU *cpu) {
+    return cpu->csr.satp;
+}
+
+static void write_satp(CPU *cpu, uint64_t value) {
+    uint64_t mode = value >> SATP_MODE_SHIFT;
+    // 不支持的模式整体忽略写入
+    if (mode != SATP_MODE_BARE && mode != SATP_MODE_SV39) {
+        return;
+    }
+    cpu->csr.satp = value;
+    // 地址空间切换，缓存的翻译全部失效
+    flush_tlb(&cpu->mmu);
+}
+
+static uint64_t read_fflags(CPU *cpu) {
+    return cpu->csr.fcsr & FCSR_FFLAGS_MASK;
+}
+
+static void write_fflags(CPU *cpu, uint64_t value) {
+    cpu->csr.fcsr = (cpu->csr.fcsr & ~(uint64_t) FCSR_FFLAGS_MASK) | (value & FCSR_FFLAGS_MASK);
+}
+
+static uint64_t read_frm(CPU *cpu) {
+    return (cpu->csr.fcsr >> FCSR_FRM_SHIFT) & FCSR_FRM_MASK;
+}
+
+static void write_frm(CPU *cpu, uint64_t value) {
+    cpu->csr.fcsr = (cpu->csr.fcsr & FCSR_FFLAGS_MASK) | ((value & FCSR_FRM_MASK) << FCSR_FRM_SHIFT);
+}
+
+static uint64_t read_fcsr(CPU *cpu) {
+    return cpu->csr.fcsr;
+}
+
+static void write_fcsr(CPU *cpu, uint64_t value) {
+    cpu->csr.fcsr = value & (FCSR_FFLAGS_MASK | (FCSR_FRM_MASK << FCSR_FRM_SHIFT));
+}
+
+static uint64_t read_time(CPU *cpu) {
+    return clint_get_mtime(cpu->clint);
+}
+
+static uint64_t read_minstret(CPU *cpu) {
+    return cpu->csr.minstret;
+}
+
+// 虚拟时钟和 mcycle 都以 minstret 为基准，软件改写 minstret 时用偏移抵消，保持两者连续
+static void write_minstret(CPU *cpu, uint64_t value) {
+    event_clock_bias += cpu->csr.minstret - value;
+    cpu->csr.mcycle_offset += cpu->csr.minstret - value;
+    cpu->csr.minstret = value;
+}
+
+// 每条指令计一个周期：mcycle 跟随 minstret，软件改写 mcycle 时只调整偏移
+static uint64_t read_mcycle(CPU *cpu) {
+    return cpu->csr.minstret + cpu->csr.mcycle_offset;
+}
+
+static void write_mcycle(CPU *cpu, uint64_t value) {
+    cpu->csr.mcycle_offset = value - cpu->csr.minstret;
+}
+
+static uint64_t read_instret(CPU *cpu) {
+    return cpu->csr.minstret;
+}
+
+// cycle/time/instret：低特权级的访问需要 mcounteren (以及 U 模式下的 scounteren) 中对应位使能
+static bool counter_predicate(CPU *cpu, uint32_t csr) {
+    uint64_t bit = 1ULL << (csr - CSR_CYCLE);
+    if (cpu->priv < PRV_M && !(cpu->csr.mcounteren & bit)) {
+        return false;
+    }
+    if (cpu->priv < PRV_S && !(cpu->csr.scounteren & bit)) {
+        return false;
+    }
+    return true;
+}
+
+// stimecmp：低于 M 模式访问需要 menvcfg.STCE 和 mcounteren.TM
+static bool stimecmp_predicate(CPU *cpu, uint32_t csr) {
+    (void) csr;
+    if (cpu->priv == PRV_M) {
+        return true;
+    }
+    return (cpu->csr.menvcfg & MENVCFG_STCE) && (cpu->csr.mcounteren & COUNTEREN_TM);
+}
+
+// satp：mstatus.TVM 置位时 S 模式访问非法
+static bool satp_predicate(CPU *cpu, uint32_t csr) {
+    (void) csr;
+    return !(cpu->priv == PRV_S && (cpu->csr.mstatus & MSTATUS_TVM));
+}
+
+#define CSR_RW(name) { NULL, read_##name, write_##name }
+#define CSR_RO(name) { NULL, read_##name, NULL }
+
+// 以 CSR 地址为下标的处理函数表，未列出的 CSR 视为未实现
+static const CSROps csr_ops[MAX_CSR_INDEX + 1] = {
+        [CSR_FFLAGS]     = CSR_RW(fflags),
+        [CSR_FRM]        = CSR_RW(frm),
+        [CSR_FCSR]       = CSR_RW(fcsr),
+        [CSR_CYCLE]      = { counter_predicate, read_mcycle, NULL },
+        [CSR_TIME]       = { counter_predicate, read_time, NULL },
+        [CSR_INSTRET]    = { counter_predicate, read_instret, NULL },
+
+        [CSR_SSTATUS]    = CSR_RW(sstatus),
+        [CSR_SIE]        = CSR_RW(sie),
+        [CSR_STVEC]      = CSR_RW(stvec),
+        [CSR_SCOUNTEREN] = CSR_RW(scounteren),
+        [CSR_SSCRATCH]   = CSR_RW(sscratch),
+        [CSR_SEPC]       = CSR_RW(sepc),
+        [CSR_SCAUSE]     = CSR_RW(scause),
+        [CSR_STVAL]      = CSR_RW(stval),
+        [CSR_SIP]        = CSR_RW(sip),
+        [CSR_STIMECMP]   = { stimecmp_predicate, read_stimecmp, write_stimecmp },
+        [CSR_SATP]       = { satp_predicate, read_satp, write_satp },
+
+        [CSR_MVENDORID]  = CSR_RO(zero),
+        [CSR_MARCHID]    = CSR_RO(zero),
+        [CSR_MIMPID]     = CSR_RO(zero),
+        [CSR_MHARTID]    = CSR_RO(mhartid),
+        [CSR_MSTATUS]    = CSR_RW(mstatus),
+        [CSR_MISA]       = { NULL, read_misa, NULL },
+        [CSR_MEDELEG]    = CSR_RW(medeleg),
+        [CSR_MIDELEG]    = CSR_RW(mideleg),
+        [CSR_MIE]        = CSR_RW(mie),
+        [CSR_MTVEC]      = CSR_RW(mtvec),
+        [CSR_MCOUNTEREN] = CSR_RW(mcounteren),
+        [CSR_MENVCFG]    = CSR_RW(menvcfg),
+        [CSR_MSCRATCH]   = CSR_RW(mscratch),
+        [CSR_MEPC]       = CSR_RW(mepc),
+        [CSR_MCAUSE]     = CSR_RW(mcause),
+        [CSR_MTVAL]      = CSR_RW(mtval),
+        [CSR_MIP]        = CSR_RW(mip),
+        [CSR_MCYCLE]     = CSR_RW(mcycle),
+        [CSR_MINSTRET]   = CSR_RW(minstret),
+};
+
+// 检查当前特权级能否访问该 CSR：未实现、特权级不足、写只读 CSR 以及谓词不满足都视为非法
+static bool csr_accessible(CPU *cpu, uint32_t csr, bool is_write) {
+    const CSROps *ops = &csr_ops[csr];
+    if (ops->read == NULL) {
+        return false;
+    }
+    if (cpu->priv < CSR_MIN_PRIV(csr)) {
+        return false;
+    }
+    if (is_write && (CSR_IS_READ_ONLY(csr) || ops->write == NULL)) {
+        return false;
+    }
+    if (ops->predicate != NULL && !ops->predicate(cpu, csr)) {
+        return false;
+    }
+    return true;
+}
 
 // 读取 CSR 寄存器的值
 uint64_t read_csr(CPU *cpu, uint32_t csr) {
-    if (csr < 4096) {
-        return cpu->csr[csr];
+    if (csr <= MAX_CSR_INDEX && csr_ops[csr].read != NULL) {
+        return csr_ops[csr].read(cpu);
     }
     return 0;
 }
 
 // 写入 CSR 寄存器
 void write_csr(CPU *cpu, uint32_t csr, uint64_t value) {
-    if (csr < 4096) {
-        cpu->csr[csr] = value;
+    if (csr <= MAX_CSR_INDEX && csr_ops[csr].write != NULL) {
+        csr_ops[csr].write(cpu, value);
     }
 }
 
-// CSRRW 指令实现
-void execute_csrrw(CPU *cpu, uint32_t instruction) {
+// CSR 指令的公共实现：
+// 1. 检查访问权限，非法访问触发非法指令异常
+// 2. CSRRW/CSRRWI 在 rd == x0 时不读 CSR；CSRRS/CSRRC 在源操作数为 x0/0 时不写 CSR
+// 3. 写入新值，并将旧值写入 rd
+static void execute_csr_op(CPU *cpu, uint32_t instruction, uint32_t funct3) {
     uint32_t rd = RD(instruction);
     uint32_t rs1 = RS1(instruction);
     uint32_t csr = (instruction >> 20) & 0xFFF;
-    uint64_t old_value = read_csr(cpu, csr);
-    write_csr(cpu, csr, cpu->registers[rs1]);
+    bool is_imm = funct3 >= OPCODE_CSRRWI;
+    uint64_t operand = is_imm ? rs1 : cpu->registers[rs1];
+    uint32_t op = funct3 & 0x3;
+    bool do_read = op != OPCODE_CSRRW || rd != 0;
+    bool do_write = op == OPCODE_CSRRW || rs1 != 0;
+
+    if (!csr_accessible(cpu, csr, do_write)) {
+        raise_exception_with_tval(cpu, CAUSE_ILLEGAL_INSTRUCTION, instruction);
+        return;
+    }
+
+    uint64_t old_value = do_read ? csr_ops[csr].read(cpu) : 0;
+    if (do_write) {
+        uint64_t new_value;
+        switch (op) {
+            case OPCODE_CSRRW:
+                new_value = operand;
+                break;
+            case OPCODE_CSRRS:
+                new_value = old_value | operand;
+                break;
+            case OPCODE_CSRRC:
+            default:
+                new_value = old_value & ~operand;
+                break;
+        }
+        csr_ops[csr].write(cpu, new_value);
+    }
     cpu->registers[rd] = old_value;
 }
 
+// CSRRW 指令实现
+void execute_csrrw(CPU *cpu, uint32_t instruction) {
+    execute_csr_op(cpu, instruction, OPCODE_CSRRW);
+}
+
 // CSRRS 指令实现 - 含义是：CSR Read and Set
 void execute_csrrs(CPU *cpu, uint32_t instruction) {
     /**
      * 1. 从指令中提取 rd, rs1, csr
      * 2. 读取 csr 寄存器的值
-     * 3. 将 rs1 寄存器的值写入 csr 寄存器
-     * 4. 将 csr 寄存器的值写入 rd 寄存器
+     * 3. 将 csr 寄存器的值与 rs1 寄存器的值进行按位或后的结果写入 csr 寄存器
+     * 4. 将 csr 寄存器的旧值写入 rd 寄存器
      */
-    uint32_t rd = RD(instruction);
-    uint32_t rs1 = RS1(instruction);
-    uint32_t csr = (instruction >> 20) & 0xFFF;
-    uint64_t old_value = read_csr(cpu, csr);
-    // 将 csr 寄存器的值与 rs1 寄存器的值进行按位或后的结果写入 csr 寄存器
-    write_csr(cpu, csr, old_value | cpu->registers[rs1]);
-    cpu->registers[rd] = old_value;
+    execute_csr_op(cpu, instruction, OPCODE_CSRRS);
 }
 
 // CSRRC 指令实现 - 目的是：CSR Read and Clear
 void execute_csrrc(CPU *cpu, uint32_t instruction) {
-    uint32_t rd = RD(instruction);
-    uint32_t rs1 = RS1(instruction);
-    uint32_t csr = (instruction >> 20) & 0xFFF;
-    uint64_t old_value = read_csr(cpu, csr);
-    // 将 csr 寄存器的值与 rs1 寄存器的值进行按位取反后的结果写入 csr 寄存器
-    write_csr(cpu, csr, old_value & ~cpu->registers[rs1]);
-    cpu->registers[rd] = old_value;
+    execute_csr_op(cpu, instruction, OPCODE_CSRRC);
 }
 
 // CSRRWI 指令实现 - 目的是：CSR Read and Write Immediate
 void execute_csrrwi(CPU *cpu, uint32_t instruction) {
-    uint32_t rd = RD(instruction);
-    uint32_t imm = RS1(instruction);
-    uint32_t csr = (instruction >> 20) & 0xFFF;
-    uint64_t old_value = read_csr(cpu, csr);
-    write_csr(cpu, csr, imm);
-    cpu->registers[rd] = old_value;
+    execute_csr_op(cpu, instruction, OPCODE_CSRRWI);
 }
 
 // CSRRSI 指令实现 - 目的是：CSR Read and Set Immediate
 void execute_csrrsi(CPU *cpu, uint32_t instruction) {
-    uint32_t rd = RD(instruction);
-    uint32_t imm = RS1(instruction);
-    uint32_t csr = (instruction >> 20) & 0xFFF;
-    uint64_t old_value = read_csr(cpu, csr);
-    write_csr(cpu, csr, old_value | imm);
-    cpu->registers[rd] = old_value;
+    execute_csr_op(cpu, instruction, OPCODE_CSRRSI);
 }
 
 // CSRRCI 指令实现 - 目的是：CSR Read and Clear Immediate
 void execute_csrrci(CPU *cpu, uint32_t instruction) {
-    uint32_t rd = RD(instruction);
-    uint32_t imm = RS1(instruction);
-    uint32_t csr = (instruction >> 20) & 0xFFF;
-    uint64_t old_value = read_csr(cpu, csr);
-    write_csr(cpu, csr, old_value & ~imm);
-    cpu->registers[rd] = old_value;
+    execute_csr_op(cpu, instruction, OPCODE_CSRRCI);
 }
 
 // MRET 指令实现 - 目的是：Machine-mode Return
@@ -110,7 +451,7 @@ void execute_mret(CPU *cpu) {
     mstatus |= MSTATUS_MPIE;  // 清除 MPIE 字段
     write_csr(cpu, CSR_MSTATUS, mstatus);
 
-    cpu->pc = cpu->csr[CSR_MEPC];
+    cpu->pc = cpu->csr.mepc;
     // 重置当前处理的中断优先级
     cpu->current_priority = 0;
     cpu->pc_updated = true;
@@ -140,7 +481,7 @@ void execute_sret(CPU *cpu) {
     // 更新 SSTATUS 寄存器
     write_csr(cpu, CSR_SSTATUS, sstatus);
     // 恢复程序计数器
-    cpu->pc = cpu->csr[CSR_SEPC];
+    cpu->pc = cpu->csr.sepc;
     cpu->pc_updated = true;
     // 重置当前处理的中断优先级
     cpu->current_priority = 0;
@@ -148,14 +489,6 @@ void execute_sret(CPU *cpu) {
 }
 
 
-// URET 指令实现 - 目的是：User-mode Return
-void execute_uret(CPU *cpu) {
-    cpu->pc = cpu->csr[CSR_UEPC];
-    cpu->pc_updated = true;
-    cpu->priv = (cpu->csr[CSR_USTATUS] >> 8) & 0x1;
-    cpu->current_priority = 0;
-}
-
 // 假设这是模拟的内存屏障操作
 void flush_write_buffers(CPU *cpu) {
     // 在实际硬件上，这可能是一个内存屏障指令
@@ -163,38 +496,27 @@ void flush_write_buffers(CPU *cpu) {
 
 }
 
-// 假设这是模拟的指令缓存失效操作
+// 指令缓存失效：基本块缓存按物理地址索引，写入代码页时已经逐块失效 (见 block.h)，没有需要丢弃的内容
 void flush_instruction_cache(CPU *cpu) {
-    // 在实际硬件上，这可能是一个指令缓存失效指令
-    // 在模拟器中，可以只是一个占位操作
-
 }
 
+// rs1 为 x0 时刷新所有地址，rs2 为 x0 时刷新所有地址空间；基本块缓存不按虚拟地址索引，不受影响
 void execute_sfence_vma(CPU *cpu, uint32_t instruction) {
-    // 通常需要刷新 TLB 或其他地址翻译缓存
-    // 在模拟器中可能需要根据具体实现刷新缓存
-    // 这里只是一个示例实现
     uint32_t rs1 = RS1(instruction);
     uint32_t rs2 = RS2(instruction);
 
-    // 刷新所有地址翻译缓存
     if (rs1 == 0 && rs2 == 0) {
         flush_tlb(&cpu->mmu);
     } else {
-        // 根据具体地址和 ASID 刷新
-        uint64_t vaddr = cpu->registers[rs1];
-        uint64_t asid = cpu->registers[rs2];
+        uint64_t vaddr = rs1 == 0 ? TLB_MATCH_ALL : cpu->registers[rs1];
+        uint64_t asid = rs2 == 0 ? TLB_MATCH_ALL : cpu->registers[rs2] & 0xFFFF;
         flush_tlb_entry(&cpu->mmu, vaddr, asid);
     }
 }
 
 void execute_sinval_vma(CPU *cpu, uint32_t instruction) {
-    uint32_t rs1 = RS1(instruction);
-    uint32_t rs2 = RS2(instruction);
-
-    uint64_t vaddr = cpu->registers[rs1];
-    uint64_t asid = cpu->registers[rs2];
-    flush_tlb_entry(&cpu->mmu, vaddr, asid);
+    // 与 SFENCE.VMA 的失效范围相同，排序由 SFENCE.W.INVAL / SFENCE.INVAL.IR 保证
+    execute_sfence_vma(cpu, instruction);
 }
 
 void execute_sfence_w_inval(CPU *cpu, uint32_t instruction) {
@@ -228,15 +550,38 @@ void execute_ecall(CPU *cpu) {
     }
     raise_exception(cpu, cause);
 }
+
+// SFENCE.VMA / SINVAL.VMA 在 U 模式或 mstatus.TVM 置位时的 S 模式非法，SFENCE.W.INVAL / SFENCE.INVAL.IR 在 U 模式非法
+static void execute_sfence_instruction(CPU *cpu, uint32_t instruction) {
+    uint32_t funct7 = instruction >> 25;
+    bool trapped_by_tvm = funct7 != FUNCT7_SFENCE_INVAL && cpu->priv == PRV_S && (cpu->csr.mstatus & MSTATUS_TVM);
+    if (cpu->priv == PRV_U || trapped_by_tvm) {
+        raise_exception_with_tval(cpu, CAUSE_ILLEGAL_INSTRUCTION, instruction);
+        return;
+    }
+    switch (funct7) {
+        case FUNCT7_SFENCE_VMA:
+            execute_sfence_vma(cpu, instruction);
+            break;
+        case FUNCT7_SINVAL_VMA:
+            execute_sinval_vma(cpu, instruction);
+            break;
+        default:
+            if (RS2(instruction) == 0) {
+                execute_sfence_w_inval(cpu, instruction);
+            } else if (RS2(instruction) == 1) {
+                execute_sfence_inval_ir(cpu, instruction);
+            } else {
+                raise_exception_with_tval(cpu, CAUSE_ILLEGAL_INSTRUCTION, instruction);
+            }
+            break;
+    }
+}
+
 void execute_system_instruction(CPU *cpu, uint32_t instruction) {
     uint32_t funct3 = (instruction >> 12) & 0x7;
     if (funct3 >= 0x1 && funct3 <= 0x7) {
-        // CSR 操作指令处理
-        if (cpu->priv == PRV_U && funct3 != OPCODE_CSRRWI && funct3 != OPCODE_CSRRSI && funct3 != OPCODE_CSRRCI) {
-            // 用户模式下，只允许 CSRRWI, CSRRSI, CSRRCI 指令
-            raise_exception(cpu, CAUSE_ILLEGAL_INSTRUCTION);
-            return;
-        }
+        // CSR 操作指令处理，访问权限由 execute_csr_op 根据 CSR 地址和处理函数表检查
         switch (funct3) {
             case OPCODE_CSRRW: // CSRRW
                 execute_csrrw(cpu, instruction);
@@ -260,6 +605,9 @@ void execute_system_instruction(CPU *cpu, uint32_t instruction) {
                 raise_exception(cpu, CAUSE_ILLEGAL_INSTRUCTION);
                 break;
         }
+    } else if ((instruction >> 25) == FUNCT7_SFENCE_VMA || (instruction >> 25) == FUNCT7_SINVAL_VMA ||
+               (instruction >> 25) == FUNCT7_SFENCE_INVAL) {
+        execute_sfence_instruction(cpu, instruction);
     } else {
         // 系统指令处理
         uint32_t imm = instruction >> 20;
@@ -268,7 +616,7 @@ void execute_system_instruction(CPU *cpu, uint32_t instruction) {
                 execute_ecall(cpu);
                 break;
             case OPCODE_EBREAK:
-                raise_exception(cpu, CAUSE_BREAKPOINT);
+                raise_exception_with_tval(cpu, CAUSE_BREAKPOINT, cpu->pc);
                 break;
             case OPCODE_SRET:
                 // SRET
@@ -279,22 +627,13 @@ void execute_system_instruction(CPU *cpu, uint32_t instruction) {
                 execute_mret(cpu);
                 break;
             case OPCODE_URET:
-                // URET
-                execute_uret(cpu);
+                // URET 属于未实现的 N 扩展
+                raise_exception_with_tval(cpu, CAUSE_ILLEGAL_INSTRUCTION, instruction);
                 break;
             case OPCODE_WFI:
                 // WFI (Wait For Interrupt)
-                // 模拟处理器等待中断
-                // 在实际的模拟器中，这里可能需要实现一个事件循环或等待条件变量。
-                // 在这里，我们使用一个简单的循环来模拟等待中断。
-//                while (true) {
-//                    // 先检查并处理中断
-//                    bool result = handle_interrupt(cpu);
-//                    if (result) {
-//                        break;
-//                    }
-//                    usleep(1000);
-//                }
+                // 没有待处理的中断时把虚拟时钟快进到下一个设备事件，空闲的客户机不再空转到定时器到期
+                event_skip_idle(cpu);
                 break;
             default:
                 raise_exception(cpu, CAUSE_ILLEGAL_INSTRUCTION);
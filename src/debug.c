@@ -0,0 +1,365 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "debug.h"
+#include "memory.h"
+#include "cpu.h"
+#include "block.h"
+
+typedef struct {
+    uint64_t address;
+    uint64_t length;
+    WatchType type;         // 0 表示空槽
+} Watchpoint;
+
+// 观察点覆盖的每一页对应一个链接，挂在 watch_buckets[页号 % DEBUG_WATCH_BUCKETS] 上
+// 下标都存 +1 的值，0 表示空，这样静态清零就是合法的初始状态
+typedef struct {
+    uint32_t page;
+    uint16_t watch;         // watchpoints 的下标 + 1
+    uint16_t next;
+} WatchLink;
+
+bool debug_stop_pending = false;
+DebugStop debug_stop;
+int debug_breakpoint_count = 0;
+
+static uint64_t breakpoints[DEBUG_MAX_BREAKPOINTS];
+static uint32_t breakpoint_types[DEBUG_MAX_BREAKPOINTS];
+static Watchpoint watchpoints[DEBUG_MAX_WATCHPOINTS];
+static int watchpoint_count = 0;
+static WatchLink watch_links[DEBUG_WATCH_LINKS];
+static uint16_t watch_buckets[DEBUG_WATCH_BUCKETS];
+static uint16_t free_links = 0;     // 回收的链接组成的空闲链表
+static uint16_t fresh_links = 0;    // 从未用过的链接从这里往后分配
+static uint32_t links_in_use = 0;
+static uint64_t skip_pc = DEBUG_NO_PC;
+
+static inline bool in_memory(uint64_t address, uint64_t length) {
+    return address >= MEMORY_BASE_ADDR && address < MEMORY_END_ADDR && length <= MEMORY_END_ADDR - address;
+}
+
+void debug_set_stop(DebugStopReason reason, uint64_t address, WatchType watch_type) {
+    CPU *cpu = get_cpu();
+    memset(&debug_stop, 0, sizeof(debug_stop));
+    debug_stop.reason = reason;
+    debug_stop.address = address;
+    debug_stop.watch_type = watch_type;
+    debug_stop.pc = cpu->pc;
+    debug_stop.instret = cpu->csr.minstret;
+}
+
+void debug_request_stop(DebugStopReason reason, uint64_t address, WatchType watch_type) {
+    if (debug_stop_pending) {
+        return;
+    }
+    debug_set_stop(reason, address, watch_type);
+    debug_stop_pending = true;
+    block_exit_requested = true;
+}
+
+// 删除断点后，页上没有其他断点时才去掉页标志
+static void refresh_breakpoint_page(uint64_t pc) {
+    uint64_t page = (pc - MEMORY_BASE_ADDR) >> MEMORY_PAGE_SHIFT;
+    for (int i = 0; i < debug_breakpoint_count; i++) {
+        if (((breakpoints[i] - MEMORY_BASE_ADDR) >> MEMORY_PAGE_SHIFT) == page) {
+            return;
+        }
+    }
+    memory_page_flags[page] &= ~PAGE_FLAG_BREAKPOINT;
+}
+
+bool debug_breakpoint_insert(uint64_t pc, BreakpointType type) {
+    if (!in_memory(pc, 4)) {
+        return false;
+    }
+    for (int i = 0; i < debug_breakpoint_count; i++) {
+        if (breakpoints[i] == pc) {
+            breakpoint_types[i] |= type;
+            return true;
+        }
+    }
+    if (debug_breakpoint_count >= DEBUG_MAX_BREAKPOINTS) {
+        return false;
+    }
+    breakpoint_types[debug_breakpoint_count] = type;
+    breakpoints[debug_breakpoint_count++] = pc;
+    memory_page_flags[(pc - MEMORY_BASE_ADDR) >> MEMORY_PAGE_SHIFT] |= PAGE_FLAG_BREAKPOINT;
+    return true;
+}
+
+bool debug_breakpoint_remove(uint64_t pc, BreakpointType type) {
+    for (int i = 0; i < debug_breakpoint_count; i++) {
+        if (breakpoints[i] == pc) {
+            if (!(breakpoint_types[i] & type)) {
+                return false;
+            }
+            breakpoint_types[i] &= ~type;
+            if (breakpoint_types[i] != 0) {
+                return true;
+            }
+            debug_breakpoint_count--;
+            breakpoints[i] = breakpoints[debug_breakpoint_count];
+            breakpoint_types[i] = breakpoint_types[debug_breakpoint_count];
+            refresh_breakpoint_page(pc);
+            if (skip_pc == pc) {
+                skip_pc = DEBUG_NO_PC;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t debug_breakpoint_types(uint64_t pc) {
+    for (int i = 0; i < debug_breakpoint_count; i++) {
+        if (breakpoints[i] == pc) {
+            return breakpoint_types[i];
+        }
+    }
+    return 0;
+}
+
+bool debug_breakpoint_hit(uint64_t pc) {
+    if (pc == skip_pc) {
+        skip_pc = DEBUG_NO_PC;
+        return false;
+    }
+    for (int i = 0; i < debug_breakpoint_count; i++) {
+        if (breakpoints[i] == pc) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void debug_resume(uint64_t pc) {
+    skip_pc = DEBUG_NO_PC;
+    for (int i = 0; i < debug_breakpoint_count; i++) {
+        if (breakpoints[i] == pc) {
+            skip_pc = pc;
+            break;
+        }
+    }
+}
+
+static inline uint16_t *watch_bucket(uint32_t page) {
+    return &watch_buckets[page & (DEBUG_WATCH_BUCKETS - 1)];
+}
+
+static uint16_t link_alloc(void) {
+    uint16_t link = free_links;
+    if (link != 0) {
+        free_links = watch_links[link - 1].next;
+    } else {
+        link = ++fresh_links;
+    }
+    links_in_use++;
+    return link;
+}
+
+static void link_free(uint16_t link) {
+    watch_links[link - 1].next = free_links;
+    free_links = link;
+    links_in_use--;
+}
+
+static bool page_watched(uint32_t page) {
+    for (uint16_t link = *watch_bucket(page); link != 0; link = watch_links[link - 1].next) {
+        if (watch_links[link - 1].page == page) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool debug_watchpoint_insert(uint64_t address, uint64_t length, WatchType type) {
+    if (length == 0 || !in_memory(address, length) || watchpoint_count >= DEBUG_MAX_WATCHPOINTS) {
+        return false;
+    }
+    uint64_t offset = address - MEMORY_BASE_ADDR;
+    uint32_t first = offset >> MEMORY_PAGE_SHIFT;
+    uint32_t last = (offset + length - 1) >> MEMORY_PAGE_SHIFT;
+    if (links_in_use + (last - first + 1) > DEBUG_WATCH_LINKS) {
+        return false;
+    }
+    int slot = 0;
+    while (watchpoints[slot].type != 0) {
+        slot++;
+    }
+    watchpoints[slot].address = address;
+    watchpoints[slot].length = length;
+    watchpoints[slot].type = type;
+    watchpoint_count++;
+    for (uint32_t page = first; page <= last; page++) {
+        uint16_t link = link_alloc();
+        watch_links[link - 1].page = page;
+        watch_links[link - 1].watch = (uint16_t) (slot + 1);
+        watch_links[link - 1].next = *watch_bucket(page);
+        *watch_bucket(page) = link;
+        memory_page_flags[page] |= PAGE_FLAG_WATCH;
+    }
+    return true;
+}
+
+bool debug_watchpoint_remove(uint64_t address, uint64_t length, WatchType type) {
+    for (int slot = 0; slot < DEBUG_MAX_WATCHPOINTS; slot++) {
+        Watchpoint *watchpoint = &watchpoints[slot];
+        if (watchpoint->type != type || watchpoint->address != address || watchpoint->length != length) {
+            continue;
+        }
+        uint64_t offset = address - MEMORY_BASE_ADDR;
+        uint32_t last = (offset + length - 1) >> MEMORY_PAGE_SHIFT;
+        for (uint32_t page = offset >> MEMORY_PAGE_SHIFT; page <= last; page++) {
+            uint16_t *prev = watch_bucket(page);
+            while (*prev != 0) {
+                WatchLink *link = &watch_links[*prev - 1];
+                if (link->page == page && link->watch == slot + 1) {
+                    uint16_t unlinked = *prev;
+                    *prev = link->next;
+                    link_free(unlinked);
+                    break;
+                }
+                prev = &link->next;
+            }
+            // 页上没有其他观察点时才去掉页标志
+            if (!page_watched(page)) {
+                memory_page_flags[page] &= ~PAGE_FLAG_WATCH;
+            }
+        }
+        watchpoint->type = 0;
+        watchpoint_count--;
+        return true;
+    }
+    return false;
+}
+
+static uint64_t load_little_endian(const uint8_t *data, uint32_t size) {
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < size; i++) {
+        value |= (uint64_t) data[i] << (8 * i);
+    }
+    return value;
+}
+
+// 访问 [offset, offset + size) 与观察点 [start, end) 的重叠部分是否满足观察条件
+static bool watch_matches(const Watchpoint *watchpoint, uint64_t start, uint64_t end, uint64_t offset,
+                          uint32_t size, bool is_write, uint64_t value) {
+    if (watchpoint->type & (is_write ? WATCH_WRITE : WATCH_READ)) {
+        return true;
+    }
+    if (watchpoint->type != WATCH_CHANGE || !is_write) {
+        return false;
+    }
+    const uint8_t *data = get_cpu()->memory->data;
+    uint64_t from = offset > start ? offset : start;
+    uint64_t to = offset + size < end ? offset + size : end;
+    for (uint64_t byte = from; byte < to; byte++) {
+        if (data[byte] != (uint8_t) (value >> (8 * (byte - offset)))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void debug_watch_access(uint64_t offset, uint32_t size, bool is_write, uint64_t value) {
+    if (debug_stop_pending) {
+        return;
+    }
+    uint32_t first = offset >> MEMORY_PAGE_SHIFT;
+    uint32_t last = (offset + size - 1) >> MEMORY_PAGE_SHIFT;
+    for (uint32_t page = first; page <= last; page++) {
+        for (uint16_t link = *watch_bucket(page); link != 0; link = watch_links[link - 1].next) {
+            if (watch_links[link - 1].page != page) {
+                continue;
+            }
+            Watchpoint *watchpoint = &watchpoints[watch_links[link - 1].watch - 1];
+            uint64_t start = watchpoint->address - MEMORY_BASE_ADDR;
+            uint64_t end = start + watchpoint->length;
+            if (offset >= end || start >= offset + size ||
+                !watch_matches(watchpoint, start, end, offset, size, is_write, value)) {
+                continue;
+            }
+            // 报告的是观察点类型 (awatch 报 ACCESS)，不是这次访问的方向
+            WatchType reported = watchpoint->type == WATCH_ACCESS || watchpoint->type == WATCH_CHANGE ?
+                                 watchpoint->type : (is_write ? WATCH_WRITE : WATCH_READ);
+            debug_request_stop(DEBUG_STOP_WATCHPOINT, (offset > start ? offset : start) + MEMORY_BASE_ADDR, reported);
+            debug_stop.access_address = offset + MEMORY_BASE_ADDR;
+            debug_stop.access_size = size;
+            debug_stop.access_write = is_write;
+            debug_stop.old_value = load_little_endian(get_cpu()->memory->data + offset, size);
+            debug_stop.new_value = is_write ? value : debug_stop.old_value;
+            return;
+        }
+    }
+}
+
+int debug_watch_open(const char *spec) {
+    const char *cursor = spec;
+    while (*cursor != '\0') {
+        WatchType type;
+        switch (cursor[0]) {
+            case 'r': type = WATCH_READ; break;
+            case 'w': type = WATCH_WRITE; break;
+            case 'a': type = WATCH_ACCESS; break;
+            case 'c': type = WATCH_CHANGE; break;
+            default: type = 0; break;
+        }
+        if (type == 0 || cursor[1] != ':') {
+            fprintf(stderr, "Invalid watchpoint '%s': expected <r|w|a|c>:<address>[+<length>]\n", cursor);
+            return -1;
+        }
+        char *end;
+        uint64_t address = strtoull(cursor + 2, &end, 0);
+        uint64_t length = 4;
+        if (*end == '+') {
+            length = strtoull(end + 1, &end, 0);
+        }
+        if (end == cursor + 2 || (*end != ',' && *end != '\0')) {
+            fprintf(stderr, "Invalid watchpoint '%s': expected <r|w|a|c>:<address>[+<length>]\n", cursor);
+            return -1;
+        }
+        if (!debug_watchpoint_insert(address, length, type)) {
+            fprintf(stderr, "Cannot watch 0x%lx+%lu: outside RAM or too many watchpoints\n", address, length);
+            return -1;
+        }
+        cursor = *end == ',' ? end + 1 : end;
+    }
+    return 0;
+}
+
+void debug_format_stop(const DebugStop *stop, char *buffer, size_t size) {
+    static const char *watch_names[] = {"", "write", "read", "access", "change"};
+    switch (stop->reason) {
+        case DEBUG_STOP_BREAKPOINT:
+            snprintf(buffer, size, "breakpoint at 0x%lx, instret %lu", stop->pc, stop->instret);
+            break;
+        case DEBUG_STOP_WATCHPOINT:
+            snprintf(buffer, size, "%s watch: %s%u 0x%lx pc 0x%lx 0x%lx->0x%lx, instret %lu",
+                     watch_names[stop->watch_type], stop->access_write ? "st" : "ld", stop->access_size,
+                     stop->access_address, stop->pc, stop->old_value, stop->new_value, stop->instret);
+            break;
+        case DEBUG_STOP_HISTORY_BEGIN:
+            snprintf(buffer, size, "reached start of history at 0x%lx, instret %lu", stop->pc, stop->instret);
+            break;
+        default:
+            snprintf(buffer, size, "stopped at 0x%lx, instret %lu", stop->pc, stop->instret);
+            break;
+    }
+}
+
+void debug_clear_all(void) {
+    while (debug_breakpoint_count > 0) {
+        debug_breakpoint_remove(breakpoints[0], BREAKPOINT_SOFTWARE | BREAKPOINT_HARDWARE);
+    }
+    memset(watchpoints, 0, sizeof(watchpoints));
+    memset(watch_buckets, 0, sizeof(watch_buckets));
+    watchpoint_count = 0;
+    free_links = 0;
+    fresh_links = 0;
+    links_in_use = 0;
+    for (uint64_t page = 0; page <= MEMORY_NUM_PAGES; page++) {
+        memory_page_flags[page] &= ~PAGE_FLAG_WATCH;
+    }
+    skip_pc = DEBUG_NO_PC;
+}
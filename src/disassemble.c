@@ -49,6 +49,7 @@ void init_csr_names(void) {
     csr_names[CSR_SCAUSE] = "scause";
     csr_names[CSR_STVAL] = "stval";
     csr_names[CSR_SIP] = "sip";
+    csr_names[CSR_STIMECMP] = "stimecmp";
     csr_names[CSR_SATP] = "satp";
 
     csr_names[CSR_MVENDORID] = "mvendorid";
@@ -63,6 +64,7 @@ void init_csr_names(void) {
     csr_names[CSR_MIE] = "mie";
     csr_names[CSR_MTVEC] = "mtvec";
     csr_names[CSR_MCOUNTEREN] = "mcounteren";
+    csr_names[CSR_MENVCFG] = "menvcfg";
 
     csr_names[CSR_MSCRATCH] = "mscratch";
     csr_names[CSR_MEPC] = "mepc";
@@ -75,6 +77,10 @@ void init_csr_names(void) {
     csr_names[CSR_MCYCLEH] = "mcycleh";
     csr_names[CSR_MINSTRETH] = "minstreth";
 
+    csr_names[CSR_CYCLE] = "cycle";
+    csr_names[CSR_TIME] = "time";
+    csr_names[CSR_INSTRET] = "instret";
+
     csr_names[CSR_VSSTATUS] = "vsstatus";
     csr_names[CSR_VSIE] = "vsie";
     csr_names[CSR_VSTVEC] = "vstvec";
@@ -250,6 +256,10 @@ void dis_system(uint32_t instruction, char *buffer, size_t buffer_size, uint32_t
                     snprintf(buffer, buffer_size, "wfi");
                     break;
                 default:
+                    if ((instruction >> 25) == FUNCT7_SFENCE_VMA) {
+                        snprintf(buffer, buffer_size, "sfence.vma %s, %s", reg_names[rs1], reg_names[rs2]);
+                        break;
+                    }
                     snprintf(buffer, buffer_size, "unknown PRIV instruction: 0x%08x", instruction);
             }
             break;
@@ -1,12 +1,17 @@
 #include <unistd.h> // for usleep
 #include <pthread.h>
 #include <sys/time.h>
+#include <stdarg.h>
+#include <string.h>
 #include "disassemble.h"
 #include "csr.h"
 #include "display.h"
 #include "uart.h"
-#include "mfprintf.h"
+#include "console.h"
+#include "log.h"
 #include "keyboard.h"
+#include "snapshot.h"
+#include "replay.h"
 
 static struct timeval start;
 
@@ -26,7 +31,57 @@ WINDOW *create_newwin(int height, int width, int starty, int startx) {
     return local_win;
 }
 
-void display_registers(WINDOW *win, CPU *cpu) {
+// 记录每个窗口每一行上次输出的内容，只重画内容变化的行，也不再 wclear 整个窗口
+void cache_init(WindowCache *cache, WINDOW *win) {
+    memset(cache, 0, sizeof(*cache));
+    cache->win = win;
+}
+
+static void cache_line(WindowCache *cache, int y, int attr, const char *format, ...) {
+    char text[CACHE_MAX_WIDTH];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (y >= CACHE_MAX_LINES) {
+        return;
+    }
+    // 截断到边框以内，避免折行破坏相邻的行
+    int max_width = getmaxx(cache->win) - 2;
+    if (max_width >= 0 && max_width < (int) sizeof(text)) {
+        text[max_width] = '\0';
+    }
+    CachedLine *line = &cache->lines[y];
+    if (line->valid && line->attr == attr && strcmp(line->text, text) == 0) {
+        return;
+    }
+    // 新内容比旧内容短时用空格覆盖残留字符
+    int old_length = line->valid ? (int) strlen(line->text) : 0;
+    int length = (int) strlen(text);
+    if (attr) {
+        wattron(cache->win, attr);
+    }
+    mvwprintw(cache->win, y, 1, "%s", text);
+    if (attr) {
+        wattroff(cache->win, attr);
+    }
+    if (old_length > length) {
+        mvwprintw(cache->win, y, 1 + length, "%*s", old_length - length, "");
+    }
+    memcpy(line->text, text, length + 1);
+    line->attr = attr;
+    line->valid = true;
+    cache->dirty = true;
+}
+
+static void cache_refresh(WindowCache *cache) {
+    if (cache->dirty) {
+        wrefresh(cache->win);
+        cache->dirty = false;
+    }
+}
+
+void display_registers(WindowCache *cache, const StateSnapshot *snapshot) {
     static uint64_t old_minstret;
     struct timeval end;
     long seconds, useconds;
@@ -38,135 +93,118 @@ void display_registers(WINDOW *win, CPU *cpu) {
     useconds = end.tv_usec - start.tv_usec;
     double elapsed = seconds * 1000.0 + useconds / 1000.0;
     start = end;
-    float frequency = (cpu->csr[CSR_MINSTRET] - old_minstret) / elapsed * 1000.0 / 1024 / 1024;
-    old_minstret = cpu->csr[CSR_MINSTRET];
-    wclear(win);
-    box(win, 0, 0);
-    mvwprintw(win, 0, 1, "PC:0x%016lx", cpu->pc);
+    float frequency = (snapshot->csr.minstret - old_minstret) / elapsed * 1000.0 / 1024 / 1024;
+    old_minstret = snapshot->csr.minstret;
+    cache_line(cache, 0, 0, "PC:0x%016lx", snapshot->pc);
     for (int i = 0; i < 32; i++) {
-        mvwprintw(win, i + 1, 1, "x%-2d (%-3s):0x%016lx", i, reg_names2[i], cpu->registers[i]);
+        cache_line(cache, i + 1, 0, "x%-2d (%-3s):0x%016lx", i, reg_names2[i], snapshot->registers[i]);
     }
     uint8_t csr_base_y_index = 33;
 
     const char *CPU_MODES[] = {
             "User", "Supervisor", "Reserved", "Machine"
     };
-    mvwprintw(win, csr_base_y_index++, 1, "cpu mode: %s", CPU_MODES[cpu->priv]);
-    mvwprintw(win, csr_base_y_index++, 1, "mhartid:  0x%016lx", cpu->csr[CSR_MHARTID]);
-    mvwprintw(win, csr_base_y_index++, 1, "mscratch: 0x%016lx", cpu->csr[CSR_MSCRATCH]);
-    mvwprintw(win, csr_base_y_index++, 1, "mie:      0x%016lx", cpu->csr[CSR_MIE]);
-    mvwprintw(win, csr_base_y_index++, 1, "mtvec:    0x%016lx", cpu->csr[CSR_MTVEC]);
-    mvwprintw(win, csr_base_y_index++, 1, "mip:      0x%016lx", cpu->csr[CSR_MIP]);
-    mvwprintw(win, csr_base_y_index++, 1, "mstatus:  0x%016lx", cpu->csr[CSR_MSTATUS]);
-    mvwprintw(win, csr_base_y_index++, 1, "mcause:   0x%016lx", cpu->csr[CSR_MCAUSE]);
-    mvwprintw(win, csr_base_y_index++, 1, "mepc:     0x%016lx", cpu->csr[CSR_MEPC]);
-    mvwprintw(win, csr_base_y_index++, 1, "minstret: 0x%016lu", cpu->csr[CSR_MINSTRET]);
-    mvwprintw(win, csr_base_y_index++, 1, "freq:     %.2fMhz", frequency);
-
-    wrefresh(win);
+    cache_line(cache, csr_base_y_index++, 0, "cpu mode: %s", CPU_MODES[snapshot->priv & 0x3]);
+    cache_line(cache, csr_base_y_index++, 0, "mhartid:  0x%016lx", snapshot->csr.mhartid);
+    cache_line(cache, csr_base_y_index++, 0, "mscratch: 0x%016lx", snapshot->csr.mscratch);
+    cache_line(cache, csr_base_y_index++, 0, "mie:      0x%016lx", snapshot->csr.mie);
+    cache_line(cache, csr_base_y_index++, 0, "mtvec:    0x%016lx", snapshot->csr.mtvec);
+    cache_line(cache, csr_base_y_index++, 0, "mip:      0x%016lx", snapshot->csr.mip);
+    cache_line(cache, csr_base_y_index++, 0, "mstatus:  0x%016lx", snapshot->csr.mstatus);
+    cache_line(cache, csr_base_y_index++, 0, "mcause:   0x%016lx", snapshot->csr.mcause);
+    cache_line(cache, csr_base_y_index++, 0, "mepc:     0x%016lx", snapshot->csr.mepc);
+    cache_line(cache, csr_base_y_index++, 0, "minstret: %-16lu", snapshot->csr.minstret);
+    cache_line(cache, csr_base_y_index++, 0, "freq:     %.2fMhz", frequency);
+
+    cache_refresh(cache);
 }
 
-void display_stack(WINDOW *win, CPU *cpu, Memory *memory) {
-    static uint64_t old_sp = 0;
-    if (old_sp != 0 && old_sp == cpu->registers[2]) {
-        return;
-    } else {
-        old_sp = cpu->registers[2];
+void display_stack(WindowCache *cache, const StateSnapshot *snapshot) {
+    cache_line(cache, 0, 0, "Stack (0x%016lx):", snapshot->registers[2]);
+    for (int i = 0; i < STACK_SIZE && i < SNAPSHOT_STACK_WORDS; i++) {
+        cache_line(cache, i + 1, 0, "0x%016lx: 0x%08x", snapshot->stack_base + i * 4, snapshot->stack[i]);
     }
-    wclear(win);
-    box(win, 0, 0);
-    mvwprintw(win, 0, 1, "Stack (0x%016llx):", cpu->registers[2]);
-    uint64_t base_address = cpu->registers[2] - STACK_SIZE;
-    for (int i = 0; i < STACK_SIZE; i++) {
-        uint32_t stack_value = load_inst(memory, base_address + i * 4);
-        mvwprintw(win, i + 1, 1, "0x%016llx: 0x%08lx", base_address + i * 4, stack_value);
-    }
-    wrefresh(win);
+    cache_refresh(cache);
 }
 
-void display_source(WINDOW *win, Memory *memory, uint64_t pc) {
-    static uint64_t old_pc = 0;
-    if (old_pc != 0 && old_pc == pc) {
-        return;
-    } else {
-        old_pc = pc;
-    }
-    wclear(win);
-    box(win, 0, 0);
+void display_source(WindowCache *cache, const StateSnapshot *snapshot) {
     char buffer[100];
-    mvwprintw(win, 0, 1, "Source (0x%016llx):", pc);
-    uint64_t start_pc = pc - 64;
-    for (int i = 0; i < 32; i++) {
-        uint64_t address = start_pc + i * 4;
-        uint32_t instruction = load_inst(memory, address);
+    cache_line(cache, 0, 0, "Source (0x%016lx):", snapshot->pc);
+    for (int i = 0; i < SNAPSHOT_SOURCE_LINES; i++) {
+        uint64_t address = snapshot->source_base + i * 4;
+        uint32_t instruction = snapshot->source[i];
         disassemble(address, instruction, buffer, sizeof(buffer));
-        if (address == pc) {
-            // 启用颜色对1
-            wattron(win, COLOR_PAIR(1));
-            mvwprintw(win, i + 1, 1, "0x%08x>: 0x%08x  %s", address, instruction, buffer);
-            wattroff(win, COLOR_PAIR(1)); // 禁用颜色对1
+        if (address == snapshot->pc) {
+            // 当前指令用颜色对1高亮
+            cache_line(cache, i + 1, COLOR_PAIR(1), "0x%08lx>: 0x%08x  %s", address, instruction, buffer);
         } else {
-            mvwprintw(win, i + 1, 1, "0x%08x : 0x%08x  %s", address, instruction, &buffer);
+            cache_line(cache, i + 1, 0, "0x%08lx : 0x%08x  %s", address, instruction, buffer);
         }
     }
-    wrefresh(win);
+    cache_refresh(cache);
 }
 
-void display_keyboard_mode(WINDOW *win) {
-    static Mode old_mode = NONE_MODE;
-    Mode mode = get_mode();
-    if (old_mode == mode) {
-        return;
+void display_keyboard_mode(WindowCache *cache) {
+    if (get_mode() == CPU_MODE) {
+        cache_line(cache, 0, 0, "KeyBoard Mode: CPU Mode");
+        if (replay_mode != REPLAY_OFF) {
+            cache_line(cache, 1, 0, "s/z: step/back, c/x: continue/back, b: break, r: reset, p: profile, q: quit");
+        } else {
+            cache_line(cache, 1, 0, "s: step, c: continue, b: break, r: reset, p: profile, q: quit");
+        }
     } else {
-        old_mode = mode;
+        cache_line(cache, 0, 0, "KeyBoard Mode: UART Mode");
+        cache_line(cache, 1, 0, "Ctrl+G: switch to CPU mode");
     }
-    wclear(win);
-    box(win, 0, 0);
-    if (mode == CPU_MODE) {
-        mvwprintw(win, 0, 1, "KeyBoard Mode: CPU Mode");
-        mvwprintw(win, 1, 1, "s: step, c: continue, b: break, r: reset, q: quit");
+    cache_refresh(cache);
+}
+
+static void screen_putc(DisplayData *display_data, WINDOW *win, uint8_t value) {
+    if (value == '\n') { // Handle newline character
+        display_data->line++;
+        display_data->col = 1; // Reset to the first column
+    } else if (value == 8) { // Handle backspace character
+        if (display_data->col > 1) {
+            display_data->col--;
+        } else if (display_data->line > 1) {
+            display_data->line--;
+            display_data->col = getmaxx(win) - 2;
+        }
     } else {
-        mvwprintw(win, 0, 1, "KeyBoard Mode: UART Mode");
-        mvwprintw(win, 1, 1, "Ctrl+G: switch to CPU mode");
+        mvwaddch(win, display_data->line, display_data->col++, value);
+        if (display_data->col >= getmaxx(win) - 1) { // Move to the next line if end of line is reached
+            display_data->line++;
+            display_data->col = 1; // Reset to the first column
+        }
+    }
+
+    if (display_data->line >= getmaxy(win) - 1) { // Clear the window if the end is reached
+        display_data->line = 1;
+        display_data->col = 1; // Reset to the first column
+        werase(win);
+        box(win, 0, 0);
+        mvwprintw(win, 0, 1, "Screen(80*25)");
     }
-    wrefresh(win);
 }
 
 void display_screen(DisplayData* display_data, WINDOW *win, UART *uart) {
+    (void) uart;
     mvwprintw(win, 0, 1, "Screen(80*25)");
     static int should_view;
     static int show_cursor;
-    if ((uart->LSR & LSR_TX_IDLE) == 0) { // Check if is idle, if not idle, mean that data is ok
-        uint8_t value = uart->THR;
-        char buffer[2] = {value, '\0'};
-
-        if (value == '\n') { // Handle newline character
-            display_data->line++;
-            display_data->col = 1; // Reset to the first column
-        } else if (value == 8) { // Handle backspace character
-            if (display_data->col > 1) {
-                display_data->col--;
-            } else if (display_data->line > 1) {
-                display_data->line--;
-                display_data->col = getmaxx(win) - 2;
-            }
-        } else {
-            mvwprintw(win, display_data->line, display_data->col++, "%s", buffer);
-            if (display_data->col >= getmaxx(win) - 1) { // Move to the next line if end of line is reached
-                display_data->line++;
-                display_data->col = 1; // Reset to the first column
-            }
+    // 一次取出发送环中的所有字符，整批画完后只刷新一次
+    uint8_t buffer[UART_RING_SIZE];
+    size_t count = uart_tx_peek(buffer, sizeof(buffer));
+    if (count > 0) {
+        // 清掉旧的光标占位符
+        mvwaddch(win, display_data->line, display_data->col, ' ');
+        for (size_t i = 0; i < count; i++) {
+            screen_putc(display_data, win, buffer[i]);
         }
-
-        if (display_data->line >= getmaxy(win) - 1) { // Clear the window if the end is reached
-            display_data->line = 1;
-            display_data->col = 1; // Reset to the first column
-            wclear(win);
-            box(win, 0, 0);
+        if (console_enabled) {
+            console_write(buffer, count);
         }
-
-        uart->LSR |= LSR_THRE; // Set Transmitter Holding Register Empty
-        uart->THR = 0;
+        uart_tx_consume(count);
     }
     // 显示光标占位符
     if (should_view++ % 500 == 0) {
@@ -181,8 +219,9 @@ void display_screen(DisplayData* display_data, WINDOW *win, UART *uart) {
     wrefresh(win);
 }
 
-void display_uart(WINDOW *win, UART *uart) {
-    mvwprintw(win, 0, 1, "UART Registers");
+void display_uart(WindowCache *cache, const StateSnapshot *snapshot) {
+    const UART *uart = &snapshot->uart;
+    cache_line(cache, 0, 0, "UART Registers");
 
     // 寄存器名称数组
     const char *register_names[] = {
@@ -200,53 +239,72 @@ void display_uart(WINDOW *win, UART *uart) {
 
     // 显示 UART 寄存器的值，分成两列
     for (int i = 0; i < 6; ++i) {
-        mvwprintw(win, i + 1, 1, "%-4s: 0x%02x", register_names[i], register_values[i]);
-        mvwprintw(win, i + 1, 18, "%-4s: 0x%02x", register_names[i + 6], register_values[i + 6]);
+        cache_line(cache, i + 1, 0, "%-4s: 0x%02x       %-4s: 0x%02x", register_names[i], register_values[i],
+                   register_names[i + 6], register_values[i + 6]);
     }
 
-    wrefresh(win);
+    cache_refresh(cache);
 }
 
-void display_plic(WINDOW *win, PLIC *plic) {
+void display_plic(WindowCache *cache, const StateSnapshot *snapshot) {
 
-    mvwprintw(win, 0, 1, "PLIC Registers (hart0)");
+    cache_line(cache, 0, 0, "PLIC Registers (hart0)");
 
-    // 显示 priority id=10 的优先级
-    mvwprintw(win, 1, 1, "Priority [id=10]: %u", plic->priority[10]);
+    // 显示 UART 中断源的优先级
+    cache_line(cache, 1, 0, "Priority [id=%d]: %u", UART0_IRQ, snapshot->plic.uart_priority);
 
     // 显示 pending 寄存器的值
-    for (int i = 0; i < MAX_INTERRUPTS / 32; ++i) {
-        mvwprintw(win, 2 + i, 1, "Pending [%d]: 0x%08x", i, plic->pending[i]);
+    for (int i = 0; i < SNAPSHOT_PLIC_WORDS; ++i) {
+        cache_line(cache, 2 + i, 0, "Pending [%d]: 0x%08x", i, snapshot->plic.pending[i]);
     }
 
     // 显示 hart0 的 threshold 寄存器的值
-    mvwprintw(win, 6, 1, "Threshold [hart0]: %u", plic->threshold[0]);
+    cache_line(cache, 6, 0, "Threshold [hart0]: %u", snapshot->plic.threshold);
 
     // 显示 hart0 的 enable 位图
-    for (int i = 0; i < MAX_INTERRUPTS / 32; ++i) {
-        mvwprintw(win, 7 + i, 1, "Enable [hart0][%d]: 0x%08x", i, plic->enable[0][i]);
+    for (int i = 0; i < SNAPSHOT_PLIC_WORDS; ++i) {
+        cache_line(cache, 7 + i, 0, "Enable [hart0][%d]: 0x%08x", i, snapshot->plic.enable[i]);
     }
 
     // 显示 hart0 的 claim/complete 寄存器的值
-    mvwprintw(win, 11, 1, "Claim/Complete [hart0]: 0x%08x", plic->claim_complete[0]);
+    cache_line(cache, 11, 0, "Claim/Complete [hart0]: 0x%08x", snapshot->plic.claim_complete);
 
-    wrefresh(win);
+    cache_refresh(cache);
 }
 
-void display_clint(WINDOW *win, CLINT *clint) {
-    mvwprintw(win, 0, 1, "Clint Registers (hart0)");
-    mvwprintw(win, 1, 1, "mtime:       %020llu", clint->mtime);
-    mvwprintw(win, 2, 1, "mtimecmp[0]: %020llu", clint->mtimecmp[0]);
-    mvwprintw(win, 3, 1, "msip[0]:     0x%016x", clint->msip[0]);
+void display_clint(WindowCache *cache, const StateSnapshot *snapshot) {
+    cache_line(cache, 0, 0, "Clint Registers (hart0)");
+    cache_line(cache, 1, 0, "mtime:       %020lu", snapshot->clint.mtime);
+    cache_line(cache, 2, 0, "mtimecmp[0]: %020lu", snapshot->clint.mtimecmp);
+    cache_line(cache, 3, 0, "msip[0]:     0x%016lx", snapshot->clint.msip);
 
-    wrefresh(win);
+    cache_refresh(cache);
 }
 
+// 用最新的快照刷新除 UART 屏幕以外的所有窗口
+static void display_snapshot(DisplayWindows *windows) {
+    StateSnapshot snapshot;
+    if (!snapshot_read(&snapshot)) {
+        return;
+    }
+    display_registers(&windows->reg, &snapshot);
+    display_uart(&windows->uart, &snapshot);
+    display_clint(&windows->clint, &snapshot);
+    display_plic(&windows->plic, &snapshot);
+    display_stack(&windows->stack, &snapshot);
+    display_source(&windows->source, &snapshot);
+    if (snapshot.debug_stop.reason != DEBUG_STOP_NONE && get_mode() == CPU_MODE) {
+        // 停在断点或观察点上时用停止原因替换按键提示
+        char message[CACHE_MAX_WIDTH];
+        debug_format_stop(&snapshot.debug_stop, message, sizeof(message));
+        cache_line(&windows->status, 1, COLOR_PAIR(1), "%s", message);
+        cache_refresh(&windows->status);
+    }
+}
 
 void *update_display(void *arg) {
     DisplayData *display = (DisplayData *) arg;
     CPU *cpu = display->cpu;
-    Memory *memory = display->memory;
     sem_t *sem_refresh = display->sem_refresh;
     UART *uart = cpu->uart;
 
@@ -272,45 +330,37 @@ void *update_display(void *arg) {
     display->line = 1;
     display->col = 1;
 
-    display_registers(reg_win, cpu);
+    DisplayWindows windows;
+    cache_init(&windows.reg, reg_win);
+    cache_init(&windows.status, status_win);
+    cache_init(&windows.uart, uart_win);
+    cache_init(&windows.clint, clint_win);
+    cache_init(&windows.plic, plic_win);
+    cache_init(&windows.source, source_win);
+    cache_init(&windows.stack, stack_win);
+
     display_screen(display, screen_win, uart);
-    display_uart(uart_win, uart);
-    display_clint(clint_win, cpu->clint);
-    display_plic(plic_win, cpu->plic);
-    display_keyboard_mode(status_win);
-    display_stack(stack_win, cpu, memory);
-    display_source(source_win, memory, display->cpu->pc);
+    display_keyboard_mode(&windows.status);
+    display_snapshot(&windows);
 
     int i = 0;
     while (1) {
         if (cpu->fast_mode) {
             display_screen(display, screen_win, uart);
-            if (i % 500 == 0) {
-                display_uart(uart_win, uart);
-                display_clint(clint_win, cpu->clint);
-                display_plic(plic_win, cpu->plic);
-            }
-
-            if (i++ % 5000 == 0) {
-                display_registers(reg_win, cpu);
-                display_keyboard_mode(status_win);
-                display_stack(stack_win, cpu, memory);
-                display_source(source_win, memory, display->cpu->pc);
+            if (i++ % DISPLAY_SNAPSHOT_INTERVAL_MS == 0) {
+                // 先画上一次请求到的快照，再请求下一份，CPU 线程在块边界发布
+                display_snapshot(&windows);
+                display_keyboard_mode(&windows.status);
+                snapshot_request();
             }
             usleep(1000); // Adjust the refresh rate as needed
 
         } else {
             sem_wait(sem_refresh);
-            display_registers(reg_win, cpu);
-            display_keyboard_mode(status_win);
+            display_keyboard_mode(&windows.status);
             display_screen(display, screen_win, uart);
-            display_uart(uart_win, uart);
-            display_clint(clint_win, cpu->clint);
-            display_plic(plic_win, cpu->plic);
-            display_stack(stack_win, cpu, memory);
-            display_source(source_win, memory, display->cpu->pc);
+            display_snapshot(&windows);
             usleep(100000); // Adjust the refresh rate as needed
         }
     }
 }
-
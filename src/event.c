@@ -0,0 +1,152 @@
+#include "event.h"
+#include "block.h"
+#include "log.h"
+
+uint64_t event_clock_bias = 0;
+uint64_t event_next_deadline = EVENT_NEVER;
+uint64_t event_idle_time = 0;
+
+// 以截止时间为键的二叉最小堆，heap[0] 最早到期
+static EventTimer *heap[EVENT_MAX_TIMERS];
+static int heap_size = 0;
+
+static inline void heap_place(int index, EventTimer *timer) {
+    heap[index] = timer;
+    timer->index = index;
+}
+
+static void sift_up(int index) {
+    EventTimer *timer = heap[index];
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (heap[parent]->deadline <= timer->deadline) {
+            break;
+        }
+        heap_place(index, heap[parent]);
+        index = parent;
+    }
+    heap_place(index, timer);
+}
+
+static void sift_down(int index) {
+    EventTimer *timer = heap[index];
+    while (true) {
+        int child = index * 2 + 1;
+        if (child >= heap_size) {
+            break;
+        }
+        if (child + 1 < heap_size && heap[child + 1]->deadline < heap[child]->deadline) {
+            child++;
+        }
+        if (timer->deadline <= heap[child]->deadline) {
+            break;
+        }
+        heap_place(index, heap[child]);
+        index = child;
+    }
+    heap_place(index, timer);
+}
+
+static inline void update_next_deadline(void) {
+    uint64_t deadline = heap_size > 0 ? heap[0]->deadline : EVENT_NEVER;
+    if (deadline < event_next_deadline) {
+        // 块内的指令预约了更早的事件：正在执行的基本块按旧的截止时间算的长度，需要提前离开
+        block_exit_requested = true;
+    }
+    event_next_deadline = deadline;
+}
+
+void event_timer_mod(EventTimer *timer, uint64_t deadline) {
+    if (deadline == EVENT_NEVER) {
+        event_timer_del(timer);
+        return;
+    }
+    if (timer->index < 0) {
+        if (heap_size >= EVENT_MAX_TIMERS) {
+            LOG_ERROR(LOG_CAT_CPU, "event queue full, dropping timer %s\n", timer->name);
+            return;
+        }
+        timer->deadline = deadline;
+        heap_place(heap_size++, timer);
+        sift_up(timer->index);
+    } else {
+        uint64_t old = timer->deadline;
+        timer->deadline = deadline;
+        if (deadline < old) {
+            sift_up(timer->index);
+        } else {
+            sift_down(timer->index);
+        }
+    }
+    update_next_deadline();
+}
+
+void event_timer_del(EventTimer *timer) {
+    int index = timer->index;
+    if (index < 0) {
+        return;
+    }
+    timer->index = -1;
+    timer->deadline = EVENT_NEVER;
+    EventTimer *last = heap[--heap_size];
+    if (index < heap_size) {
+        heap_place(index, last);
+        // 移入的元素可能比原位置的父节点早，也可能比子节点晚
+        sift_up(index);
+        sift_down(last->index);
+    }
+    update_next_deadline();
+}
+
+void event_reset(void) {
+    for (int i = 0; i < heap_size; i++) {
+        heap[i]->index = -1;
+        heap[i]->deadline = EVENT_NEVER;
+    }
+    heap_size = 0;
+    event_clock_bias = 0;
+    event_idle_time = 0;
+    update_next_deadline();
+}
+
+void event_run_due(CPU *cpu) {
+    uint64_t now = event_now(cpu);
+    // 回调里可能重新预约自己或其他定时器，每次都从堆顶取
+    while (heap_size > 0 && heap[0]->deadline <= now) {
+        EventTimer *timer = heap[0];
+        event_timer_del(timer);
+        timer->callback(cpu, timer->opaque);
+    }
+}
+
+void event_skip_idle(CPU *cpu) {
+    if ((cpu->csr.mip & cpu->csr.mie) != 0 || event_next_deadline == EVENT_NEVER) {
+        return;
+    }
+    uint64_t now = event_now(cpu);
+    if (event_next_deadline > now) {
+        event_clock_bias += event_next_deadline - now;
+        event_idle_time += event_next_deadline - now;
+    }
+}
+
+void event_save(EventState *state) {
+    state->clock_bias = event_clock_bias;
+    state->idle_time = event_idle_time;
+    state->count = heap_size;
+    for (int i = 0; i < heap_size; i++) {
+        state->timers[i] = heap[i];
+        state->deadlines[i] = heap[i]->deadline;
+    }
+}
+
+void event_restore(const EventState *state) {
+    while (heap_size > 0) {
+        event_timer_del(heap[0]);
+    }
+    event_clock_bias = state->clock_bias;
+    event_idle_time = state->idle_time;
+    for (int i = 0; i < state->count; i++) {
+        event_timer_mod(state->timers[i], state->deadlines[i]);
+    }
+}
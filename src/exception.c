@@ -1,42 +1,66 @@
 #include "csr.h"
 #include "exception.h"
-#include "mfprintf.h"
+#include "log.h"
 
-void raise_exception(CPU *cpu, uint64_t cause) {
-    switch (cpu->priv) {
-        case PRV_U:
-            // 垂直陷入到超级模式
-            cpu->csr[CSR_MEPC] = cpu->pc;
-            cpu->csr[CSR_MCAUSE] = cause;
-            cpu->pc = cpu->csr[CSR_MTVEC];
-            // save cpu->priv first
-            cpu->csr[CSR_MSTATUS] = (cpu->csr[CSR_MSTATUS] & ~MSTATUS_MPP) | (cpu->priv << 11);
-            // save interrupt enable first
-            cpu->csr[CSR_MSTATUS] =
-                    (cpu->csr[CSR_MSTATUS] & ~MSTATUS_MPIE) | (((cpu->csr[CSR_MSTATUS] >> 3) & 0x1) << 7);
-            cpu->priv = PRV_M; // 切换到超级模式
-            cpu->pc_updated = true;
-            break;
-        case PRV_S:
-            // 水平陷入处理
-            cpu->csr[CSR_SEPC] = cpu->pc;
-            cpu->csr[CSR_SCAUSE] = cause;
-            cpu->pc = cpu->csr[CSR_STVEC];
-            break;
-        case PRV_M:
-        default:
-            cpu->csr[CSR_MEPC] = cpu->pc;
-            cpu->csr[CSR_MCAUSE] = cause;
-            cpu->pc = cpu->csr[CSR_MTVEC];
-            // save cpu->priv first
-            cpu->csr[CSR_MSTATUS] = (cpu->csr[CSR_MSTATUS] & ~MSTATUS_MPP) | (cpu->priv << 11);
-            // save interrupt enable first
-            cpu->csr[CSR_MSTATUS] =
-                    (cpu->csr[CSR_MSTATUS] & ~MSTATUS_MPIE) | (((cpu->csr[CSR_MSTATUS] >> 3) & 0x1) << 7);
-            cpu->pc_updated = true;
-
-            break;
+// 计算陷入入口地址：Vectored 模式下中断跳转到 BASE + 4 * code，异常总是跳转到 BASE
+static inline uint64_t trap_vector(uint64_t tvec, bool is_interrupt, uint64_t code) {
+    uint64_t base = tvec & ~(uint64_t) TVEC_MODE_MASK;
+    if (is_interrupt && (tvec & TVEC_MODE_MASK) == TVEC_MODE_VECTORED) {
+        return base + 4 * code;
     }
+    return base;
+}
+
+// 陷入到超级模式：由 medeleg/mideleg 代理的异常和中断直接进入 S 模式，不再经过 M 模式
+static void trap_to_supervisor(CPU *cpu, uint64_t cause, uint64_t tval, bool is_interrupt, uint64_t code) {
+    uint64_t mstatus = cpu->csr.mstatus;
+    cpu->csr.sepc = cpu->pc;
+    cpu->csr.scause = cause;
+    cpu->csr.stval = tval;
+    // SPP = 陷入前的特权级 (只能是 U 或 S)
+    mstatus = (mstatus & ~SSTATUS_SPP) | ((uint64_t) (cpu->priv & 0x1) << 8);
+    // SPIE = SIE, SIE = 0
+    mstatus = (mstatus & ~SSTATUS_SPIE) | (((mstatus >> 1) & 0x1) << 5);
+    mstatus &= ~SSTATUS_SIE;
+    cpu->csr.mstatus = mstatus;
+    cpu->priv = PRV_S;
+    cpu->pc = trap_vector(cpu->csr.stvec, is_interrupt, code);
+    cpu->pc_updated = true;
+}
+
+// 陷入到机器模式
+static void trap_to_machine(CPU *cpu, uint64_t cause, uint64_t tval, bool is_interrupt, uint64_t code) {
+    uint64_t mstatus = cpu->csr.mstatus;
+    cpu->csr.mepc = cpu->pc;
+    cpu->csr.mcause = cause;
+    cpu->csr.mtval = tval;
+    // save cpu->priv first
+    mstatus = (mstatus & ~MSTATUS_MPP) | ((uint64_t) cpu->priv << 11);
+    // save interrupt enable first: MPIE = MIE, MIE = 0
+    mstatus = (mstatus & ~MSTATUS_MPIE) | (((mstatus >> 3) & 0x1) << 7);
+    mstatus &= ~MSTATUS_MIE;
+    cpu->csr.mstatus = mstatus;
+    cpu->priv = PRV_M;
+    cpu->pc = trap_vector(cpu->csr.mtvec, is_interrupt, code);
+    cpu->pc_updated = true;
+}
+
+void raise_exception_with_tval(CPU *cpu, uint64_t cause, uint64_t tval) {
+    bool is_interrupt = (cause & CAUSE_EXTERNAL_INTERRUPT_BASE) != 0;
+    uint64_t code = cause & ~CAUSE_EXTERNAL_INTERRUPT_BASE;
+    uint64_t deleg = is_interrupt ? cpu->csr.mideleg : cpu->csr.medeleg;
+
+    // 只有在 U/S 模式下发生、且在 medeleg/mideleg 中被代理的陷入才进入 S 模式
+    // M 模式下发生的陷入永远不会被代理
+    if (cpu->priv <= PRV_S && code < 64 && ((deleg >> code) & 0x1)) {
+        trap_to_supervisor(cpu, cause, tval, is_interrupt, code);
+    } else {
+        trap_to_machine(cpu, cause, tval, is_interrupt, code);
+    }
+}
+
+void raise_exception(CPU *cpu, uint64_t cause) {
+    raise_exception_with_tval(cpu, cause, 0);
 }
 
 
@@ -44,13 +68,25 @@ inline bool handle_interrupt(CPU *cpu) {
     uint64_t status;
     uint64_t ie;  // Interrupt Enable register
     uint64_t ip;  // Interrupt Pending register
+    uint64_t mideleg;
+
+    status = cpu->csr.mstatus;
+    ie = cpu->csr.mie;
+    ip = cpu->csr.mip;
 
-    status = cpu->csr[CSR_MSTATUS];
-    ie = cpu->csr[CSR_MIE];
-    ip = cpu->csr[CSR_MIP];
+    if ((ie & ip) == 0) {
+        // 没有任何挂起且使能的中断，直接返回
+        return false;
+    }
 
-    if ((status & MSTATUS_MIE) == 0) {
-        // 如果中断未使能，直接返回
+    // 未代理的中断属于 M 级：当前特权级低于 M 时总是使能，在 M 模式下由 mstatus.MIE 控制
+    // 代理给 S 的中断属于 S 级：在 U 模式下总是使能，在 S 模式下由 sstatus.SIE 控制，在 M 模式下不会被响应
+    mideleg = cpu->csr.mideleg;
+    bool m_enabled = cpu->priv < PRV_M || (status & MSTATUS_MIE);
+    bool s_enabled = cpu->priv < PRV_S || (cpu->priv == PRV_S && (status & SSTATUS_SIE));
+    uint64_t enabled = ((m_enabled ? ~mideleg : 0) | (s_enabled ? mideleg : 0)) & ie & ip;
+
+    if (enabled == 0) {
         return false;
     }
 
@@ -60,39 +96,57 @@ inline bool handle_interrupt(CPU *cpu) {
     // (ie & MIE_MEIE) : 处理器是否允许外部中断
     // (ip & MIP_MEIP) : 是否有外部中断挂起
 
-    if ((ie & MIE_MEIE) && (ip & MIP_MEIP) && cpu->current_priority < PRIORITY_MACHINE_TIMER_INTERRUPT) {
+    if ((enabled & MIP_MEIP) && cpu->current_priority < PRIORITY_MACHINE_EXTERNAL_INTERRUPT) {
         // 处理外部中断
-        bool is_interrupt_occured = plic_check_interrupt(cpu->plic, (uint32_t) cpu->csr[CSR_MHARTID]);
+        bool is_interrupt_occured = plic_check_interrupt(cpu->plic, (uint32_t) cpu->csr.mhartid);
         if (is_interrupt_occured) {
-            mfprintf("CAUSE_MACHINE_EXTERNAL_INTERRUPT occur!!!\n");
+            LOG_DEBUG(LOG_CAT_TRAP, "CAUSE_MACHINE_EXTERNAL_INTERRUPT occur!!!\n");
             cpu->current_priority = PRIORITY_MACHINE_EXTERNAL_INTERRUPT;
             // claim 已经设置，pending已经清除，等待软件可以从claim寄存器中读取中断ID
             raise_exception(cpu, CAUSE_MACHINE_EXTERNAL_INTERRUPT);
             // 清除外部中断挂起位
-            cpu->csr[CSR_MIP] &= ~MIP_MEIP;
+            cpu->csr.mip &= ~MIP_MEIP;
             return true;
         }
     }
 
+    // 检查并处理机器模式软件中断
+    if ((enabled & MIP_MSIP) && cpu->current_priority < PRIORITY_MACHINE_SOFTWARE_INTERRUPT) {
+        cpu->current_priority = PRIORITY_MACHINE_SOFTWARE_INTERRUPT;
+        // 清除软件中断挂起位
+        cpu->csr.mip &= ~MIP_MSIP;
+        // 处理软件中断
+        raise_exception(cpu, CAUSE_MACHINE_SOFTWARE_INTERRUPT);
+        return true;
+    }
 
-    // 检查并处理中优先级中断
-    if ((ie & MIE_MTIE) && (cpu->clint->mtime >= cpu->clint->mtimecmp[cpu->csr[CSR_MHARTID]]) &&
-        cpu->current_priority < PRIORITY_MACHINE_TIMER_INTERRUPT) {
+    // 检查并处理机器模式定时器中断 (MTIP 由 update_timer_interrupt_pending 维护)
+    if ((enabled & MIP_MTIP) && cpu->current_priority < PRIORITY_MACHINE_TIMER_INTERRUPT) {
         cpu->current_priority = PRIORITY_MACHINE_TIMER_INTERRUPT;
         // 处理定时器中断
         raise_exception(cpu, CAUSE_MACHINE_TIMER_INTERRUPT);
         return true;
     }
 
-    // 检查并处理低优先级中断
-    if ((ie & MIE_MSIE) && (ip & MIP_MSIP) && cpu->current_priority < PRIORITY_MACHINE_SOFTWARE_INTERRUPT) {
-        cpu->current_priority = PRIORITY_MACHINE_SOFTWARE_INTERRUPT;
-        // 清除软件中断挂起位
-        cpu->csr[CSR_MIP] &= ~MIP_MSIP;
-        // 处理软件中断
-        raise_exception(cpu, CAUSE_MACHINE_SOFTWARE_INTERRUPT);
+    // 检查并处理超级模式外部中断
+    if ((enabled & SIP_SEIP) && cpu->current_priority < PRIORITY_SUPERVISOR_EXTERNAL_INTERRUPT) {
+        cpu->current_priority = PRIORITY_SUPERVISOR_EXTERNAL_INTERRUPT;
+        raise_exception(cpu, CAUSE_SUPERVISOR_EXTERNAL_INTERRUPT);
+        return true;
+    }
+
+    // 检查并处理超级模式软件中断
+    if ((enabled & SIP_SSIP) && cpu->current_priority < PRIORITY_SUPERVISOR_SOFTWARE_INTERRUPT) {
+        cpu->current_priority = PRIORITY_SUPERVISOR_SOFTWARE_INTERRUPT;
+        raise_exception(cpu, CAUSE_SUPERVISOR_SOFTWARE_INTERRUPT);
+        return true;
+    }
+
+    // 检查并处理超级模式定时器中断 (Sstc: STIP 由 time >= stimecmp 驱动)
+    if ((enabled & MIP_STIP) && cpu->current_priority < PRIORITY_SUPERVISOR_TIMER_INTERRUPT) {
+        cpu->current_priority = PRIORITY_SUPERVISOR_TIMER_INTERRUPT;
+        raise_exception(cpu, CAUSE_SUPERVISOR_TIMER_INTERRUPT);
         return true;
     }
     return false;
 }
-
@@ -11,8 +11,8 @@ void execute_fence(CPU *cpu, uint32_t instruction) {
 }
 
 void execute_fence_i(CPU *cpu, uint32_t instruction) {
-    // FENCE.I 指令在模拟器中通常不需要实际操作
-    // 在实际硬件上，这会刷新指令缓存
+    // 在实际硬件上，这会刷新指令缓存。基本块缓存在写入代码页时已经逐块失效 (见 block.h)，
+    // FENCE.I 本身结束基本块，之后的取指一定看到之前的写入，不需要清空整个缓存
 }
 
 void execute_fence_tso(CPU *cpu, uint32_t instruction) {
@@ -0,0 +1,45 @@
+#include <stdlib.h>
+#include "finisher.h"
+#include "uart.h"
+#include "log.h"
+#include "gdbstub.h"
+
+uint64_t finisher_read(uint64_t address, uint32_t size) {
+    (void) address;
+    (void) size;
+    return 0;
+}
+
+void finisher_write(uint64_t address, uint64_t value, uint32_t size) {
+    (void) size;
+    if (address != FINISHER_BASE_ADDR) {
+        return;
+    }
+    uint32_t status = value & 0xFFFF;
+    uint32_t code = (value >> 16) & 0xFFFF;
+    if (status == FINISHER_PASS || status == FINISHER_FAIL || status == FINISHER_RESET) {
+        // 退出前让显示线程把发送环里剩下的输出写完
+        uart_tx_flush();
+    }
+    switch (status) {
+        case FINISHER_PASS:
+            LOG_INFO(LOG_CAT_CPU, "test finisher: pass\n");
+            gdb_notify_exit(0);
+            exit(EXIT_SUCCESS);
+        case FINISHER_FAIL: {
+            LOG_INFO(LOG_CAT_CPU, "test finisher: fail, code %u\n", code);
+            // 进程退出码只有 8 位，非零的 code 不能被截断成 0
+            int exit_code = (code & 0xFF) != 0 ? (int) (code & 0xFF) : EXIT_FAILURE;
+            gdb_notify_exit(exit_code);
+            exit(exit_code);
+        }
+        case FINISHER_RESET:
+            // 没有实现整机复位，按成功退出处理，由外部重新启动
+            LOG_WARN(LOG_CAT_CPU, "test finisher: reset requested, exiting\n");
+            gdb_notify_exit(0);
+            exit(EXIT_SUCCESS);
+        default:
+            LOG_WARN(LOG_CAT_CPU, "test finisher: unknown command 0x%lx\n", value);
+            break;
+    }
+}
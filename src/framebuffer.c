@@ -0,0 +1,332 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "framebuffer.h"
+#include "memory.h"
+#include "event.h"
+#include "log.h"
+
+// 帧缓冲区起始地址不一定按页对齐，最多多跨一页
+#define FB_MAX_PAGES ((FB_MAX_BYTES >> MEMORY_PAGE_SHIFT) + 1)
+#define FB_DIRTY_WORDS ((FB_MAX_PAGES + 63) / 64)
+// 一次导出的记录一次 write，不超过 PIPE_BUF 才是原子的
+#define FB_MAX_DAMAGE (4096 / sizeof(FramebufferDamage))
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t format;
+    uint64_t address;
+    bool enabled;
+    uint32_t frame;
+    uint64_t offset;       // 像素相对 MEMORY_BASE_ADDR 的偏移
+    uint64_t length;       // stride * height
+    uint64_t first_page;
+    uint64_t num_pages;
+} Framebuffer;
+
+static Framebuffer fb;
+static uint64_t dirty[FB_DIRTY_WORDS];
+static bool opened = false;
+
+static int shm_fd = -1;
+static uint8_t *shm_base = NULL;
+static size_t shm_size = 0;
+static int notify_fd = -1;
+static bool notify_resync = false; // 通知管道满过，下一帧报整屏
+
+static void framebuffer_export(void);
+
+static void framebuffer_timer_expired(CPU *cpu, void *opaque) {
+    (void) cpu;
+    (void) opaque;
+    framebuffer_export();
+}
+
+static EventTimer fb_timer = EVENT_TIMER_INIT("framebuffer", framebuffer_timer_expired, NULL);
+
+void framebuffer_mark_dirty(uint64_t offset, uint32_t size) {
+    if (!fb.enabled) {
+        return;
+    }
+    uint64_t last = (offset + size - 1) >> MEMORY_PAGE_SHIFT;
+    for (uint64_t page = offset >> MEMORY_PAGE_SHIFT; page <= last; page++) {
+        uint64_t index = page - fb.first_page;
+        if (page >= fb.first_page && index < fb.num_pages) {
+            dirty[index / 64] |= 1ULL << (index % 64);
+        }
+    }
+    // 只在一帧里的第一次写入时预约导出，之后的写入只置位
+    if (!event_timer_pending(&fb_timer)) {
+        event_timer_mod(&fb_timer, event_now(get_cpu()) + FB_FRAME_INSTRET);
+    }
+}
+
+static void add_damage(FramebufferDamage *damage, uint32_t *count, uint32_t y0, uint32_t y1) {
+    FramebufferDamage *last = *count > 0 ? &damage[*count - 1] : NULL;
+    // 与上一条相邻或记录已满时合并
+    if (last != NULL && (y0 <= (uint32_t) last->y + last->height || *count == FB_MAX_DAMAGE)) {
+        last->height = (uint16_t) (y1 + 1 - last->y);
+        return;
+    }
+    damage[*count].frame = 0;
+    damage[*count].x = 0;
+    damage[*count].y = (uint16_t) y0;
+    damage[*count].width = (uint16_t) fb.width;
+    damage[*count].height = (uint16_t) (y1 + 1 - y0);
+    (*count)++;
+}
+
+// 把一段连续脏页拷到共享内存，并换算成行区间
+static void export_run(uint64_t first, uint64_t last, FramebufferDamage *damage, uint32_t *count) {
+    uint64_t start = (fb.first_page + first) << MEMORY_PAGE_SHIFT;
+    uint64_t end = (fb.first_page + last + 1) << MEMORY_PAGE_SHIFT;
+    if (start < fb.offset) {
+        start = fb.offset;
+    }
+    if (end > fb.offset + fb.length) {
+        end = fb.offset + fb.length;
+    }
+    if (start >= end) {
+        return;
+    }
+    memcpy(shm_base + FB_SHM_HEADER_SIZE + (start - fb.offset), get_cpu()->memory->data + start, end - start);
+    add_damage(damage, count, (uint32_t) ((start - fb.offset) / fb.stride),
+               (uint32_t) ((end - 1 - fb.offset) / fb.stride));
+}
+
+static void framebuffer_export(void) {
+    event_timer_del(&fb_timer);
+    if (!fb.enabled) {
+        return;
+    }
+    FramebufferDamage damage[FB_MAX_DAMAGE];
+    uint32_t count = 0;
+    // 按位图找连续的脏页段
+    int64_t run_start = -1;
+    uint64_t run_end = 0;
+    for (uint64_t word = 0; word < FB_DIRTY_WORDS; word++) {
+        uint64_t bits = dirty[word];
+        dirty[word] = 0;
+        while (bits != 0) {
+            uint64_t page = word * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            if (run_start >= 0 && page == run_end + 1) {
+                run_end = page;
+                continue;
+            }
+            if (run_start >= 0) {
+                export_run((uint64_t) run_start, run_end, damage, &count);
+            }
+            run_start = (int64_t) page;
+            run_end = page;
+        }
+    }
+    if (run_start >= 0) {
+        export_run((uint64_t) run_start, run_end, damage, &count);
+    }
+    if (count == 0) {
+        return;
+    }
+
+    fb.frame++;
+    FramebufferShmHeader *header = (FramebufferShmHeader *) shm_base;
+    __atomic_store_n(&header->frame, fb.frame, __ATOMIC_RELEASE);
+    if (notify_fd < 0) {
+        return;
+    }
+    if (notify_resync) {
+        count = 1;
+        damage[0].y = 0;
+        damage[0].height = (uint16_t) fb.height;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        damage[i].frame = fb.frame;
+    }
+    // 查看器跟不上时不阻塞模拟器，丢掉这一帧的记录，下一帧报整屏
+    notify_resync = write(notify_fd, damage, count * sizeof(FramebufferDamage)) < 0;
+}
+
+static bool framebuffer_resize_shm(void) {
+    size_t size = FB_SHM_HEADER_SIZE + fb.length;
+    if (shm_base != NULL && shm_size == size) {
+        return true;
+    }
+    if (shm_base != NULL) {
+        munmap(shm_base, shm_size);
+        shm_base = NULL;
+    }
+    if (ftruncate(shm_fd, (off_t) size) != 0) {
+        return false;
+    }
+    shm_base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    if (shm_base == MAP_FAILED) {
+        shm_base = NULL;
+        return false;
+    }
+    shm_size = size;
+    return true;
+}
+
+static void framebuffer_disable(void) {
+    if (fb.enabled) {
+        memory_set_page_flags(fb.offset, fb.length, PAGE_FLAG_FRAMEBUFFER, false);
+    }
+    fb.enabled = false;
+    event_timer_del(&fb_timer);
+    memset(dirty, 0, sizeof(dirty));
+}
+
+static void framebuffer_enable(void) {
+    uint64_t length = (uint64_t) fb.stride * fb.height;
+    if (!opened || fb.width == 0 || fb.height == 0 || fb.width > UINT16_MAX || fb.height > UINT16_MAX ||
+        fb.format != FB_FORMAT_XRGB8888 || fb.stride < fb.width * 4ULL || length > FB_MAX_BYTES ||
+        fb.address < MEMORY_BASE_ADDR || fb.address > MEMORY_END_ADDR || length > MEMORY_END_ADDR - fb.address) {
+        LOG_WARN(LOG_CAT_MEMORY, "framebuffer: invalid geometry %ux%u stride %u at 0x%lx\n",
+                 fb.width, fb.height, fb.stride, fb.address);
+        return;
+    }
+    fb.offset = fb.address - MEMORY_BASE_ADDR;
+    fb.length = length;
+    fb.first_page = fb.offset >> MEMORY_PAGE_SHIFT;
+    fb.num_pages = ((fb.offset + length - 1) >> MEMORY_PAGE_SHIFT) - fb.first_page + 1;
+    if (!framebuffer_resize_shm()) {
+        LOG_ERROR(LOG_CAT_MEMORY, "framebuffer: failed to resize shared memory: %s\n", strerror(errno));
+        return;
+    }
+    FramebufferShmHeader *header = (FramebufferShmHeader *) shm_base;
+    header->magic = FB_ID;
+    header->width = fb.width;
+    header->height = fb.height;
+    header->stride = fb.stride;
+    header->format = fb.format;
+
+    memory_set_page_flags(fb.offset, fb.length, PAGE_FLAG_FRAMEBUFFER, true);
+    fb.enabled = true;
+    // 使能时整屏导出一次，之后只导出脏页
+    for (uint64_t page = 0; page < fb.num_pages; page++) {
+        dirty[page / 64] |= 1ULL << (page % 64);
+    }
+    notify_resync = true;
+    framebuffer_export();
+}
+
+void framebuffer_reset(void) {
+    framebuffer_disable();
+    uint32_t frame = fb.frame;
+    memset(&fb, 0, sizeof(fb));
+    // 帧号不回退，查看器不会把复位后的帧当成旧帧
+    fb.frame = frame;
+}
+
+uint64_t framebuffer_read(uint64_t address, uint32_t size) {
+    (void) size;
+    if (!opened) {
+        return 0;
+    }
+    switch (address - FRAMEBUFFER_BASE_ADDR) {
+        case FB_REG_ID:
+            return FB_ID;
+        case FB_REG_WIDTH:
+            return fb.width;
+        case FB_REG_HEIGHT:
+            return fb.height;
+        case FB_REG_STRIDE:
+            return fb.stride;
+        case FB_REG_FORMAT:
+            return fb.format;
+        case FB_REG_ADDR_LO:
+            return (uint32_t) fb.address;
+        case FB_REG_ADDR_HI:
+            return (uint32_t) (fb.address >> 32);
+        case FB_REG_ENABLE:
+            return fb.enabled;
+        case FB_REG_FRAME:
+            return fb.frame;
+        default:
+            return 0;
+    }
+}
+
+void framebuffer_write(uint64_t address, uint64_t value, uint32_t size) {
+    (void) size;
+    if (!opened) {
+        return;
+    }
+    uint64_t offset = address - FRAMEBUFFER_BASE_ADDR;
+    // 使能期间几何参数只读
+    if (fb.enabled && offset != FB_REG_ENABLE && offset != FB_REG_FLUSH) {
+        return;
+    }
+    switch (offset) {
+        case FB_REG_WIDTH:
+            fb.width = (uint32_t) value;
+            break;
+        case FB_REG_HEIGHT:
+            fb.height = (uint32_t) value;
+            break;
+        case FB_REG_STRIDE:
+            fb.stride = (uint32_t) value;
+            break;
+        case FB_REG_FORMAT:
+            fb.format = (uint32_t) value;
+            break;
+        case FB_REG_ADDR_LO:
+            fb.address = (fb.address & 0xFFFFFFFF00000000ULL) | (uint32_t) value;
+            break;
+        case FB_REG_ADDR_HI:
+            fb.address = (fb.address & 0xFFFFFFFFULL) | ((uint64_t) (uint32_t) value << 32);
+            break;
+        case FB_REG_ENABLE:
+            if ((value & 1) && !fb.enabled) {
+                framebuffer_enable();
+            } else if (!(value & 1)) {
+                framebuffer_disable();
+            }
+            break;
+        case FB_REG_FLUSH:
+            framebuffer_export();
+            break;
+        default:
+            break;
+    }
+}
+
+int framebuffer_open(const char *spec) {
+    char *name = strdup(spec);
+    char *pipe_path = strchr(name, ':');
+    if (pipe_path != NULL) {
+        *pipe_path++ = '\0';
+    }
+    shm_fd = shm_open(name, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (shm_fd < 0) {
+        perror("Failed to open framebuffer shared memory");
+        free(name);
+        return -1;
+    }
+    if (pipe_path != NULL && *pipe_path != '\0') {
+        if (mkfifo(pipe_path, 0600) != 0 && errno != EEXIST) {
+            perror("Failed to create framebuffer notification pipe");
+            free(name);
+            return -1;
+        }
+        // 以读写方式打开，查看器还没连上时也不会阻塞或收到 SIGPIPE
+        notify_fd = open(pipe_path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (notify_fd < 0) {
+            perror("Failed to open framebuffer notification pipe");
+            free(name);
+            return -1;
+        }
+    }
+    opened = true;
+    LOG_INFO(LOG_CAT_MEMORY, "framebuffer: shm %s%s%s\n", name, pipe_path != NULL ? ", notify " : "",
+             pipe_path != NULL ? pipe_path : "");
+    free(name);
+    return 0;
+}
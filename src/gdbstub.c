@@ -0,0 +1,677 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "gdbstub.h"
+#include "debug.h"
+#include "event.h"
+#include "csr.h"
+#include "block.h"
+#include "replay.h"
+#include "log.h"
+
+// GDB 的 RISC-V 寄存器编号
+#define GDB_REG_PC 32
+#define GDB_REG_FIRST_FP 33
+#define GDB_REG_FIRST_CSR 65
+#define GDB_REG_PRIV (GDB_REG_FIRST_CSR + 4096)
+
+typedef enum {
+    GDB_STAY,       // 继续等待命令
+    GDB_CONTINUE,
+    GDB_STEP,
+    GDB_REVERSE,    // 已回到检查点，继续运行到反向执行的目标
+    GDB_DETACH,
+} GdbAction;
+
+bool gdb_stepping = false;
+
+static int client_fd = -1;
+static bool no_ack = false;
+static bool gdb_swbreak = false;
+static bool gdb_hwbreak = false;
+
+// 接收缓冲：停止时阻塞读取，运行时由轮询定时器非阻塞地补充
+static uint8_t input[GDB_PACKET_SIZE];
+static size_t input_head = 0;
+static size_t input_len = 0;
+
+static char packet[GDB_PACKET_SIZE + 1];
+static char reply[GDB_PACKET_SIZE + 1];
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static void gdb_poll_expired(CPU *cpu, void *opaque);
+
+static EventTimer poll_timer = EVENT_TIMER_INIT("gdb", gdb_poll_expired, NULL);
+
+bool gdb_connected(void) {
+    return client_fd >= 0;
+}
+
+static void gdb_disconnect(void) {
+    close(client_fd);
+    client_fd = -1;
+    debug_clear_all();
+    gdb_stepping = false;
+    event_timer_del(&poll_timer);
+    LOG_INFO(LOG_CAT_CPU, "gdb: debugger detached\n");
+}
+
+static int hex_value(int c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// 按小端字节序输出 bytes 个字节的十六进制
+static char *put_hex_le(char *out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        uint8_t byte = (uint8_t) (value >> (8 * i));
+        *out++ = hex_digits[byte >> 4];
+        *out++ = hex_digits[byte & 15];
+    }
+    *out = '\0';
+    return out;
+}
+
+static bool parse_hex_le(const char **cursor, int bytes, uint64_t *value) {
+    *value = 0;
+    for (int i = 0; i < bytes; i++) {
+        int high = hex_value((*cursor)[0]);
+        int low = high < 0 ? -1 : hex_value((*cursor)[1]);
+        if (low < 0) {
+            return false;
+        }
+        *value |= (uint64_t) (high * 16 + low) << (8 * i);
+        *cursor += 2;
+    }
+    return true;
+}
+
+// 解析大端书写的十六进制数 (地址、长度、寄存器号)
+static uint64_t parse_hex(const char **cursor) {
+    uint64_t value = 0;
+    int digit;
+    while ((digit = hex_value(**cursor)) >= 0) {
+        value = value * 16 + (uint64_t) digit;
+        (*cursor)++;
+    }
+    return value;
+}
+
+static int gdb_getc(void) {
+    if (input_head == input_len) {
+        ssize_t count;
+        do {
+            count = recv(client_fd, input, sizeof(input), 0);
+        } while (count < 0 && errno == EINTR);
+        if (count <= 0) {
+            return -1;
+        }
+        input_head = 0;
+        input_len = (size_t) count;
+    }
+    return input[input_head++];
+}
+
+static void gdb_send_raw(const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(client_fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += sent;
+        length -= (size_t) sent;
+    }
+}
+
+static void gdb_send(const char *payload) {
+    static char frame[GDB_PACKET_SIZE + 8];
+    size_t length = strlen(payload);
+    uint8_t checksum = 0;
+    frame[0] = '$';
+    for (size_t i = 0; i < length; i++) {
+        frame[i + 1] = payload[i];
+        checksum += (uint8_t) payload[i];
+    }
+    frame[length + 1] = '#';
+    frame[length + 2] = hex_digits[checksum >> 4];
+    frame[length + 3] = hex_digits[checksum & 15];
+    while (true) {
+        gdb_send_raw(frame, length + 4);
+        if (no_ack) {
+            return;
+        }
+        int c;
+        do {
+            c = gdb_getc();
+        } while (c >= 0 && c != '+' && c != '-');
+        if (c != '-') {
+            return;
+        }
+    }
+}
+
+// 读取一个完整的包，返回负载长度，连接断开时返回 -1
+static int gdb_read_packet(void) {
+    while (true) {
+        int c;
+        do {
+            c = gdb_getc();
+        } while (c >= 0 && c != '$');
+        if (c < 0) {
+            return -1;
+        }
+        size_t length = 0;
+        uint8_t checksum = 0;
+        while ((c = gdb_getc()) >= 0 && c != '#') {
+            if (length < GDB_PACKET_SIZE) {
+                packet[length++] = (char) c;
+            }
+            checksum += (uint8_t) c;
+        }
+        int high = gdb_getc();
+        int low = gdb_getc();
+        if (c < 0 || low < 0) {
+            return -1;
+        }
+        packet[length] = '\0';
+        if (!no_ack) {
+            bool valid = hex_value(high) * 16 + hex_value(low) == checksum && length < GDB_PACKET_SIZE;
+            gdb_send_raw(valid ? "+" : "-", 1);
+            if (!valid) {
+                continue;
+            }
+        }
+        return (int) length;
+    }
+}
+
+static void send_stop_reply(void) {
+    switch (debug_stop.reason) {
+        case DEBUG_STOP_INTERRUPT:
+            gdb_send("T02thread:1;");
+            break;
+        case DEBUG_STOP_WATCHPOINT: {
+            const char *kind = debug_stop.watch_type == WATCH_ACCESS ? "awatch" :
+                               debug_stop.watch_type == WATCH_READ ? "rwatch" : "watch";
+            snprintf(reply, sizeof(reply), "T05%s:%lx;thread:1;", kind, debug_stop.address);
+            gdb_send(reply);
+            break;
+        }
+        case DEBUG_STOP_BREAKPOINT: {
+            // 只有 Z1 插入的断点报告为硬件断点，同一地址还有软件断点时按软件断点报告
+            uint32_t types = debug_breakpoint_types(debug_stop.address);
+            if (gdb_swbreak && (types & BREAKPOINT_SOFTWARE)) {
+                gdb_send("T05swbreak:;thread:1;");
+            } else if (gdb_hwbreak && (types & BREAKPOINT_HARDWARE)) {
+                gdb_send("T05hwbreak:;thread:1;");
+            } else {
+                gdb_send("T05thread:1;");
+            }
+            break;
+        }
+        case DEBUG_STOP_HISTORY_BEGIN:
+            gdb_send("T05replaylog:begin;thread:1;");
+            break;
+        default:
+            gdb_send("T05thread:1;");
+            break;
+    }
+}
+
+static bool read_register(CPU *cpu, uint64_t regno, uint64_t *value) {
+    if (regno < 32) {
+        *value = cpu->registers[regno];
+    } else if (regno == GDB_REG_PC) {
+        *value = cpu->pc;
+    } else if (regno < GDB_REG_FIRST_CSR) {
+        *value = cpu->fregisters[regno - GDB_REG_FIRST_FP];
+    } else if (regno < GDB_REG_PRIV) {
+        *value = read_csr(cpu, (uint32_t) (regno - GDB_REG_FIRST_CSR));
+    } else if (regno == GDB_REG_PRIV) {
+        *value = cpu->priv;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool write_register(CPU *cpu, uint64_t regno, uint64_t value) {
+    if (regno < 32) {
+        if (regno != 0) {
+            cpu->registers[regno] = value;
+        }
+    } else if (regno == GDB_REG_PC) {
+        cpu->pc = value;
+    } else if (regno < GDB_REG_FIRST_CSR) {
+        cpu->fregisters[regno - GDB_REG_FIRST_FP] = value;
+    } else if (regno < GDB_REG_PRIV) {
+        write_csr(cpu, (uint32_t) (regno - GDB_REG_FIRST_CSR), value);
+    } else if (regno == GDB_REG_PRIV) {
+        cpu->priv = value & 3;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// 调试器只能访问内存，不经过 MMIO，也不触发观察点
+static uint8_t *guest_bytes(CPU *cpu, uint64_t address, uint64_t length) {
+    if (address < MEMORY_BASE_ADDR || address >= MEMORY_END_ADDR || length > MEMORY_END_ADDR - address) {
+        return NULL;
+    }
+    return cpu->memory->data + (address - MEMORY_BASE_ADDR);
+}
+
+static void handle_read_memory(CPU *cpu, const char *args) {
+    uint64_t address = parse_hex(&args);
+    args += *args == ',';
+    uint64_t length = parse_hex(&args);
+    uint8_t *data = guest_bytes(cpu, address, length);
+    if (data == NULL || length * 2 > GDB_PACKET_SIZE) {
+        gdb_send("E14");
+        return;
+    }
+    char *out = reply;
+    for (uint64_t i = 0; i < length; i++) {
+        out = put_hex_le(out, data[i], 1);
+    }
+    *out = '\0';
+    gdb_send(reply);
+}
+
+// M 包是十六进制，X 包是二进制 (0x7d 转义)
+static void handle_write_memory(CPU *cpu, const char *args, int packet_length, bool binary) {
+    const char *end = packet + packet_length;
+    uint64_t address = parse_hex(&args);
+    args += *args == ',';
+    uint64_t length = parse_hex(&args);
+    uint8_t *data = guest_bytes(cpu, address, length);
+    if (*args != ':' || data == NULL) {
+        gdb_send("E14");
+        return;
+    }
+    args++;
+    // 调试器改写内存不进日志，但要留在检查点里，反向执行时才能撤销
+    replay_save_pages(address - MEMORY_BASE_ADDR, length);
+    for (uint64_t i = 0; i < length; i++) {
+        if (binary) {
+            if (args >= end) {
+                gdb_send("E01");
+                return;
+            }
+            uint8_t byte = (uint8_t) *args++;
+            if (byte == 0x7d && args < end) {
+                byte = (uint8_t) *args++ ^ 0x20;
+            }
+            data[i] = byte;
+        } else {
+            uint64_t byte;
+            if (!parse_hex_le(&args, 1, &byte)) {
+                gdb_send("E01");
+                return;
+            }
+            data[i] = (uint8_t) byte;
+        }
+    }
+    // 可能改写了指令 (软件断点以外的补丁)
+    block_cache_code_write(address - MEMORY_BASE_ADDR, length);
+    gdb_send("OK");
+}
+
+static void handle_breakpoint(const char *args, bool insert) {
+    uint64_t type = parse_hex(&args);
+    args += *args == ',';
+    uint64_t address = parse_hex(&args);
+    args += *args == ',';
+    uint64_t kind = parse_hex(&args);
+    bool ok;
+    switch (type) {
+        case 0: // 软件断点，模拟器不改写内存，和硬件断点一样处理，只是停止原因不同
+        case 1: {
+            BreakpointType breakpoint_type = type == 0 ? BREAKPOINT_SOFTWARE : BREAKPOINT_HARDWARE;
+            ok = insert ? debug_breakpoint_insert(address, breakpoint_type) :
+                 debug_breakpoint_remove(address, breakpoint_type);
+            break;
+        }
+        case 2:
+        case 3:
+        case 4: {
+            WatchType watch_type = type == 2 ? WATCH_WRITE : type == 3 ? WATCH_READ : WATCH_ACCESS;
+            ok = insert ? debug_watchpoint_insert(address, kind, watch_type) :
+                 debug_watchpoint_remove(address, kind, watch_type);
+            break;
+        }
+        default:
+            gdb_send("");
+            return;
+    }
+    gdb_send(ok ? "OK" : "E01");
+}
+
+static void handle_query(const char *query) {
+    if (strncmp(query, "qSupported", 10) == 0) {
+        gdb_swbreak = strstr(query, "swbreak+") != NULL;
+        gdb_hwbreak = strstr(query, "hwbreak+") != NULL;
+        snprintf(reply, sizeof(reply), "PacketSize=%x;swbreak+;hwbreak+;QStartNoAckMode+;vContSupported+%s",
+                 GDB_PACKET_SIZE, replay_mode != REPLAY_OFF ? ";ReverseStep+;ReverseContinue+" : "");
+        gdb_send(reply);
+    } else if (strcmp(query, "qAttached") == 0) {
+        gdb_send("1");
+    } else if (strcmp(query, "qC") == 0) {
+        gdb_send("QC1");
+    } else if (strcmp(query, "qfThreadInfo") == 0) {
+        // 只模拟了一个 hart
+        gdb_send("m1");
+    } else if (strcmp(query, "qsThreadInfo") == 0) {
+        gdb_send("l");
+    } else if (strncmp(query, "qSymbol", 7) == 0) {
+        gdb_send("OK");
+    } else {
+        gdb_send("");
+    }
+}
+
+// vCont;<action>[:thread]...，只有一个线程，取第一个动作
+static GdbAction handle_vcont(const char *args) {
+    if (strcmp(args, "?") == 0) {
+        gdb_send("vCont;c;C;s;S");
+        return GDB_STAY;
+    }
+    if (*args != ';') {
+        gdb_send("");
+        return GDB_STAY;
+    }
+    char action = args[1];
+    if (action == 'c' || action == 'C') {
+        return GDB_CONTINUE;
+    }
+    if (action == 's' || action == 'S') {
+        return GDB_STEP;
+    }
+    gdb_send("E01");
+    return GDB_STAY;
+}
+
+static GdbAction gdb_command(CPU *cpu, int length) {
+    const char *args = packet + 1;
+    switch (packet[0]) {
+        case '?':
+            send_stop_reply();
+            return GDB_STAY;
+        case 'g': {
+            char *out = reply;
+            for (uint64_t regno = 0; regno <= GDB_REG_PC; regno++) {
+                uint64_t value;
+                read_register(cpu, regno, &value);
+                out = put_hex_le(out, value, 8);
+            }
+            gdb_send(reply);
+            return GDB_STAY;
+        }
+        case 'G':
+            for (uint64_t regno = 0; regno <= GDB_REG_PC; regno++) {
+                uint64_t value;
+                if (!parse_hex_le(&args, 8, &value)) {
+                    break;
+                }
+                write_register(cpu, regno, value);
+            }
+            gdb_send("OK");
+            return GDB_STAY;
+        case 'p': {
+            uint64_t value;
+            if (!read_register(cpu, parse_hex(&args), &value)) {
+                gdb_send("E01");
+                return GDB_STAY;
+            }
+            put_hex_le(reply, value, 8);
+            gdb_send(reply);
+            return GDB_STAY;
+        }
+        case 'P': {
+            uint64_t regno = parse_hex(&args);
+            uint64_t value;
+            if (*args++ != '=' || !parse_hex_le(&args, 8, &value) || !write_register(cpu, regno, value)) {
+                gdb_send("E01");
+                return GDB_STAY;
+            }
+            gdb_send("OK");
+            return GDB_STAY;
+        }
+        case 'm':
+            handle_read_memory(cpu, args);
+            return GDB_STAY;
+        case 'M':
+            handle_write_memory(cpu, args, length, false);
+            return GDB_STAY;
+        case 'X':
+            handle_write_memory(cpu, args, length, true);
+            return GDB_STAY;
+        case 'c':
+        case 's':
+            // 可选的恢复地址
+            if (isxdigit((unsigned char) *args)) {
+                cpu->pc = parse_hex(&args);
+            }
+            return packet[0] == 'c' ? GDB_CONTINUE : GDB_STEP;
+        case 'C':
+        case 'S':
+            // 不向客户机传递信号，忽略信号号
+            parse_hex(&args);
+            if (*args == ';') {
+                args++;
+                cpu->pc = parse_hex(&args);
+            }
+            return packet[0] == 'C' ? GDB_CONTINUE : GDB_STEP;
+        case 'b':
+            // bs / bc：反向单步和反向继续，需要 --record 或 --replay
+            if (replay_mode == REPLAY_OFF || (packet[1] != 's' && packet[1] != 'c')) {
+                gdb_send("");
+                return GDB_STAY;
+            }
+            if (packet[1] == 's' ? replay_reverse_step(cpu) : replay_reverse_continue(cpu)) {
+                return GDB_REVERSE;
+            }
+            send_stop_reply();
+            return GDB_STAY;
+        case 'v':
+            if (strncmp(packet, "vCont", 5) == 0) {
+                return handle_vcont(packet + 5);
+            }
+            gdb_send("");
+            return GDB_STAY;
+        case 'q':
+            handle_query(packet);
+            return GDB_STAY;
+        case 'Q':
+            if (strcmp(packet, "QStartNoAckMode") == 0) {
+                gdb_send("OK");
+                no_ack = true;
+            } else {
+                gdb_send("");
+            }
+            return GDB_STAY;
+        case 'H':
+        case 'T':
+            gdb_send("OK");
+            return GDB_STAY;
+        case 'Z':
+        case 'z':
+            handle_breakpoint(args, packet[0] == 'Z');
+            return GDB_STAY;
+        case 'D':
+            gdb_send("OK");
+            return GDB_DETACH;
+        case 'k':
+            LOG_INFO(LOG_CAT_CPU, "gdb: kill requested\n");
+            exit(EXIT_SUCCESS);
+        default:
+            gdb_send("");
+            return GDB_STAY;
+    }
+}
+
+static void arm_poll_timer(CPU *cpu) {
+    event_timer_mod(&poll_timer, event_now(cpu) + GDB_POLL_INSTRET);
+}
+
+void gdb_handle_stop(CPU *cpu) {
+    debug_stop_pending = false;
+    gdb_stepping = false;
+    if (client_fd < 0) {
+        return;
+    }
+    // 连接时的初始停止由调试器的 '?' 查询
+    if (debug_stop.reason != DEBUG_STOP_ATTACH) {
+        send_stop_reply();
+    }
+    while (true) {
+        int length = gdb_read_packet();
+        if (length < 0) {
+            gdb_disconnect();
+            return;
+        }
+        switch (gdb_command(cpu, length)) {
+            case GDB_CONTINUE:
+                debug_resume(cpu->pc);
+                arm_poll_timer(cpu);
+                return;
+            case GDB_STEP:
+                gdb_stepping = true;
+                arm_poll_timer(cpu);
+                return;
+            case GDB_REVERSE:
+                arm_poll_timer(cpu);
+                return;
+            case GDB_DETACH:
+                gdb_disconnect();
+                return;
+            case GDB_STAY:
+                break;
+        }
+    }
+}
+
+// 运行期间调试器只会发 Ctrl-C (0x03)，其他字节留在缓冲区里等停下后处理
+static void gdb_poll_expired(CPU *cpu, void *opaque) {
+    (void) opaque;
+    if (client_fd < 0) {
+        return;
+    }
+    if (input_head > 0) {
+        memmove(input, input + input_head, input_len - input_head);
+        input_len -= input_head;
+        input_head = 0;
+    }
+    if (input_len < sizeof(input)) {
+        ssize_t count = recv(client_fd, input + input_len, sizeof(input) - input_len, MSG_DONTWAIT);
+        if (count == 0 || (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            gdb_disconnect();
+            return;
+        }
+        if (count > 0) {
+            input_len += (size_t) count;
+        }
+    }
+    for (size_t i = 0; i < input_len; i++) {
+        if (input[i] == 0x03) {
+            memmove(input + i, input + i + 1, input_len - i - 1);
+            input_len--;
+            debug_request_stop(DEBUG_STOP_INTERRUPT, cpu->pc, 0);
+            break;
+        }
+    }
+    arm_poll_timer(cpu);
+}
+
+void gdb_reset(void) {
+    if (client_fd >= 0) {
+        arm_poll_timer(get_cpu());
+    }
+}
+
+void gdb_notify_exit(int code) {
+    if (client_fd < 0) {
+        return;
+    }
+    snprintf(reply, sizeof(reply), "W%02x", code & 0xFF);
+    gdb_send(reply);
+}
+
+static int gdb_listen(const char *target, bool *is_tcp) {
+    char *end;
+    long port = strtol(target, &end, 10);
+    int fd;
+    *is_tcp = *end == '\0' && port > 0 && port < 65536;
+    if (*is_tcp) {
+        struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons((uint16_t) port)};
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int one = 1;
+        if (fd >= 0) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        }
+        if (fd < 0 || bind(fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+            perror("Failed to bind gdb port");
+            return -1;
+        }
+    } else {
+        struct sockaddr_un address = {.sun_family = AF_UNIX};
+        if (strlen(target) >= sizeof(address.sun_path)) {
+            fprintf(stderr, "gdb socket path too long: %s\n", target);
+            return -1;
+        }
+        strcpy(address.sun_path, target);
+        unlink(target);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || bind(fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+            perror("Failed to bind gdb socket");
+            return -1;
+        }
+    }
+    if (listen(fd, 1) != 0) {
+        perror("Failed to listen for gdb");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int gdb_open(const char *target) {
+    bool is_tcp;
+    int listen_fd = gdb_listen(target, &is_tcp);
+    if (listen_fd < 0) {
+        return -1;
+    }
+    fprintf(stderr, "Waiting for gdb connection on %s\n", target);
+    do {
+        client_fd = accept(listen_fd, NULL, NULL);
+    } while (client_fd < 0 && errno == EINTR);
+    // 只支持一次调试会话
+    close(listen_fd);
+    if (client_fd < 0) {
+        perror("Failed to accept gdb connection");
+        return -1;
+    }
+    if (is_tcp) {
+        int one = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    LOG_INFO(LOG_CAT_CPU, "gdb: debugger attached\n");
+    debug_request_stop(DEBUG_STOP_ATTACH, 0, 0);
+    return 0;
+}
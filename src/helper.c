@@ -2,23 +2,62 @@
 #include <getopt.h>
 #include "memory.h"
 #include "helper.h"
+#include "log.h"
+#include "sampler.h"
 
 void print_usage(const char *program_name) {
     fprintf(stderr, "Usage: %s --rom <input file> --load_address <load address> [--end_address <end address>]\n", program_name);
+    fprintf(stderr, "          [--log_file <file>] [--log_level none|error|warn|info|debug|trace]\n");
+    fprintf(stderr, "          [--log_categories all|cpu,trap,plic,clint,uart,keyboard,memory,display]\n");
+    fprintf(stderr, "          [--trace <file>] [--profile <file>]\n");
+    fprintf(stderr, "          [--symbols <elf>] [--sample <file>] [--sample_hz <hz>]\n");
+    fprintf(stderr, "          [--headless] [--console <file>] [--uart_input <file>|-]\n");
+    fprintf(stderr, "          [--disk <image>] [--net <socket>[,<peer socket>...]]\n");
+    fprintf(stderr, "          [--vconsole [<name>=]<output>[:<input>],...] [--framebuffer <shm name>[:<notify pipe>]]\n");
+    fprintf(stderr, "          [--gdb <port>|<socket path>] [--watch <r|w|a|c>:<address>[+<length>],...]\n");
+    fprintf(stderr, "          [--record <file>|--replay <file>] [--stats <file>|-]\n");
 }
 
-int parse_arguments(int argc, char *argv[], const char **input_file, size_t *load_address, size_t *end_address) {
+int parse_arguments(int argc, char *argv[], Options *options) {
     struct option long_options[] = {
             {"rom", required_argument, 0, 'r'},
             {"load_address", required_argument, 0, 'l'},
             {"end_address", required_argument, 0, 'e'},
+            {"log_file", required_argument, 0, 'L'},
+            {"log_level", required_argument, 0, 'V'},
+            {"log_categories", required_argument, 0, 'C'},
+            {"trace", required_argument, 0, 'T'},
+            {"profile", required_argument, 0, 'P'},
+            {"symbols", required_argument, 0, 'S'},
+            {"sample", required_argument, 0, 'A'},
+            {"sample_hz", required_argument, 0, 'H'},
+            {"headless", no_argument, 0, 'B'},
+            {"console", required_argument, 0, 'O'},
+            {"uart_input", required_argument, 0, 'I'},
+            {"disk", required_argument, 0, 'D'},
+            {"net", required_argument, 0, 'N'},
+            {"vconsole", required_argument, 0, 'M'},
+            {"framebuffer", required_argument, 0, 'F'},
+            {"gdb", required_argument, 0, 'G'},
+            {"watch", required_argument, 0, 'W'},
+            {"record", required_argument, 0, 'R'},
+            {"replay", required_argument, 0, 'Y'},
+            {"stats", required_argument, 0, 'X'},
             {"help", no_argument, 0, 'h'},
             {0, 0, 0, 0}
     };
+    const char **input_file = &options->input_file;
+    size_t *load_address = &options->load_address;
+    size_t *end_address = &options->end_address;
+
+    options->log_file = LOG_DEFAULT_FILE;
+    options->log_level = LOG_LEVEL_WARN;
+    options->log_categories = LOG_CAT_ALL;
+    options->sample_hz = SAMPLER_DEFAULT_HZ;
 
     int option_index = 0;
     int c;
-    while ((c = getopt_long(argc, argv, "r:l:e:h", long_options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "r:l:e:L:V:C:T:P:S:A:H:BO:I:D:N:M:F:G:W:R:Y:X:h", long_options, &option_index)) != -1) {
         switch (c) {
             case 'r':
                 if (optarg == NULL || *optarg == '\0') {
@@ -41,6 +80,142 @@ int parse_arguments(int argc, char *argv[], const char **input_file, size_t *loa
                 }
                 *end_address = strtoull(optarg, NULL, 0);
                 break;
+            case 'L':
+                if (optarg == NULL || *optarg == '\0') {
+                    fprintf(stderr, "Error: --log_file requires a non-empty argument\n");
+                    return 1;
+                }
+                options->log_file = optarg;
+                break;
+            case 'V':
+                options->log_level = log_parse_level(optarg);
+                if (options->log_level < 0) {
+                    fprintf(stderr, "Error: unknown log level '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'C':
+                options->log_categories = log_parse_categories(optarg);
+                if (options->log_categories == 0) {
+                    fprintf(stderr, "Error: invalid log categories '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'T':
+                if (optarg == NULL || *optarg == '\0') {
+                    fprintf(stderr, "Error: --trace requires a non-empty argument\n");
+                    return 1;
+                }
+                options->trace_file = optarg;
+                break;
+            case 'P':
+                if (optarg == NULL || *optarg == '\0') {
+                    fprintf(stderr, "Error: --profile requires a non-empty argument\n");
+                    return 1;
+                }
+                options->profile_file = optarg;
+                break;
+            case 'S':
+                if (optarg == NULL || *optarg == '\0') {
+                    fprintf(stderr, "Error: --symbols requires a non-empty argument\n");
+                    return 1;
+                }
+                options->symbol_file = optarg;
+                break;
+            case 'A':
+                if (optarg == NULL || *optarg == '\0') {
+                    fprintf(stderr, "Error: --sample requires a non-empty argument\n");
+                    return 1;
+                }
+                options->sample_file = optarg;
+                break;
+            case 'H':
+                options->sample_hz = (int) strtol(optarg, NULL, 0);
+                if (options->sample_hz <= 0 || options->sample_hz > 100000) {
+                    fprintf(stderr, "Error: invalid sampling rate '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'B':
+                options->headless = true;
+                break;
+            case 'O':
+                if (optarg == NULL || *optarg == '\0') {
+                    fprintf(stderr, "Error: --console requires a non-empty argument\n");
+                    return 1;
+                }
+                options->console_file = optarg;
+                break;
+            case 'I':
+                if (optarg == NULL || *optarg == '\0') {
+                    fprintf(stderr, "Error: --uart_input requires a non-empty argument\n");
+                    return 1;
+                }
+                options->uart_input_file = optarg;
+                break;
+            case 'D':
+                if (optarg == NULL || *optarg == '\0') {
+                    fprintf(stderr, "Error: --disk requires a non-empty argument\n");
+                    return 1;
+                }
+                options->disk_file = optarg;
+                break;
+            case 'N':
+                if (optarg == NULL || *optarg == '\0') {
+                    fprintf(stderr, "Error: --net requires a non-empty argument\n");
+                    return 1;
+                }
+                options->net_spec = optarg;
+                break;
+            case 'M':
+                if (optarg == NULL || *optarg == '\0') {
+                    fprintf(stderr, "Error: --vconsole requires a non-empty argument\n");
+                    return 1;
+                }
+                options->vconsole_spec = optarg;
+                break;
+            case 'F':
+                if (optarg == NULL || *optarg == '\0') {
+                    fprintf(stderr, "Error: --framebuffer requires a non-empty argument\n");
+                    return 1;
+                }
+                options->framebuffer_spec = optarg;
+                break;
+            case 'G':
+                if (optarg == NULL || *optarg == '\0') {
+                    fprintf(stderr, "Error: --gdb requires a non-empty argument\n");
+                    return 1;
+                }
+                options->gdb_target = optarg;
+                break;
+            case 'W':
+                if (optarg == NULL || *optarg == '\0') {
+                    fprintf(stderr, "Error: --watch requires a non-empty argument\n");
+                    return 1;
+                }
+                options->watch_spec = optarg;
+                break;
+            case 'R':
+                if (optarg == NULL || *optarg == '\0') {
+                    fprintf(stderr, "Error: --record requires a non-empty argument\n");
+                    return 1;
+                }
+                options->record_file = optarg;
+                break;
+            case 'Y':
+                if (optarg == NULL || *optarg == '\0') {
+                    fprintf(stderr, "Error: --replay requires a non-empty argument\n");
+                    return 1;
+                }
+                options->replay_file = optarg;
+                break;
+            case 'X':
+                if (optarg == NULL || *optarg == '\0') {
+                    fprintf(stderr, "Error: --stats requires a non-empty argument\n");
+                    return 1;
+                }
+                options->stats_file = optarg;
+                break;
             case 'h':
             case '?':
                 return 1;
@@ -53,6 +228,23 @@ int parse_arguments(int argc, char *argv[], const char **input_file, size_t *loa
         return 1;
     }
 
+    if (options->record_file != NULL || options->replay_file != NULL) {
+        // virtio 后端线程和帧缓冲区的状态不在检查点里，回放时也无法复现
+        if (options->record_file != NULL && options->replay_file != NULL) {
+            fprintf(stderr, "Error: --record and --replay cannot be used together\n");
+            return 1;
+        }
+        if (options->disk_file != NULL || options->net_spec != NULL || options->vconsole_spec != NULL ||
+            options->framebuffer_spec != NULL) {
+            fprintf(stderr, "Error: --record/--replay cannot be combined with virtio devices or --framebuffer\n");
+            return 1;
+        }
+        if (options->replay_file != NULL && options->uart_input_file != NULL) {
+            fprintf(stderr, "Error: --replay takes UART input from the log, not --uart_input\n");
+            return 1;
+        }
+    }
+
     if (*end_address == 0) {
         *end_address = MEMORY_END_ADDR;
     }
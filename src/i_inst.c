@@ -1,7 +1,7 @@
 #include <stdio.h>
 #include "i_inst.h"
 #include "display.h"
-#include "mfprintf.h"
+#include "log.h"
 
 // I-type指令处理函数
 void execute_i_type_instruction(CPU *cpu, uint32_t instruction) {
@@ -77,7 +77,7 @@ void execute_i_type_instruction(CPU *cpu, uint32_t instruction) {
 
         default:
             // 未知指令处理
-            mfprintf("Unknown I-type instruction with funct3: 0x%x\n", funct3);
+            LOG_WARN(LOG_CAT_CPU, "Unknown I-type instruction with funct3: 0x%x\n", funct3);
             break;
     }
 }
\ No newline at end of file
@@ -1,8 +1,21 @@
 #include <stdint.h>
 #include <stdio.h>
 #include "j_inst.h"
+#include "sampler.h"
 #include "display.h"
-#include "mfprintf.h"
+#include "log.h"
+
+static inline void shadow_stack_push(CPU *cpu) {
+    ShadowStack *stack = cpu->shadow_stack;
+    stack->call_sites[stack->depth & (SHADOW_STACK_SIZE - 1)] = cpu->pc;
+    stack->depth++;
+}
+
+static inline void shadow_stack_pop(CPU *cpu) {
+    if (cpu->shadow_stack->depth > 0) {
+        cpu->shadow_stack->depth--;
+    }
+}
 
 void execute_j_type_instruction(CPU *cpu, uint32_t instruction) {
     uint32_t rd = (instruction >> 7) & 0x1F;
@@ -18,16 +31,28 @@ void execute_j_type_instruction(CPU *cpu, uint32_t instruction) {
         if (rd != 0) {
             cpu->registers[rd] = cpu->pc + 4;
         }
+        if (is_link_register(rd)) {
+            shadow_stack_push(cpu);
+        }
         cpu->pc += imm;
     } else if ((instruction & 0x7F) == OPCODE_JALR) {
         // 处理JALR指令
         imm = (int32_t)((instruction >> 20) << 20) >> 20;  // 符号扩展立即数
         uint32_t rs1 = (instruction >> 15) & 0x1F;
+        // 先计算目标地址，rd == rs1 时不能用写回后的值
+        uint64_t target = (cpu->registers[rs1] + imm) & ~1ULL;  // 确保跳转地址是对齐的
         if (rd != 0) {
             cpu->registers[rd] = cpu->pc + 4;
         }
-        cpu->pc = (cpu->registers[rs1] + imm) & ~1;  // 确保跳转地址是对齐的
+        // 返回地址栈提示 (非特权规范 JALR 一节)：rs1 是链接寄存器且与 rd 不同时为返回，rd 是链接寄存器时为调用
+        if (is_link_register(rs1) && rs1 != rd) {
+            shadow_stack_pop(cpu);
+        }
+        if (is_link_register(rd)) {
+            shadow_stack_push(cpu);
+        }
+        cpu->pc = target;
     } else {
-        mfprintf("Unknown J-type instruction with opcode: 0x%x\n", instruction & 0x7F);
+        LOG_WARN(LOG_CAT_CPU, "Unknown J-type instruction with opcode: 0x%x\n", instruction & 0x7F);
     }
 }
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include "keyboard.h"
+#include "log.h"
+#include "profile.h"
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -26,6 +28,9 @@ Mode get_mode(void) {
 
 void process_cpu_input(KeyBoardData *data) {
     sem_post(data->sem_continue); // 通知 CPU 线程继续执行
+    if (data->key == 'p') {
+        profile_request_dump(); // CPU 线程在下一个基本块边界写出分析报告
+    }
     if (data->key == 'c' || data->key == 7) {
         // 切换到 UART 模式
         switch_mode(UART_MODE);
@@ -42,18 +47,11 @@ void process_uart_input(KeyBoardData *data) {
         sem_post(data->sem_refresh); // 通知显示线程刷新
         // 处理 UART 输入
         if (data->key != ERR) {
-            UART *uart = data->cpu->uart;
-            // 检查 FIFO 是否已满
-            if (uart->fifo_count < UART_FIFO_SIZE) {
-                // 将字符写入 FIFO
-                mfprintf("GET KEY: %c\n", data->key);
-                uart->fifo[uart->fifo_tail] = data->key;
-                uart->fifo_tail = (uart->fifo_tail + 1) % UART_FIFO_SIZE;
-                uart->fifo_count++;
-                uart->LSR |= LSR_RX_READY; // 设置数据准备好标志
-                trigger_interrupt(data->cpu, UART0_IRQ); // 触发 UART 中断
-            } else {
-                // FIFO 已满，丢弃输入（可以考虑其他处理方式）
+            // 只写入接收环，由 CPU 线程在块边界根据触发深度决定是否产生中断
+            uint8_t key = (uint8_t) data->key;
+            LOG_DEBUG(LOG_CAT_KEYBOARD, "GET KEY: %c\n", data->key);
+            if (uart_rx_write(&key, 1) == 0) {
+                LOG_WARN(LOG_CAT_KEYBOARD, "UART RX ring full, key dropped\n");
             }
         }
     }
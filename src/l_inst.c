@@ -1,7 +1,7 @@
 #include <stdio.h>
 #include "l_inst.h"
 #include "display.h"
-#include "mfprintf.h"
+#include "log.h"
 #include "exception.h"
 #include "csr.h"
 
@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <strings.h>
+#include <unistd.h>
+#include "log.h"
+
+#define LOG_RING_SLOTS 256      // 每个线程的环形缓冲区槽位数 (必须是 2 的幂)
+#define LOG_RECORD_SIZE 240     // 单条日志最大长度，超出部分截断
+#define LOG_WRITER_IDLE_US 1000 // 没有日志时写线程的休眠间隔
+
+typedef struct {
+    uint8_t level;
+    uint8_t category;
+    uint16_t length;
+    char text[LOG_RECORD_SIZE];
+} LogRecord;
+
+// 单生产者 (所属线程) / 单消费者 (写线程) 的无锁环形缓冲区
+typedef struct LogRing {
+    _Atomic uint64_t head;     // 写线程消费位置
+    _Atomic uint64_t tail;     // 生产者写入位置
+    _Atomic uint64_t dropped;  // 缓冲区满时丢弃的条数
+    struct LogRing *next;      // 全局链表，写线程遍历
+    LogRecord records[LOG_RING_SLOTS];
+} LogRing;
+
+int log_runtime_level = LOG_LEVEL_NONE;
+uint32_t log_runtime_categories = LOG_CAT_ALL;
+
+static _Atomic(LogRing *) ring_list = NULL;
+static __thread LogRing *thread_ring = NULL;
+
+static FILE *log_file = NULL;
+static pthread_t writer_thread;
+static atomic_bool writer_running = false;
+
+static const char *level_names[] = {"NONE", "ERROR", "WARN", "INFO", "DEBUG", "TRACE"};
+static const char *category_names[LOG_CAT_COUNT] = {
+        "cpu", "trap", "plic", "clint", "uart", "keyboard", "memory", "display"
+};
+
+// 首次写日志时为当前线程分配环形缓冲区，并无锁地挂到全局链表上
+static LogRing *get_thread_ring(void) {
+    if (thread_ring != NULL) {
+        return thread_ring;
+    }
+    LogRing *ring = calloc(1, sizeof(LogRing));
+    if (ring == NULL) {
+        return NULL;
+    }
+    LogRing *old_head = atomic_load_explicit(&ring_list, memory_order_relaxed);
+    do {
+        ring->next = old_head;
+    } while (!atomic_compare_exchange_weak_explicit(&ring_list, &old_head, ring,
+                                                    memory_order_release, memory_order_relaxed));
+    thread_ring = ring;
+    return ring;
+}
+
+void log_write(int level, LogCategory category, const char *format, ...) {
+    LogRing *ring = get_thread_ring();
+    if (ring == NULL) {
+        return;
+    }
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail - head >= LOG_RING_SLOTS) {
+        // 缓冲区已满：丢弃而不是阻塞模拟线程
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    LogRecord *record = &ring->records[tail & (LOG_RING_SLOTS - 1)];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(record->text, sizeof(record->text), format, args);
+    va_end(args);
+    if (length < 0) {
+        return;
+    }
+    if (length >= (int) sizeof(record->text)) {
+        length = sizeof(record->text) - 1;
+    }
+    record->level = (uint8_t) level;
+    record->category = (uint8_t) category;
+    record->length = (uint16_t) length;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+// 把所有线程缓冲区中的日志写入文件，返回写出的条数
+static size_t drain_rings(void) {
+    size_t count = 0;
+    for (LogRing *ring = atomic_load_explicit(&ring_list, memory_order_acquire); ring != NULL; ring = ring->next) {
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        for (; head != tail; head++) {
+            LogRecord *record = &ring->records[head & (LOG_RING_SLOTS - 1)];
+            fprintf(log_file, "[%s][%s] ", level_names[record->level], category_names[record->category]);
+            fwrite(record->text, 1, record->length, log_file);
+            count++;
+        }
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+
+        uint64_t dropped = atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+        if (dropped != 0) {
+            fprintf(log_file, "[WARN][log] %lu messages dropped\n", dropped);
+        }
+    }
+    return count;
+}
+
+static void *log_writer(void *arg) {
+    (void) arg;
+    while (atomic_load_explicit(&writer_running, memory_order_acquire)) {
+        if (drain_rings() == 0) {
+            fflush(log_file);
+            usleep(LOG_WRITER_IDLE_US);
+        }
+    }
+    return NULL;
+}
+
+int log_init(const char *path, int level, uint32_t categories) {
+    log_runtime_categories = categories;
+    if (level <= LOG_LEVEL_NONE) {
+        log_runtime_level = LOG_LEVEL_NONE;
+        return 0;
+    }
+
+    log_file = fopen(path != NULL ? path : LOG_DEFAULT_FILE, "a");
+    if (log_file == NULL) {
+        perror("Failed to open log file");
+        return -1;
+    }
+    setvbuf(log_file, NULL, _IOFBF, 1 << 16);
+
+    atomic_store(&writer_running, true);
+    if (pthread_create(&writer_thread, NULL, log_writer, NULL) != 0) {
+        atomic_store(&writer_running, false);
+        fclose(log_file);
+        log_file = NULL;
+        return -1;
+    }
+    log_runtime_level = level;
+    atexit(log_shutdown);
+    return 0;
+}
+
+void log_shutdown(void) {
+    if (!atomic_exchange(&writer_running, false)) {
+        return;
+    }
+    log_runtime_level = LOG_LEVEL_NONE;
+    pthread_join(writer_thread, NULL);
+    drain_rings();
+    fclose(log_file);
+    log_file = NULL;
+}
+
+int log_parse_level(const char *name) {
+    for (int i = LOG_LEVEL_NONE; i <= LOG_LEVEL_TRACE; i++) {
+        if (strcasecmp(name, level_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint32_t log_parse_categories(const char *list) {
+    uint32_t mask = 0;
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s", list);
+    for (char *save = NULL, *token = strtok_r(buffer, ",", &save); token != NULL; token = strtok_r(NULL, ",", &save)) {
+        if (strcasecmp(token, "all") == 0) {
+            mask |= LOG_CAT_ALL;
+            continue;
+        }
+        int found = 0;
+        for (int i = 0; i < LOG_CAT_COUNT; i++) {
+            if (strcasecmp(token, category_names[i]) == 0) {
+                mask |= 1u << i;
+                found = 1;
+            }
+        }
+        if (!found) {
+            return 0;
+        }
+    }
+    return mask;
+}
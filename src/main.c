@@ -15,22 +15,57 @@
 #include "helper.h"
 #include "keyboard.h"
 #include "simulator.h"
+#include "log.h"
+#include "trace.h"
+#include "block.h"
+#include "profile.h"
+#include "symbols.h"
+#include "sampler.h"
+#include "console.h"
+#include "snapshot.h"
+#include "debug.h"
+#include "gdbstub.h"
+#include "replay.h"
+#include "stats.h"
 
 
 int main(int argc, char *argv[]) {
-    const char *input_file = NULL;
-    uint64_t load_address = 0;
-    uint64_t end_address = MEMORY_END_ADDR;
+    Options options = {0};
 
-    if (parse_arguments(argc, argv, &input_file, &load_address, &end_address) != 0) {
+    if (parse_arguments(argc, argv, &options) != 0) {
         print_usage(argv[0]);
         return 1;
-    } else {
-        printf("Input file: %s\n", input_file);
-        printf("Load address: 0x%lx\n", load_address);
-        printf("End address: 0x%lx\n", end_address);
+    } else if (!options.headless) {
+        printf("Input file: %s\n", options.input_file);
+        printf("Load address: 0x%lx\n", options.load_address);
+        printf("End address: 0x%lx\n", options.end_address);
     }
+    const char *input_file = options.input_file;
+    uint64_t load_address = options.load_address;
+    uint64_t end_address = options.end_address;
+
+    if (log_init(options.log_file, options.log_level, options.log_categories) != 0) {
+        return 1;
+    }
+    if (options.trace_file != NULL && trace_open(options.trace_file) != 0) {
+        return 1;
+    }
+    if (options.profile_file != NULL && profile_open(options.profile_file) != 0) {
+        return 1;
+    }
+    if (options.symbol_file != NULL && symbols_load(options.symbol_file) < 0) {
+        return 1;
+    }
+    if (options.sample_file != NULL && sampler_open(options.sample_file, options.sample_hz) != 0) {
+        return 1;
+    }
+    // 界面模式下只有显式指定 --console 时才把 UART 输出另存一份
+    if ((options.headless || options.console_file != NULL) && console_open(options.console_file) != 0) {
+        return 1;
+    }
+    uart_set_tx_direct(options.headless);
     init_csr_names();
+    block_cache_init(end_address);
 
 
     Memory memory;
@@ -51,13 +86,47 @@ int main(int argc, char *argv[]) {
 
     load_file_to_memory(input_file, &memory, load_address);
     cpu->pc = load_address;
+    snapshot_publish(cpu);
+    if (options.record_file != NULL && replay_open(options.record_file, REPLAY_RECORD, load_address) != 0) {
+        return 1;
+    }
+    if (options.replay_file != NULL && replay_open(options.replay_file, REPLAY_PLAY, load_address) != 0) {
+        return 1;
+    }
+    if (options.uart_input_file != NULL && uart_input_open(options.uart_input_file) != 0) {
+        return 1;
+    }
+    if (options.disk_file != NULL && virtio_blk_open(options.disk_file) != 0) {
+        return 1;
+    }
+    if (options.net_spec != NULL && virtio_net_open(options.net_spec) != 0) {
+        return 1;
+    }
+    if (options.vconsole_spec != NULL && virtio_console_open(options.vconsole_spec) != 0) {
+        return 1;
+    }
+    if (options.framebuffer_spec != NULL && framebuffer_open(options.framebuffer_spec) != 0) {
+        return 1;
+    }
+    if (options.watch_spec != NULL && debug_watch_open(options.watch_spec) != 0) {
+        return 1;
+    }
+    if (options.stats_file != NULL && stats_open(options.stats_file, input_file) != 0) {
+        return 1;
+    }
+    if (options.gdb_target != NULL) {
+        if (gdb_open(options.gdb_target) != 0) {
+            return 1;
+        }
+        // 由调试器控制运行，CPU 以快速模式执行，停在调试器的停止点上
+        cpu->fast_mode = true;
+    }
 
     sem_init(&sem_refresh, 0, 0);
     sem_init(&sem_continue, 0, 0);
 
     pthread_t display_thread;
     pthread_t keyboard_thread;
-    pthread_t timer_thread;
     pthread_t simulator_thread;
 
     // Initialize ncurses display thread
@@ -72,18 +141,26 @@ int main(int argc, char *argv[]) {
             &sem_refresh,
             input_file,
             load_address,
-            end_address
+            end_address,
+            options.headless
     };
 
+    stats_start();
+    if (options.headless) {
+        // 无界面模式：不启动显示和键盘线程，直接以快速模式运行，由测试结束设备或结束地址退出
+        cpu->fast_mode = true;
+        pthread_create(&simulator_thread, NULL, cpu_simulator, &simulator);
+        pthread_join(simulator_thread, NULL);
+        return 0;
+    }
+
     pthread_create(&display_thread, NULL, update_display, &display_data);
     pthread_create(&keyboard_thread, NULL, keyboard_input, &keyboard_data);
     pthread_create(&simulator_thread, NULL, cpu_simulator, &simulator);
-    pthread_create(&timer_thread, NULL, timer_loop, cpu);
 
     pthread_join(display_thread, NULL);
     pthread_join(keyboard_thread, NULL);
     pthread_join(simulator_thread, NULL);
-    pthread_join(timer_thread, NULL);
 
     // End ncurses mode
     endwin();
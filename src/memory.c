@@ -2,16 +2,59 @@
 #include <stdio.h>
 #include <sys/mman.h>
 #include "memory.h"
+#include "virtio.h"
+#include "framebuffer.h"
+#include "debug.h"
+#include "replay.h"
+#include "block.h"
 #include "exception.h"
-#include "mfprintf.h"
+#include "log.h"
 
 MMIORegion mmio_regions[NUM_MMIO_REGIONS] = {
         { .base_addr = CLINT_BASE_ADDR, .size = CLINT_SIZE, .read = clint_read, .write = clint_write },
         { .base_addr = PLIC_BASE_ADDR, .size = PLIC_SIZE, .read = plic_read, .write = plic_write },
         { .base_addr = UART_BASE_ADDR, .size = 8, .read = uart_read, .write = uart_write },
+        { .base_addr = FINISHER_BASE_ADDR, .size = FINISHER_SIZE, .read = finisher_read, .write = finisher_write },
+        { .base_addr = VIRTIO_BLK_BASE_ADDR, .size = VIRTIO_MMIO_SIZE, .read = virtio_blk_read, .write = virtio_blk_write },
+        { .base_addr = VIRTIO_NET_BASE_ADDR, .size = VIRTIO_MMIO_SIZE, .read = virtio_net_read, .write = virtio_net_write },
+        { .base_addr = VIRTIO_CONSOLE_BASE_ADDR, .size = VIRTIO_MMIO_SIZE, .read = virtio_console_read, .write = virtio_console_write },
+        { .base_addr = FRAMEBUFFER_BASE_ADDR, .size = FRAMEBUFFER_SIZE, .read = framebuffer_read, .write = framebuffer_write },
         // 添加其他 MMIO 区域
 };
 
+uint8_t memory_page_flags[MEMORY_NUM_PAGES + 1];
+
+void memory_set_page_flags(uint64_t offset, uint64_t length, uint8_t flags, bool set) {
+    if (length == 0) {
+        return;
+    }
+    for (uint64_t page = offset >> MEMORY_PAGE_SHIFT; page <= (offset + length - 1) >> MEMORY_PAGE_SHIFT; page++) {
+        if (set) {
+            memory_page_flags[page] |= flags;
+        } else {
+            memory_page_flags[page] &= ~flags;
+        }
+    }
+}
+
+// 写入的首页或尾页带有标志
+static void memory_store_hook(uint64_t offset, uint64_t value, uint32_t size) {
+    uint8_t flags = memory_page_flags[offset >> MEMORY_PAGE_SHIFT] |
+                    memory_page_flags[(offset + size - 1) >> MEMORY_PAGE_SHIFT];
+    if (flags & PAGE_FLAG_FRAMEBUFFER) {
+        framebuffer_mark_dirty(offset, size);
+    }
+    if (flags & PAGE_FLAG_WATCH) {
+        debug_watch_access(offset, size, true, value);
+    }
+    if (flags & PAGE_FLAG_SNAPSHOT) {
+        replay_save_pages(offset, size);
+    }
+    if (flags & PAGE_FLAG_CODE) {
+        block_cache_code_write(offset, size);
+    }
+}
+
 void memory_init(Memory *memory) {
     memory->data = (uint8_t *) malloc(MEMORY_SIZE);
     if (memory->data == NULL) {
@@ -48,6 +91,10 @@ uint64_t memory_read(Memory *memory, uint64_t address, uint32_t size, bool is_si
         }
     } else {
 	address -= MEMORY_BASE_ADDR;
+        if ((memory_page_flags[address >> MEMORY_PAGE_SHIFT] |
+             memory_page_flags[(address + size - 1) >> MEMORY_PAGE_SHIFT]) & PAGE_FLAG_WATCH) {
+            debug_watch_access(address, size, false, 0);
+        }
         switch (size) {
             case 1:
                 return is_signed ? (int8_t)memory->data[address] : memory->data[address];
@@ -75,6 +122,10 @@ void memory_write(Memory *memory, uint64_t address, uint64_t value, uint32_t siz
         }
     } else {
 	address -= MEMORY_BASE_ADDR;
+        if (memory_page_flags[address >> MEMORY_PAGE_SHIFT] |
+            memory_page_flags[(address + size - 1) >> MEMORY_PAGE_SHIFT]) {
+            memory_store_hook(address, value, size);
+        }
         switch (size) {
             case 1:
                 memory->data[address] = value & 0xFF;
@@ -16,10 +16,12 @@ void flush_tlb(MMU *mmu) {
     }
 }
 
-// 刷新特定 TLB 条目
+// 刷新特定 TLB 条目：按页比较虚拟地址
 void flush_tlb_entry(MMU *mmu, uint64_t vaddr, uint64_t asid) {
     for (int i = 0; i < TLB_SIZE; i++) {
-        if (mmu->tlb[i].valid && mmu->tlb[i].virtual_address == vaddr && mmu->tlb[i].asid == asid) {
+        if (mmu->tlb[i].valid &&
+            (vaddr == TLB_MATCH_ALL || (mmu->tlb[i].virtual_address >> 12) == (vaddr >> 12)) &&
+            (asid == TLB_MATCH_ALL || mmu->tlb[i].asid == asid)) {
             mmu->tlb[i].valid = 0;
         }
     }
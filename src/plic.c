@@ -1,7 +1,7 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include "plic.h"
-#include "mfprintf.h"
+#include "log.h"
 
 static PLIC global_plic;
 
@@ -13,7 +13,48 @@ PLIC *get_plic(void) {
     return &global_plic;
 }
 
+static inline void plic_invalidate(PLIC *plic, uint32_t context) {
+    plic->context[context].dirty = true;
+}
 
+// pending 或 priority 变化会影响所有上下文
+static inline void plic_invalidate_all(PLIC *plic) {
+    for (int i = 0; i < PLIC_NUM_CONTEXTS; i++) {
+        plic->context[i].dirty = true;
+    }
+}
+
+// 重新计算上下文的最佳候选：逐字取 pending & enable，用 ctz 只访问置位的中断源
+void plic_update_best(PLIC *plic, uint32_t context) {
+    PLICContext *ctx = &plic->context[context];
+    uint32_t best_irq = 0;
+    uint32_t best_priority = ctx->threshold;
+    for (int word = 0; word < PLIC_WORDS; word++) {
+        uint32_t bits = plic->pending[word] & ctx->enable[word];
+        while (bits != 0) {
+            uint32_t irq = word * 32 + __builtin_ctz(bits);
+            bits &= bits - 1;
+            // 严格大于：同优先级时保留编号较小的中断
+            if (plic->priority[irq] > best_priority) {
+                best_priority = plic->priority[irq];
+                best_irq = irq;
+            }
+        }
+    }
+    ctx->best_irq = best_irq;
+    ctx->dirty = false;
+}
+
+void plic_set_pending(PLIC *plic, uint32_t irq) {
+    if (irq == 0 || irq >= PLIC_NUM_SOURCES) {
+        return;
+    }
+    uint32_t mask = 1u << (irq & 0x1F);
+    if ((plic->pending[irq >> 5] & mask) == 0) {
+        plic->pending[irq >> 5] |= mask;
+        plic_invalidate_all(plic);
+    }
+}
 
 uint64_t plic_read(uint64_t address, uint32_t size) {
     PLIC *plic = get_plic();
@@ -23,16 +64,16 @@ uint64_t plic_read(uint64_t address, uint32_t size) {
         return plic->priority[(offset - PLIC_PRIORITY_OFFSET) / 4];
     } else if (offset >= PLIC_PENDING_OFFSET && offset < PLIC_PENDING_OFFSET + sizeof(plic->pending)) {
         return plic->pending[(offset - PLIC_PENDING_OFFSET) / 4];
-    } else if (offset >= PLIC_ENABLE(0) && offset < PLIC_ENABLE(MAX_HARTS)) {
-        uint32_t hart_id = (offset - PLIC_ENABLE_BASE) / sizeof(plic->enable[0]);
-        uint32_t enable_offset = (offset - PLIC_ENABLE_BASE) % sizeof(plic->enable[0]);
-        return plic->enable[hart_id][enable_offset / 4];
-    } else if ((offset % PLIC_THRESHOLD_STRIDE) == 0 && offset >= PLIC_THRESHOLD_OFFSET(0) && offset < PLIC_THRESHOLD_OFFSET(MAX_HARTS)) {
-        uint32_t hart_id = (offset - PLIC_THRESHOLD_BASE) / PLIC_THRESHOLD_STRIDE;
-        return plic->threshold[hart_id];
-    } else if ((offset % PLIC_CLAIM_STRIDE) == 4 && offset >= PLIC_CLAIM_OFFSET(0) && offset < PLIC_CLAIM_OFFSET(MAX_HARTS)) {
-        uint32_t hart_id = (offset - PLIC_CLAIM_BASE) / PLIC_CLAIM_STRIDE;
-        uint32_t interrupt_id = plic_claim_interrupt(hart_id);
+    } else if (offset >= PLIC_ENABLE(0) && offset < PLIC_ENABLE(PLIC_NUM_CONTEXTS)) {
+        uint32_t context = (offset - PLIC_ENABLE_BASE) / PLIC_ENABLE_STRIDE;
+        uint32_t word = (offset - PLIC_ENABLE_BASE) % PLIC_ENABLE_STRIDE / 4;
+        return word < PLIC_WORDS ? plic->context[context].enable[word] : 0;
+    } else if ((offset % PLIC_THRESHOLD_STRIDE) == 0 && offset >= PLIC_THRESHOLD_OFFSET(0) && offset < PLIC_THRESHOLD_OFFSET(PLIC_NUM_CONTEXTS)) {
+        uint32_t context = (offset - PLIC_THRESHOLD_BASE) / PLIC_THRESHOLD_STRIDE;
+        return plic->context[context].threshold;
+    } else if ((offset % PLIC_CLAIM_STRIDE) == 4 && offset >= PLIC_CLAIM_OFFSET(0) && offset < PLIC_CLAIM_OFFSET(PLIC_NUM_CONTEXTS)) {
+        uint32_t context = (offset - PLIC_CLAIM_BASE) / PLIC_CLAIM_STRIDE;
+        uint32_t interrupt_id = plic_claim_interrupt(context);
         return interrupt_id;
     }
     return 0;
@@ -44,54 +85,50 @@ void plic_write(uint64_t address, uint64_t value, uint32_t size) {
 
     if (offset >= PLIC_PRIORITY_OFFSET && offset < PLIC_PRIORITY_OFFSET + sizeof(plic->priority)) {
         plic->priority[(offset - PLIC_PRIORITY_OFFSET) / 4] = (uint32_t) value;
+        plic_invalidate_all(plic);
     } else if (offset >= PLIC_PENDING_OFFSET && offset < PLIC_PENDING_OFFSET + sizeof(plic->pending)) {
         // 挂起寄存器是只读的，不能写入
-    } else if (offset >= PLIC_ENABLE(0) && offset < PLIC_ENABLE(MAX_HARTS)) {
-        uint32_t hart_id = (offset - PLIC_ENABLE_BASE) / sizeof(plic->enable[0]);
-        uint32_t enable_offset = (offset - PLIC_ENABLE_BASE) % sizeof(plic->enable[0]);
-        plic->enable[hart_id][enable_offset / 4] = (uint32_t) value;
-    } else if ((offset % PLIC_THRESHOLD_STRIDE) == 0 && offset >= PLIC_THRESHOLD_OFFSET(0) && offset < PLIC_THRESHOLD_OFFSET(MAX_HARTS)) {
-        uint32_t hart_id = (offset - PLIC_THRESHOLD_BASE) / PLIC_THRESHOLD_STRIDE;
-        plic->threshold[hart_id] = (uint32_t) value;
-    } else if ((offset % PLIC_CLAIM_STRIDE) == 4 && offset >= PLIC_CLAIM_OFFSET(0) && offset < PLIC_CLAIM_OFFSET(MAX_HARTS)) {
-        uint32_t hart_id = (offset - PLIC_CLAIM_BASE) / PLIC_CLAIM_STRIDE;
-        plic_complete_interrupt(hart_id, (int) value);
+    } else if (offset >= PLIC_ENABLE(0) && offset < PLIC_ENABLE(PLIC_NUM_CONTEXTS)) {
+        uint32_t context = (offset - PLIC_ENABLE_BASE) / PLIC_ENABLE_STRIDE;
+        uint32_t word = (offset - PLIC_ENABLE_BASE) % PLIC_ENABLE_STRIDE / 4;
+        if (word < PLIC_WORDS) {
+            // 0 号中断源保留，不能使能
+            plic->context[context].enable[word] = (uint32_t) value & (word == 0 ? ~1u : ~0u);
+            plic_invalidate(plic, context);
+        }
+    } else if ((offset % PLIC_THRESHOLD_STRIDE) == 0 && offset >= PLIC_THRESHOLD_OFFSET(0) && offset < PLIC_THRESHOLD_OFFSET(PLIC_NUM_CONTEXTS)) {
+        uint32_t context = (offset - PLIC_THRESHOLD_BASE) / PLIC_THRESHOLD_STRIDE;
+        plic->context[context].threshold = (uint32_t) value;
+        plic_invalidate(plic, context);
+    } else if ((offset % PLIC_CLAIM_STRIDE) == 4 && offset >= PLIC_CLAIM_OFFSET(0) && offset < PLIC_CLAIM_OFFSET(PLIC_NUM_CONTEXTS)) {
+        uint32_t context = (offset - PLIC_CLAIM_BASE) / PLIC_CLAIM_STRIDE;
+        plic_complete_interrupt(context, (int) value);
     }
 }
 
 
 
 
-uint32_t plic_claim_interrupt(uint32_t hart_id) {
+uint32_t plic_claim_interrupt(uint32_t context) {
     PLIC *plic = get_plic();
-    for (int i = 0; i < MAX_INTERRUPTS; i++) {
-        if ((plic->pending[i >> 5] & (1 << (i & 0x1F))) && (plic->enable[hart_id][i >> 5] & (1 << (i & 0x1F)))) {
-            if (plic->priority[i] > plic->threshold[hart_id]) {
-                plic->pending[i >> 5] &= ~(1 << (i & 0x1F)); // 清除挂起状态
-                plic->claim_complete[hart_id] = i;
-                mfprintf("Claimed interrupt %d\n", i);
-                return i;
-            }
-        }
+    uint32_t irq = plic_best_interrupt(plic, context);
+    if (irq != 0) {
+        plic->pending[irq >> 5] &= ~(1u << (irq & 0x1F)); // 清除挂起状态
+        plic_invalidate_all(plic);
+        plic->context[context].claim_complete = irq;
+        LOG_DEBUG(LOG_CAT_PLIC, "Claimed interrupt %u\n", irq);
     }
-    return 0; // 没有挂起的中断
+    return irq; // 0 表示没有挂起的中断
 }
 
-void plic_complete_interrupt(uint32_t hart_id, int irq) {
+void plic_complete_interrupt(uint32_t context, int irq) {
     PLIC *plic = get_plic();
-    if ((plic->enable[hart_id][irq >> 5] & (1 << (irq & 0x1F))) != 0) {
-        // 确保中断源已启用
-        plic->claim_complete[hart_id] = -1; // 清除 claim_complete
+    if (irq <= 0 || irq >= PLIC_NUM_SOURCES) {
+        return;
     }
-}
-
-bool plic_check_interrupt(PLIC *plic, int hart_id) {
-    for (int i = 0; i < MAX_INTERRUPTS; i++) {
-        if ((plic->pending[i >> 5] & (1 << (i & 0x1F))) && (plic->enable[hart_id][i >> 5] & (1 << (i & 0x1F)))) {
-            if (plic->priority[i] > plic->threshold[hart_id]) {
-                return true; // 有中断可以触发
-            }
-        }
+    PLICContext *ctx = &plic->context[context];
+    if ((ctx->enable[irq >> 5] & (1u << (irq & 0x1F))) != 0) {
+        // 确保中断源已启用
+        ctx->claim_complete = -1; // 清除 claim_complete
     }
-    return false; // 没有中断可以触发
 }
@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profile.h"
+#include "disassemble.h"
+#include "log.h"
+
+// 变体键：opcode[6:0] | funct3[9:7] | funct7[16:10]，bit 17 区分 ECALL/EBREAK/xRET/WFI 等 (此时 funct3 位放 rs2)
+#define VARIANT_BITS 18
+#define VARIANT_COUNT (1u << VARIANT_BITS)
+#define VARIANT_SYSTEM_PRIV (1u << 17)
+
+bool profile_enabled = false;
+volatile sig_atomic_t profile_dump_requested = 0;
+
+static const char *profile_path = NULL;
+// 已被替换的基本块留下的计数
+static uint64_t retired_variants[VARIANT_COUNT];
+
+static const char *opcode_class_names[32] = {
+        [OPCODE_LOAD >> 2] = "LOAD",
+        [OPCODE_LOAD_FP >> 2] = "LOAD_FP",
+        [OPCODE_MISC_MEM >> 2] = "MISC_MEM",
+        [OPCODE_OP_IMM >> 2] = "OP_IMM",
+        [OPCODE_AUIPC >> 2] = "AUIPC",
+        [OPCODE_OP_IMM_32 >> 2] = "OP_IMM_32",
+        [OPCODE_STORE >> 2] = "STORE",
+        [OPCODE_STORE_FP >> 2] = "STORE_FP",
+        [OPCODE_AMO >> 2] = "AMO",
+        [OPCODE_OP >> 2] = "OP",
+        [OPCODE_LUI >> 2] = "LUI",
+        [OPCODE_OP_32 >> 2] = "OP_32",
+        [OPCODE_MADD >> 2] = "MADD",
+        [OPCODE_MSUB >> 2] = "MSUB",
+        [OPCODE_NMSUB >> 2] = "NMSUB",
+        [OPCODE_NMADD >> 2] = "NMADD",
+        [OPCODE_OP_FP >> 2] = "OP_FP",
+        [OPCODE_BRANCH >> 2] = "BRANCH",
+        [OPCODE_JALR >> 2] = "JALR",
+        [OPCODE_JAL >> 2] = "JAL",
+        [OPCODE_SYSTEM >> 2] = "SYSTEM",
+};
+
+static uint32_t variant_key(uint32_t instruction) {
+    uint32_t opcode = OPCODE(instruction);
+    uint32_t funct3 = FUNCT3(instruction);
+    uint32_t funct7 = FUNCT7(instruction);
+    switch (opcode) {
+        case OPCODE_OP:
+        case OPCODE_OP_32:
+        case OPCODE_OP_FP:
+            break;
+        case OPCODE_AMO:
+            funct7 &= 0x7C; // 去掉 aq/rl
+            break;
+        case OPCODE_OP_IMM:
+        case OPCODE_OP_IMM_32:
+            // 只有移位指令的 funct7 (去掉 RV64 shamt 的最高位) 有意义
+            funct7 = (funct3 == 1 || funct3 == 5) ? (funct7 & 0x7E) : 0;
+            break;
+        case OPCODE_SYSTEM:
+            if (funct3 == 0) {
+                return VARIANT_SYSTEM_PRIV | (funct7 << 10) | ((RS2(instruction) & 0x7) << 7) | opcode;
+            }
+            funct7 = 0;
+            break;
+        case OPCODE_LUI:
+        case OPCODE_AUIPC:
+        case OPCODE_JAL:
+            // 没有 funct3 字段
+            funct3 = 0;
+            funct7 = 0;
+            break;
+        default:
+            funct7 = 0;
+            break;
+    }
+    return (funct7 << 10) | (funct3 << 7) | opcode;
+}
+
+// 由变体键构造一条代表性指令，用于 disassemble() 得到助记符
+static uint32_t variant_sample(uint32_t key) {
+    uint32_t opcode = key & 0x7F;
+    uint32_t funct3 = (key >> 7) & 0x7;
+    uint32_t funct7 = (key >> 10) & 0x7F;
+    if (key & VARIANT_SYSTEM_PRIV) {
+        return (funct7 << 25) | (funct3 << 20) | opcode;
+    }
+    // rd = x1, rs1 = x2, rs2 = x3，避免被反汇编成 li/mv/nop 等伪指令
+    return (funct7 << 25) | (3 << 20) | (2 << 15) | (funct3 << 12) | (1 << 7) | opcode;
+}
+
+static void accumulate_block(const Block *block, void *arg) {
+    uint64_t *variants = (uint64_t *) arg;
+    for (uint32_t i = 0; i < block->length; i++) {
+        variants[variant_key(block->insts[i])] += block_inst_count(block, i);
+    }
+}
+
+void profile_block_retired(const Block *block) {
+    if (profile_enabled) {
+        accumulate_block(block, retired_variants);
+    }
+}
+
+typedef struct {
+    const Block **blocks;
+    size_t count;
+    size_t capacity;
+} BlockList;
+
+static void collect_block(const Block *block, void *arg) {
+    BlockList *list = (BlockList *) arg;
+    if (block->exec_count == 0) {
+        return;
+    }
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 1024;
+        const Block **blocks = realloc(list->blocks, capacity * sizeof(Block *));
+        if (blocks == NULL) {
+            return;
+        }
+        list->blocks = blocks;
+        list->capacity = capacity;
+    }
+    list->blocks[list->count++] = block;
+}
+
+static uint64_t block_weight(const Block *block) {
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < block->length; i++) {
+        total += block_inst_count(block, i);
+    }
+    return total;
+}
+
+// 按块内执行的指令总数降序
+static int compare_blocks(const void *a, const void *b) {
+    uint64_t wa = block_weight(*(const Block **) a);
+    uint64_t wb = block_weight(*(const Block **) b);
+    return (wa < wb) - (wa > wb);
+}
+
+static const uint64_t *sort_variants_base;
+
+static int compare_variants(const void *a, const void *b) {
+    uint64_t ca = sort_variants_base[*(const uint32_t *) a];
+    uint64_t cb = sort_variants_base[*(const uint32_t *) b];
+    return (ca < cb) - (ca > cb);
+}
+
+static inline double percent(uint64_t part, uint64_t total) {
+    return total ? 100.0 * (double) part / (double) total : 0.0;
+}
+
+static void write_report(FILE *out, const uint64_t *variants, BlockList *list) {
+    uint64_t class_counts[32] = {0};
+    uint64_t total = 0;
+    size_t variant_count = 0;
+    for (uint32_t key = 0; key < VARIANT_COUNT; key++) {
+        if (variants[key] != 0) {
+            class_counts[(key & 0x7F) >> 2] += variants[key];
+            total += variants[key];
+            variant_count++;
+        }
+    }
+
+    fprintf(out, "# instruction mix: %lu instructions\n", total);
+    fprintf(out, "\n## opcode classes\n");
+    uint32_t classes[32];
+    for (uint32_t i = 0; i < 32; i++) {
+        classes[i] = i;
+    }
+    sort_variants_base = class_counts;
+    qsort(classes, 32, sizeof(uint32_t), compare_variants);
+    for (uint32_t i = 0; i < 32 && class_counts[classes[i]] != 0; i++) {
+        uint32_t c = classes[i];
+        const char *name = opcode_class_names[c] ? opcode_class_names[c] : "UNKNOWN";
+        fprintf(out, "%-12s %14lu %6.2f%%\n", name, class_counts[c], percent(class_counts[c], total));
+    }
+
+    fprintf(out, "\n## variants (opcode/funct3/funct7)\n");
+    uint32_t *keys = malloc(variant_count * sizeof(uint32_t));
+    if (keys != NULL) {
+        size_t n = 0;
+        for (uint32_t key = 0; key < VARIANT_COUNT; key++) {
+            if (variants[key] != 0) {
+                keys[n++] = key;
+            }
+        }
+        sort_variants_base = variants;
+        qsort(keys, n, sizeof(uint32_t), compare_variants);
+        char buffer[128];
+        for (size_t i = 0; i < n; i++) {
+            disassemble(0, variant_sample(keys[i]), buffer, sizeof(buffer));
+            buffer[strcspn(buffer, " ")] = '\0';
+            fprintf(out, "%-12s opcode=0x%02x funct3=%u funct7=0x%02x %14lu %6.2f%%\n", buffer,
+                    keys[i] & 0x7F, (keys[i] >> 7) & 0x7, (keys[i] >> 10) & 0x7F,
+                    variants[keys[i]], percent(variants[keys[i]], total));
+        }
+        free(keys);
+    }
+
+    qsort(list->blocks, list->count, sizeof(Block *), compare_blocks);
+    fprintf(out, "\n## hot blocks (%zu executed)\n", list->count);
+    for (size_t i = 0; i < list->count && i < PROFILE_TOP_BLOCKS; i++) {
+        const Block *block = list->blocks[i];
+        uint64_t weight = block_weight(block);
+        fprintf(out, "\n#%zu pc=0x%lx entries=%lu instructions=%lu (%.2f%%)\n", i + 1, block->start_pc,
+                block->exec_count, weight, percent(weight, total));
+        char buffer[128];
+        for (uint32_t j = 0; j < block->length; j++) {
+            uint64_t pc = block->start_pc + 4 * j;
+            disassemble(pc, block->insts[j], buffer, sizeof(buffer));
+            fprintf(out, "  %14lu  %016lx  %08x  %s\n", block_inst_count(block, j), pc, block->insts[j], buffer);
+        }
+    }
+}
+
+void profile_dump(void) {
+    if (!profile_enabled) {
+        return;
+    }
+    // 在基本块中间退出时，块里剩下的指令没有执行
+    block_settle_running(get_cpu()->csr.minstret);
+    uint64_t *variants = malloc(sizeof(retired_variants));
+    if (variants == NULL) {
+        return;
+    }
+    memcpy(variants, retired_variants, sizeof(retired_variants));
+    block_cache_foreach(accumulate_block, variants);
+    BlockList list = {NULL, 0, 0};
+    block_cache_foreach(collect_block, &list);
+
+    FILE *out = fopen(profile_path, "w");
+    if (out == NULL) {
+        LOG_ERROR(LOG_CAT_CPU, "Failed to open profile file %s\n", profile_path);
+    } else {
+        write_report(out, variants, &list);
+        fclose(out);
+    }
+    free(list.blocks);
+    free(variants);
+}
+
+static void handle_sigusr1(int signal) {
+    (void) signal;
+    profile_request_dump();
+}
+
+int profile_open(const char *path) {
+    profile_path = path;
+    profile_enabled = true;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_sigusr1;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    if (sigaction(SIGUSR1, &action, NULL) != 0) {
+        perror("Failed to install SIGUSR1 handler");
+        return -1;
+    }
+    atexit(profile_dump);
+    return 0;
+}
@@ -5,7 +5,7 @@
 #include "r_inst.h"
 #include "m_extension.h"
 #include "display.h"
-#include "mfprintf.h"
+#include "log.h"
 
 // R-type指令处理函数
 void execute_r_type_instruction(CPU *cpu, uint32_t instruction) {
@@ -63,7 +63,7 @@ void execute_r_type_instruction(CPU *cpu, uint32_t instruction) {
             break;
             // 其他R型指令
         default:
-            mfprintf("Unknown R-type instruction with funct3: 0x%x\n", funct3);
+            LOG_WARN(LOG_CAT_CPU, "Unknown R-type instruction with funct3: 0x%x\n", funct3);
             break;
     }
 }
@@ -0,0 +1,496 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "replay.h"
+#include "memory.h"
+#include "uart.h"
+#include "clint.h"
+#include "plic.h"
+#include "block.h"
+#include "sampler.h"
+#include "debug.h"
+#include "gdbstub.h"
+#include "log.h"
+
+// 内存中的日志条目，data 是在 log_data 中的偏移
+typedef struct {
+    uint64_t vtime;
+    uint16_t kind;
+    uint16_t length;
+    uint32_t data;
+} LogEntry;
+
+// REPLAY_INPUT_SYNC 的数据
+typedef struct {
+    uint64_t pc;
+    uint64_t icount;
+    uint64_t hash;
+} SyncRecord;
+
+// 检查点：设备状态整体拷贝，内存只保存之后第一次被写的页 (撤销日志)
+typedef struct {
+    uint64_t icount;
+    size_t log_cursor;
+    CPU cpu;
+    ShadowStack shadow_stack;
+    CLINT clint;
+    PLIC plic;
+    UartState uart;
+    EventState events;
+    uint32_t *pages;
+    uint8_t *page_data;
+    uint32_t page_count;
+    uint32_t page_capacity;
+} Checkpoint;
+
+typedef enum {
+    PHASE_NONE,
+    PHASE_STEP,     // 反向单步：执行到目标指令数
+    PHASE_SEARCH,   // 反向继续：从检查点执行到目标，记下途中最后一次命中
+    PHASE_LAND,     // 找到命中后再次从检查点执行到命中位置
+} ReversePhase;
+
+ReplayMode replay_mode = REPLAY_OFF;
+bool replay_live = false;
+uint64_t replay_frontier = 0;
+
+static FILE *log_file = NULL;
+static LogEntry *entries = NULL;
+static size_t entry_count = 0;
+static size_t entry_capacity = 0;
+static uint8_t *log_data = NULL;
+static size_t data_size = 0;
+static size_t data_capacity = 0;
+static size_t cursor = 0;               // 下一条要送达的条目
+static uint64_t last_poll_vtime = EVENT_NEVER;
+static bool diverged = false;
+
+static Checkpoint **checkpoints = NULL;
+static int checkpoint_count = 0;
+static int checkpoint_capacity = 0;
+static uint64_t saved_pages = 0;
+static uint64_t next_checkpoint = 0;
+
+static ReversePhase phase = PHASE_NONE;
+static uint64_t target = 0;             // 反向执行要到达的指令数
+static int search_index = 0;            // 反向继续正在搜索的检查点
+static bool have_hit = false;
+static uint64_t hit_icount = 0;
+static DebugStop last_hit;
+
+static void boundary_expired(CPU *cpu, void *opaque);
+static void target_expired(CPU *cpu, void *opaque);
+
+// 下一条日志的送达时刻：只用来让基本块在这里结束
+static EventTimer boundary_timer = EVENT_TIMER_INIT("replay", boundary_expired, NULL);
+static EventTimer target_timer = EVENT_TIMER_INIT("replay-target", target_expired, NULL);
+
+static void boundary_expired(CPU *cpu, void *opaque) {
+    (void) cpu;
+    (void) opaque;
+}
+
+static void arm_target(CPU *cpu) {
+    uint64_t icount = replay_icount(cpu);
+    if (icount >= target) {
+        event_timer_del(&target_timer);
+        debug_request_stop(DEBUG_STOP_STEP, 0, 0);
+        return;
+    }
+    event_timer_mod(&target_timer, event_now(cpu) + (target - icount));
+}
+
+// WFI 快进的时间不算指令，到期时可能还没到目标，按剩下的指令数重新预约
+static void target_expired(CPU *cpu, void *opaque) {
+    (void) opaque;
+    if (phase != PHASE_NONE) {
+        arm_target(cpu);
+    }
+}
+
+static uint64_t register_hash(const CPU *cpu) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const uint8_t *bytes = (const uint8_t *) cpu->registers;
+    for (size_t i = 0; i < sizeof(cpu->registers); i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash ^ cpu->pc;
+}
+
+static void append_entry(uint64_t vtime, ReplayInputKind kind, const uint8_t *data, size_t length) {
+    if (entry_count == entry_capacity) {
+        entry_capacity = entry_capacity ? entry_capacity * 2 : 256;
+        entries = realloc(entries, entry_capacity * sizeof(*entries));
+    }
+    if (data_size + length > data_capacity) {
+        while (data_size + length > data_capacity) {
+            data_capacity = data_capacity ? data_capacity * 2 : 4096;
+        }
+        log_data = realloc(log_data, data_capacity);
+    }
+    if (entries == NULL || log_data == NULL) {
+        fprintf(stderr, "Out of memory for replay log\n");
+        exit(1);
+    }
+    LogEntry *entry = &entries[entry_count++];
+    entry->vtime = vtime;
+    entry->kind = kind;
+    entry->length = (uint16_t) length;
+    entry->data = (uint32_t) data_size;
+    memcpy(log_data + data_size, data, length);
+    data_size += length;
+}
+
+void replay_record_input(ReplayInputKind kind, const uint8_t *data, size_t length) {
+    if (replay_mode != REPLAY_RECORD || !replay_live) {
+        return;
+    }
+    uint64_t vtime = event_now(get_cpu());
+    append_entry(vtime, kind, data, length);
+    cursor = entry_count;
+    // 每条都落盘，模拟器被强行结束时日志仍然可用
+    ReplayEntryHeader header = {.vtime = vtime, .kind = kind, .length = (uint16_t) length};
+    fwrite(&header, sizeof(header), 1, log_file);
+    fwrite(data, 1, length, log_file);
+    fflush(log_file);
+}
+
+static int load_log(FILE *file, uint64_t load_address) {
+    ReplayFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != REPLAY_MAGIC ||
+        header.version != REPLAY_VERSION) {
+        fprintf(stderr, "Not a replay log\n");
+        return -1;
+    }
+    if (header.load_address != load_address) {
+        fprintf(stderr, "Warning: replay log was recorded with load address 0x%lx\n", header.load_address);
+    }
+    ReplayEntryHeader entry;
+    uint8_t data[UINT16_MAX];
+    while (fread(&entry, sizeof(entry), 1, file) == 1) {
+        if (fread(data, 1, entry.length, file) != entry.length) {
+            fprintf(stderr, "Warning: replay log truncated after %zu entries\n", entry_count);
+            break;
+        }
+        append_entry(entry.vtime, entry.kind, data, entry.length);
+    }
+    return 0;
+}
+
+int replay_open(const char *path, ReplayMode mode, uint64_t load_address) {
+    if (mode == REPLAY_RECORD) {
+        log_file = fopen(path, "wb");
+        if (log_file == NULL) {
+            perror("Failed to open record file");
+            return -1;
+        }
+        ReplayFileHeader header = {.magic = REPLAY_MAGIC, .version = REPLAY_VERSION, .load_address = load_address};
+        fwrite(&header, sizeof(header), 1, log_file);
+        fflush(log_file);
+    } else {
+        FILE *file = fopen(path, "rb");
+        if (file == NULL) {
+            perror("Failed to open replay file");
+            return -1;
+        }
+        int result = load_log(file, load_address);
+        fclose(file);
+        if (result < 0) {
+            return -1;
+        }
+    }
+    replay_mode = mode;
+    replay_reset();
+    return 0;
+}
+
+static void free_checkpoint(Checkpoint *checkpoint) {
+    saved_pages -= checkpoint->page_count;
+    free(checkpoint->pages);
+    free(checkpoint->page_data);
+    free(checkpoint);
+}
+
+static void take_checkpoint(CPU *cpu) {
+    if (checkpoint_count == checkpoint_capacity) {
+        checkpoint_capacity = checkpoint_capacity ? checkpoint_capacity * 2 : 16;
+        checkpoints = realloc(checkpoints, checkpoint_capacity * sizeof(*checkpoints));
+    }
+    Checkpoint *checkpoint = calloc(1, sizeof(*checkpoint));
+    if (checkpoints == NULL || checkpoint == NULL) {
+        fprintf(stderr, "Out of memory for replay checkpoint\n");
+        exit(1);
+    }
+    checkpoint->icount = replay_icount(cpu);
+    checkpoint->log_cursor = cursor;
+    checkpoint->cpu = *cpu;
+    checkpoint->shadow_stack = *cpu->shadow_stack;
+    checkpoint->clint = *cpu->clint;
+    checkpoint->plic = *cpu->plic;
+    uart_save(&checkpoint->uart);
+    event_save(&checkpoint->events);
+    checkpoints[checkpoint_count++] = checkpoint;
+    memory_set_page_flags(0, MEMORY_SIZE, PAGE_FLAG_SNAPSHOT, true);
+    next_checkpoint = checkpoint->icount + REPLAY_CHECKPOINT_INSTRET;
+}
+
+void replay_save_pages(uint64_t offset, uint64_t length) {
+    if (checkpoint_count == 0 || length == 0) {
+        return;
+    }
+    Checkpoint *checkpoint = checkpoints[checkpoint_count - 1];
+    const uint8_t *data = get_cpu()->memory->data;
+    for (uint64_t page = offset >> MEMORY_PAGE_SHIFT; page <= (offset + length - 1) >> MEMORY_PAGE_SHIFT; page++) {
+        if ((memory_page_flags[page] & PAGE_FLAG_SNAPSHOT) == 0 || page >= MEMORY_NUM_PAGES) {
+            continue;
+        }
+        if (checkpoint->page_count == checkpoint->page_capacity) {
+            checkpoint->page_capacity = checkpoint->page_capacity ? checkpoint->page_capacity * 2 : 64;
+            checkpoint->pages = realloc(checkpoint->pages, checkpoint->page_capacity * sizeof(uint32_t));
+            checkpoint->page_data = realloc(checkpoint->page_data,
+                                            (size_t) checkpoint->page_capacity * MEMORY_PAGE_SIZE);
+            if (checkpoint->pages == NULL || checkpoint->page_data == NULL) {
+                fprintf(stderr, "Out of memory for replay checkpoint\n");
+                exit(1);
+            }
+        }
+        checkpoint->pages[checkpoint->page_count] = (uint32_t) page;
+        memcpy(checkpoint->page_data + (size_t) checkpoint->page_count * MEMORY_PAGE_SIZE,
+               data + (page << MEMORY_PAGE_SHIFT), MEMORY_PAGE_SIZE);
+        checkpoint->page_count++;
+        saved_pages++;
+        memory_page_flags[page] &= ~PAGE_FLAG_SNAPSHOT;
+    }
+    // 保存的页太多时丢弃最早的检查点；反向执行途中检查点下标还在使用，等结束后再丢
+    while (saved_pages > REPLAY_MAX_SAVED_PAGES && checkpoint_count > 1 && phase == PHASE_NONE) {
+        free_checkpoint(checkpoints[0]);
+        checkpoint_count--;
+        memmove(checkpoints, checkpoints + 1, checkpoint_count * sizeof(*checkpoints));
+    }
+}
+
+// 回到第 index 个检查点：依次撤销之后的内存写入，丢弃更新的检查点
+static void restore_checkpoint(CPU *cpu, int index) {
+    uint8_t *data = cpu->memory->data;
+    for (int i = checkpoint_count - 1; i >= index; i--) {
+        Checkpoint *checkpoint = checkpoints[i];
+        for (uint32_t j = 0; j < checkpoint->page_count; j++) {
+            uint64_t offset = (uint64_t) checkpoint->pages[j] << MEMORY_PAGE_SHIFT;
+            memcpy(data + offset, checkpoint->page_data + (size_t) j * MEMORY_PAGE_SIZE, MEMORY_PAGE_SIZE);
+            block_cache_code_write(offset, MEMORY_PAGE_SIZE);
+        }
+        if (i > index) {
+            free_checkpoint(checkpoint);
+        }
+    }
+    checkpoint_count = index + 1;
+    Checkpoint *checkpoint = checkpoints[index];
+    saved_pages -= checkpoint->page_count;
+    checkpoint->page_count = 0;
+    memory_set_page_flags(0, MEMORY_SIZE, PAGE_FLAG_SNAPSHOT, true);
+
+    // 设备指针和运行模式不属于客户机状态
+    Memory *memory = cpu->memory;
+    CLINT *clint = cpu->clint;
+    PLIC *plic = cpu->plic;
+    UART *uart = cpu->uart;
+    bool fast_mode = cpu->fast_mode;
+    *cpu = checkpoint->cpu;
+    *cpu->shadow_stack = checkpoint->shadow_stack;
+    cpu->memory = memory;
+    cpu->clint = clint;
+    cpu->plic = plic;
+    cpu->uart = uart;
+    cpu->fast_mode = fast_mode;
+    *clint = checkpoint->clint;
+    *plic = checkpoint->plic;
+    uart_restore(&checkpoint->uart);
+    event_restore(&checkpoint->events);
+    event_timer_del(&boundary_timer);
+    event_timer_del(&target_timer);
+    gdb_reset();
+
+    cursor = checkpoint->log_cursor;
+    last_poll_vtime = EVENT_NEVER;
+    next_checkpoint = checkpoint->icount + REPLAY_CHECKPOINT_INSTRET;
+    replay_live = false;
+    debug_resume(DEBUG_NO_PC);
+}
+
+static void check_sync(CPU *cpu, const LogEntry *entry) {
+    SyncRecord sync;
+    if (diverged || entry->length != sizeof(sync)) {
+        return;
+    }
+    memcpy(&sync, log_data + entry->data, sizeof(sync));
+    if (sync.pc != cpu->pc || sync.icount != replay_icount(cpu) || sync.hash != register_hash(cpu)) {
+        diverged = true;
+        fprintf(stderr, "Warning: replay diverged from the log at instret %lu (pc 0x%lx, expected 0x%lx)\n",
+                replay_icount(cpu), cpu->pc, sync.pc);
+    }
+}
+
+void replay_service(CPU *cpu) {
+    uint64_t now = event_now(cpu);
+    if (now == last_poll_vtime) {
+        // 同一虚拟时间的第二轮 (停止请求、到期事件)：输入已经在第一轮送达
+        replay_live = false;
+        return;
+    }
+    last_poll_vtime = now;
+    while (cursor < entry_count && entries[cursor].vtime <= now) {
+        const LogEntry *entry = &entries[cursor++];
+        if (entry->vtime != now && !diverged) {
+            diverged = true;
+            fprintf(stderr, "Warning: replay input for time %lu delivered late at %lu\n", entry->vtime, now);
+        }
+        if (entry->kind == REPLAY_INPUT_UART_RX) {
+            uart_rx_inject(log_data + entry->data, entry->length);
+        } else if (entry->kind == REPLAY_INPUT_SYNC) {
+            check_sync(cpu, entry);
+        }
+    }
+    if (cursor < entry_count) {
+        event_timer_mod(&boundary_timer, entries[cursor].vtime);
+    } else {
+        event_timer_del(&boundary_timer);
+    }
+
+    uint64_t icount = replay_icount(cpu);
+    if (icount > replay_frontier) {
+        replay_frontier = icount;
+    }
+    replay_live = replay_mode == REPLAY_RECORD && cursor == entry_count && icount >= replay_frontier;
+    if (icount >= next_checkpoint) {
+        take_checkpoint(cpu);
+        if (replay_live) {
+            SyncRecord sync = {.pc = cpu->pc, .icount = icount, .hash = register_hash(cpu)};
+            replay_record_input(REPLAY_INPUT_SYNC, (const uint8_t *) &sync, sizeof(sync));
+        }
+    }
+}
+
+void replay_reset(void) {
+    while (checkpoint_count > 0) {
+        free_checkpoint(checkpoints[--checkpoint_count]);
+    }
+    memory_set_page_flags(0, MEMORY_SIZE, PAGE_FLAG_SNAPSHOT, false);
+    event_timer_del(&boundary_timer);
+    event_timer_del(&target_timer);
+    if (replay_mode == REPLAY_RECORD) {
+        // 复位后重新记录
+        entry_count = 0;
+        data_size = 0;
+        fflush(log_file);
+        if (ftruncate(fileno(log_file), sizeof(ReplayFileHeader)) == 0) {
+            fseek(log_file, sizeof(ReplayFileHeader), SEEK_SET);
+        }
+    }
+    cursor = 0;
+    last_poll_vtime = EVENT_NEVER;
+    next_checkpoint = 0;
+    replay_frontier = 0;
+    replay_live = false;
+    diverged = false;
+    phase = PHASE_NONE;
+}
+
+static bool history_begin(void) {
+    phase = PHASE_NONE;
+    debug_set_stop(DEBUG_STOP_HISTORY_BEGIN, 0, 0);
+    return false;
+}
+
+bool replay_reverse_step(CPU *cpu) {
+    uint64_t icount = replay_icount(cpu);
+    if (checkpoint_count == 0 || icount <= checkpoints[0]->icount) {
+        return history_begin();
+    }
+    target = icount - 1;
+    int index = checkpoint_count - 1;
+    while (checkpoints[index]->icount > target) {
+        index--;
+    }
+    restore_checkpoint(cpu, index);
+    phase = PHASE_STEP;
+    arm_target(cpu);
+    return true;
+}
+
+bool replay_reverse_continue(CPU *cpu) {
+    uint64_t icount = replay_icount(cpu);
+    if (checkpoint_count == 0 || icount <= checkpoints[0]->icount) {
+        return history_begin();
+    }
+    int index = checkpoint_count - 1;
+    while (checkpoints[index]->icount >= icount) {
+        index--;
+    }
+    restore_checkpoint(cpu, index);
+    phase = PHASE_SEARCH;
+    search_index = index;
+    target = icount;
+    have_hit = false;
+    arm_target(cpu);
+    return true;
+}
+
+bool replay_filter_stop(CPU *cpu) {
+    if (phase == PHASE_NONE) {
+        return false;
+    }
+    // 先清掉这次请求，下面恢复检查点时可能立即请求下一次停止
+    debug_stop_pending = false;
+    if (debug_stop.reason == DEBUG_STOP_INTERRUPT) {
+        // 调试器要求暂停，就停在重新执行到的位置
+        phase = PHASE_NONE;
+        event_timer_del(&target_timer);
+        return false;
+    }
+    uint64_t icount = replay_icount(cpu);
+    if (icount < target) {
+        // 还没到目标：途中的断点和观察点不报告，反向继续记下最后一次命中
+        if (phase == PHASE_SEARCH &&
+            (debug_stop.reason == DEBUG_STOP_BREAKPOINT || debug_stop.reason == DEBUG_STOP_WATCHPOINT)) {
+            last_hit = debug_stop;
+            hit_icount = icount;
+            have_hit = true;
+        }
+        if (debug_stop.reason == DEBUG_STOP_BREAKPOINT) {
+            debug_resume(cpu->pc);
+        }
+        return true;
+    }
+    event_timer_del(&target_timer);
+    switch (phase) {
+        case PHASE_STEP:
+            phase = PHASE_NONE;
+            debug_set_stop(DEBUG_STOP_STEP, 0, 0);
+            return false;
+        case PHASE_LAND:
+            phase = PHASE_NONE;
+            debug_stop = last_hit;
+            return false;
+        default:
+            break;
+    }
+    if (have_hit) {
+        restore_checkpoint(cpu, search_index);
+        phase = PHASE_LAND;
+        target = hit_icount;
+        arm_target(cpu);
+        return true;
+    }
+    if (search_index == 0) {
+        // 整段历史都没有命中，停在最早的检查点
+        restore_checkpoint(cpu, 0);
+        return history_begin();
+    }
+    // 这一段没有命中，往前一段继续找
+    target = checkpoints[search_index]->icount;
+    search_index--;
+    restore_checkpoint(cpu, search_index);
+    arm_target(cpu);
+    return true;
+}
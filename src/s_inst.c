@@ -1,7 +1,7 @@
 #include <stdio.h>
 #include "s_inst.h"
 #include "uart.h"
-#include "mfprintf.h"
+#include "log.h"
 #include "exception.h"
 #include "csr.h"
 
@@ -19,7 +19,7 @@ void execute_s_type_instruction(CPU *cpu, uint32_t instruction) {
     // 计算目标地址
     uint64_t addr = cpu->registers[rs1] + imm;
     if (addr < 0x100 || addr >= MEMORY_END_ADDR) {
-        raise_exception(cpu, CAUSE_LOAD_ACCESS_FAULT);
+        raise_exception_with_tval(cpu, CAUSE_STORE_ACCESS_FAULT, addr);
         cpu->trap_occurred = true;
         return;
     }
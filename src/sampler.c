@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include "sampler.h"
+#include "symbols.h"
+#include "log.h"
+
+// 栈帧标识：能解析到符号时为 SYMBOL_FRAME | 符号序号，否则为原始 pc
+#define SYMBOL_FRAME (1ULL << 63)
+
+typedef struct {
+    uint64_t hash;
+    uint64_t count;
+    uint32_t offset;   // 在 frame_pool 中的起始位置
+    uint32_t length;   // 0 表示空槽
+} StackEntry;
+
+atomic_int sampler_pending = 0;
+
+static const char *sampler_path = NULL;
+static int sampler_timer = -1;
+static StackEntry stack_table[SAMPLER_TABLE_SIZE];
+static uint64_t *frame_pool = NULL;
+static size_t frame_pool_used = 0;
+static size_t frame_pool_capacity = 0;
+static size_t unique_stacks = 0;
+static uint64_t total_samples = 0;
+static uint64_t dropped_samples = 0;
+static ShadowStack shadow_stacks[MAX_HARTS];
+
+static inline uint64_t frame_id(uint64_t pc) {
+    int index = symbols_lookup(pc);
+    return index >= 0 ? (SYMBOL_FRAME | (uint64_t) index) : pc;
+}
+
+static uint64_t hash_frames(const uint64_t *frames, uint32_t length) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (uint32_t i = 0; i < length; i++) {
+        hash = (hash ^ frames[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static bool append_frames(const uint64_t *frames, uint32_t length) {
+    if (frame_pool_used + length > frame_pool_capacity) {
+        size_t capacity = frame_pool_capacity ? frame_pool_capacity * 2 : 65536;
+        uint64_t *pool = realloc(frame_pool, capacity * sizeof(uint64_t));
+        if (pool == NULL) {
+            return false;
+        }
+        frame_pool = pool;
+        frame_pool_capacity = capacity;
+    }
+    memcpy(frame_pool + frame_pool_used, frames, length * sizeof(uint64_t));
+    frame_pool_used += length;
+    return true;
+}
+
+ShadowStack *sampler_shadow_stack(uint64_t hartid) {
+    return &shadow_stacks[hartid % MAX_HARTS];
+}
+
+void sampler_take(CPU *cpu) {
+    uint64_t frames[SHADOW_STACK_SIZE + 1];
+    uint32_t length = 0;
+    const ShadowStack *stack = cpu->shadow_stack;
+    uint32_t first = stack->depth > SHADOW_STACK_SIZE ? stack->depth - SHADOW_STACK_SIZE : 0;
+
+    // 从栈底到栈顶：每个调用点所在的函数，最后是当前 pc 所在的函数
+    for (uint32_t i = first; i < stack->depth; i++) {
+        frames[length++] = frame_id(stack->call_sites[i & (SHADOW_STACK_SIZE - 1)]);
+    }
+    frames[length++] = frame_id(cpu->pc);
+    total_samples++;
+
+    uint64_t hash = hash_frames(frames, length);
+    for (uint32_t probe = 0; probe < SAMPLER_TABLE_SIZE; probe++) {
+        StackEntry *entry = &stack_table[(hash + probe) & (SAMPLER_TABLE_SIZE - 1)];
+        if (entry->length == 0) {
+            // 表项保留 1/8 空闲以保持探测长度
+            if (unique_stacks >= SAMPLER_TABLE_SIZE - SAMPLER_TABLE_SIZE / 8 || !append_frames(frames, length)) {
+                break;
+            }
+            entry->hash = hash;
+            entry->count = 1;
+            entry->offset = (uint32_t) (frame_pool_used - length);
+            entry->length = length;
+            unique_stacks++;
+            return;
+        }
+        if (entry->hash == hash && entry->length == length &&
+            memcmp(frame_pool + entry->offset, frames, length * sizeof(uint64_t)) == 0) {
+            entry->count++;
+            return;
+        }
+    }
+    dropped_samples++;
+}
+
+static void write_frame(FILE *out, uint64_t frame) {
+    if (frame & SYMBOL_FRAME) {
+        fputs(symbols_name((int) (frame & ~SYMBOL_FRAME)), out);
+    } else {
+        fprintf(out, "0x%lx", frame);
+    }
+}
+
+void sampler_dump(void) {
+    if (sampler_path == NULL) {
+        return;
+    }
+    FILE *out = fopen(sampler_path, "w");
+    if (out == NULL) {
+        LOG_ERROR(LOG_CAT_CPU, "Failed to open sample file %s\n", sampler_path);
+        return;
+    }
+    for (uint32_t i = 0; i < SAMPLER_TABLE_SIZE; i++) {
+        const StackEntry *entry = &stack_table[i];
+        if (entry->length == 0) {
+            continue;
+        }
+        for (uint32_t j = 0; j < entry->length; j++) {
+            if (j != 0) {
+                fputc(';', out);
+            }
+            write_frame(out, frame_pool[entry->offset + j]);
+        }
+        fprintf(out, " %lu\n", entry->count);
+    }
+    fclose(out);
+    if (dropped_samples != 0) {
+        LOG_WARN(LOG_CAT_CPU, "sampler: %lu of %lu samples dropped (stack table full)\n",
+                 dropped_samples, total_samples);
+    }
+}
+
+// 采样定时线程：阻塞在 timerfd 上，到期时只置位标志，真正的采样由 CPU 线程完成
+static void *sampler_timer_loop(void *arg) {
+    (void) arg;
+    uint64_t expirations;
+    while (read(sampler_timer, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+        atomic_store_explicit(&sampler_pending, 1, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+int sampler_open(const char *path, int hz) {
+    if (hz <= 0) {
+        hz = SAMPLER_DEFAULT_HZ;
+    }
+    sampler_timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (sampler_timer < 0) {
+        perror("Failed to create sampling timer");
+        return -1;
+    }
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = 0;
+    spec.it_interval.tv_nsec = 1000000000L / hz;
+    if (hz == 1) {
+        spec.it_interval.tv_sec = 1;
+        spec.it_interval.tv_nsec = 0;
+    }
+    spec.it_value = spec.it_interval;
+    if (timerfd_settime(sampler_timer, 0, &spec, NULL) != 0) {
+        perror("Failed to start sampling timer");
+        return -1;
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, sampler_timer_loop, NULL) != 0) {
+        return -1;
+    }
+    pthread_detach(thread);
+    sampler_path = path;
+    atexit(sampler_dump);
+    return 0;
+}
@@ -7,6 +7,16 @@
 #include "simulator.h"
 #include "exception.h"
 #include "csr.h"
+#include "trace.h"
+#include "block.h"
+#include "profile.h"
+#include "sampler.h"
+#include "snapshot.h"
+#include "event.h"
+#include "virtio.h"
+#include "debug.h"
+#include "gdbstub.h"
+#include "replay.h"
 
 // 获取当前的 TSC 值
 static inline uint64_t rdtsc(void) {
@@ -18,6 +28,207 @@ static inline uint64_t rdtsc(void) {
     return ((uint64_t)hi << 32) | lo;
 }
 
+// 执行一条指令并累加 minstret，开启 --trace 时同时记录执行轨迹
+static inline void execute_instruction(CPU *cpu, uint32_t instruction) {
+    if (trace_enabled) {
+        trace_execute(cpu, instruction);
+    } else {
+        cpu_execute(cpu, instruction);
+    }
+    cpu->csr.minstret += 1;
+}
+
+// 执行基本块中从 fused 开始的融合指令对。调用前已确认没有挂起且使能的中断，而前一条只写整数寄存器、
+// 不改变中断状态，两条指令之间的中断检查因此不会触发，合在一起执行与逐条执行结果相同
+static inline void execute_fused(CPU *cpu, const FusedOp *fused, uint32_t second) {
+    switch (fused->kind) {
+        case FUSE_CONST:
+            cpu->registers[fused->rd] = fused->value;
+            break;
+        case FUSE_SHIFT:
+            cpu->registers[fused->rd] = (cpu->registers[fused->rs1] << fused->rs2) >> fused->shift;
+            break;
+        case FUSE_PC_REL:
+        case FUSE_INDEXED:
+            // 访存和跳转可能陷入，后一条照常执行，陷入时前一条已经完成
+            cpu->registers[fused->rd] = fused->kind == FUSE_PC_REL ? fused->value :
+                                        cpu->registers[fused->rs1] + cpu->registers[fused->rs2];
+            cpu->pc += 4;
+            cpu->csr.minstret += 1;
+            execute_instruction(cpu, second);
+            return;
+        default:
+            break;
+    }
+    cpu->pc += 8;
+    cpu->csr.minstret += 2;
+}
+
+// 没有挂起且使能的中断时才融合，开启 --trace 时逐条执行以便记录每条指令
+static inline bool fusion_allowed(const CPU *cpu) {
+    return !trace_enabled && (cpu->csr.mie & cpu->csr.mip) == 0;
+}
+
+// 发布最新的状态快照并通知显示线程刷新
+static inline void notify_display(Simulator *simulator) {
+    snapshot_publish(simulator->cpu);
+    sem_post(simulator->sem_refresh);
+}
+
+// 块内有断点时逐条检查 pc，命中时停在断点指令之前
+static void execute_block_checked(CPU *cpu, Block *block, uint32_t length) {
+    uint64_t next_pc = block->start_pc;
+    uint32_t executed = length;
+    for (uint32_t i = 0; i < length; i++) {
+        if (debug_breakpoint_hit(cpu->pc)) {
+            debug_request_stop(DEBUG_STOP_BREAKPOINT, cpu->pc, 0);
+            if (i == 0) {
+                return;
+            }
+            executed = i;
+            break;
+        }
+        if (i == 0) {
+            block_enter(cpu, block);
+        }
+        execute_instruction(cpu, block->insts[i]);
+        next_pc += 4;
+        if ((cpu->pc != next_pc || block_exit_requested) && i + 1 < length) {
+            executed = i + 1;
+            break;
+        }
+    }
+    block_leave();
+    if (executed < block->length) {
+        block_early_exit(block, executed);
+    }
+}
+
+// 块的入口页或结尾页带断点标志
+static inline bool block_has_breakpoint_page(const Block *block) {
+    uint64_t first = block->start_pc - MEMORY_BASE_ADDR;
+    uint64_t last = first + (uint64_t) (block->length - 1) * 4;
+    return ((memory_page_flags[first >> MEMORY_PAGE_SHIFT] | memory_page_flags[last >> MEMORY_PAGE_SHIFT]) &
+            PAGE_FLAG_BREAKPOINT) != 0;
+}
+
+// 块执行到最早的事件截止时间为止：返回这次可以执行的条数，0 表示还有到期事件没处理
+static inline uint32_t block_room(const CPU *cpu, const Block *block) {
+    uint64_t room = event_next_deadline - event_now(cpu);
+    return room < block->length ? (uint32_t) room : block->length;
+}
+
+// 执行基本块的前 length 条，进入计数只在块入口累加一次；返回是否完整执行完
+// 陷入或中断使 pc 偏离顺序执行时提前离开，观察点命中或事件截止时间提前时也在当前指令之后离开，
+// 被截止时间截断时剩下的指令同样算作提前离开
+static inline bool run_block(CPU *cpu, Block *block, uint32_t length) {
+    uint64_t next_pc = block->start_pc;
+    uint32_t executed = length;
+    block_enter(cpu, block);
+    for (uint32_t i = 0; i < length; i++) {
+        if (block->fused[i].kind != FUSE_NONE && i + 1 < length && fusion_allowed(cpu)) {
+            execute_fused(cpu, &block->fused[i], block->insts[i + 1]);
+            i++;
+            next_pc += 8;
+        } else {
+            execute_instruction(cpu, block->insts[i]);
+            next_pc += 4;
+        }
+        if ((cpu->pc != next_pc || block_exit_requested) && i + 1 < length) {
+            executed = i + 1;
+            break;
+        }
+    }
+    block_leave();
+    if (executed < block->length) {
+        block_early_exit(block, executed);
+        return false;
+    }
+    return true;
+}
+
+// 沿超级块依次执行基本块，块之间不回到执行循环。pc 偏离热路径时从侧出口离开；有离开请求、
+// 遇到失效的基本块或到了事件截止时间时也回到执行循环，由它处理事件和停止请求
+static void execute_trace(CPU *cpu, Block *head) {
+    Trace *trace = head->trace;
+    Block *last = NULL;
+    for (uint32_t round = 0; round < TRACE_MAX_ROUNDS; round++) {
+        trace->entries++;
+        for (uint32_t k = 0; k < trace->length; k++) {
+            Block *block = trace->blocks[k];
+            uint32_t length = block_room(cpu, block);
+            if (last != NULL) {
+                if (block_exit_requested || length == 0 || !block->valid) {
+                    block_chain(last);
+                    return;
+                }
+                if (cpu->pc != block->start_pc) {
+                    block_chain(last);
+                    block_trace_side_exit(head);
+                    return;
+                }
+            } else if (length == 0) {
+                return;
+            }
+            block_exit_requested = false;
+            if (!run_block(cpu, block, length)) {
+                return;
+            }
+            last = block;
+        }
+        if (!trace->loops) {
+            break;
+        }
+    }
+    block_chain(last);
+}
+
+// 执行 pc 处的基本块，入口块有超级块时执行超级块。只有完整执行完的基本块才链接到后继，
+// 提前离开时下一个基本块查哈希表。超级块不逐条检查断点，有断点时只按基本块执行
+static inline void execute_block(CPU *cpu) {
+    Block *block = block_next(cpu);
+    if (block->trace != NULL && debug_breakpoint_count == 0) {
+        execute_trace(cpu, block);
+        return;
+    }
+    uint32_t length = block_room(cpu, block);
+    if (length == 0) {
+        // 还有到期事件没处理，回到循环开头先处理事件
+        return;
+    }
+    block_exit_requested = false;
+    if (debug_breakpoint_count != 0 && block->start_pc >= MEMORY_BASE_ADDR && block_has_breakpoint_page(block)) {
+        execute_block_checked(cpu, block, length);
+        return;
+    }
+    if (run_block(cpu, block, length)) {
+        block_chain(block);
+    }
+}
+
+// 在块边界处理断点、观察点或调试器的暂停请求
+static void handle_debug_stop(Simulator *simulator) {
+    if (replay_filter_stop(simulator->cpu)) {
+        // 反向执行途中经过的位置，继续运行
+        return;
+    }
+    if (gdb_connected()) {
+        gdb_handle_stop(simulator->cpu);
+        return;
+    }
+    debug_stop_pending = false;
+    if (simulator->headless) {
+        // 无界面模式下没人能接手，记录命中后继续运行
+        char message[160];
+        debug_format_stop(&debug_stop, message, sizeof(message));
+        fprintf(stderr, "%s\n", message);
+        return;
+    }
+    // 没有连接调试器时回到单步模式，状态栏显示停止原因
+    simulator->cpu->fast_mode = false;
+    notify_display(simulator);
+}
+
 void load_file_to_memory(const char *filename, Memory *memory, size_t address) {
     FILE *file = fopen(filename, "rb");
     if (!file) {
@@ -52,6 +263,12 @@ void load_file_to_memory(const char *filename, Memory *memory, size_t address) {
 
 
 void reset_system(Simulator *simulator) {
+    event_reset();
+    replay_reset();
+    // 先等块设备等后端结束在途请求，再释放它们正在访问的客户机内存
+    virtio_reset_all();
+    framebuffer_reset();
+    gdb_reset();
     clint_init(simulator->cpu->clint);
     plic_init(simulator->cpu->plic);
     uart_init(simulator->cpu->uart); // 初始化 UART
@@ -59,6 +276,7 @@ void reset_system(Simulator *simulator) {
     memory_init(simulator->cpu->memory);
     cpu_init(simulator->cpu, simulator->cpu->memory, simulator->cpu->clint, simulator->cpu->plic, simulator->cpu->uart);
 
+    block_cache_reset();
     load_file_to_memory(simulator->input_file, simulator->cpu->memory, simulator->load_address);
     simulator->cpu->pc = simulator->load_address;
 
@@ -86,32 +304,56 @@ void* cpu_simulator(void *arg) {
 
     while (1) {
         if (cpu->pc < 0x100 || cpu->pc >= MEMORY_END_ADDR) {
-            raise_exception(cpu, CAUSE_LOAD_ACCESS_FAULT);
+            raise_exception_with_tval(cpu, CAUSE_INSTRUCTION_ACCESS_FAULT, cpu->pc);
+        }
+        profile_poll();
+        sampler_poll(cpu);
+        snapshot_poll(cpu);
+        replay_poll(cpu);
+        uart_poll();
+        virtio_poll();
+        event_poll(cpu);
+        if (debug_stop_pending) {
+            // 处理停止时可能回到检查点，重新从循环开头检查
+            handle_debug_stop(simulator);
+            continue;
         }
-        instruction = load_inst(memory, cpu->pc);
 
         if (!cpu->fast_mode) {
             sem_wait(simulator->sem_continue); // Wait for display thread to finish updating
+            instruction = load_inst(memory, cpu->pc);
             ch = keyboard_data->key; // Wait for user input in step mode
+            if (ch == 's' || ch == 'c') {
+                // 继续执行后状态栏不再显示上一次的停止原因
+                debug_stop.reason = DEBUG_STOP_NONE;
+            }
             if (ch == 's') {
-                cpu_execute(cpu, instruction);
-                cpu->csr[CSR_MINSTRET] += 1;
-                sem_post(simulator->sem_refresh); // Notify display thread to refresh
+                execute_instruction(cpu, instruction);
+                notify_display(simulator); // Notify display thread to refresh
             } else if (ch == 'c') {
                 cpu->fast_mode = true;  // Fast mode
-                cpu_execute(cpu, instruction);
-                cpu->csr[CSR_MINSTRET] += 1;
-                sem_post(simulator->sem_refresh);
+                execute_instruction(cpu, instruction);
+                notify_display(simulator);
 
                 start_tsc = rdtsc();
                 gettimeofday(&start, NULL);
+            } else if (ch == 'z' || ch == 'x') {
+                // 反向单步 / 反向继续：回到检查点后全速执行到目标，停下时回到单步模式
+                debug_stop.reason = DEBUG_STOP_NONE;
+                bool resumed = replay_mode != REPLAY_OFF &&
+                               (ch == 'z' ? replay_reverse_step(cpu) : replay_reverse_continue(cpu));
+                if (resumed) {
+                    cpu->fast_mode = true;
+                } else {
+                    notify_display(simulator);
+                }
             } else if (ch == 'r') {
                 cpu->fast_mode = false;
                 reset_system(simulator);
-                sem_post(simulator->sem_refresh);
+                notify_display(simulator);
             } else if (ch == 'b') {
                 cpu->fast_mode = false;
-                sem_post(simulator->sem_refresh);
+                notify_display(simulator);
             } else if (ch == 'q') {
                 exit(0);
             }
@@ -122,24 +364,28 @@ void* cpu_simulator(void *arg) {
                 ch = keyboard_data->key;
                 if (ch == 's') {
                     cpu->fast_mode = false;
-                    sem_post(simulator->sem_refresh);
+                    notify_display(simulator);
                     continue;
                 } else if (ch == 'r') {
                     cpu->fast_mode = false;
                     reset_system(simulator);
-                    sem_post(simulator->sem_refresh);
+                    notify_display(simulator);
                     continue;
                 } else if (ch == 'b') {
                     cpu->fast_mode = false;
-                    sem_post(simulator->sem_refresh);
+                    notify_display(simulator);
                     continue;
                 } else if (ch == 'q') {
                     exit(0);
                 }
             }
             if (cpu->pc == simulator->end_address) {
+                if (simulator->headless) {
+                    // 无界面模式下到达结束地址即正常退出
+                    exit(EXIT_SUCCESS);
+                }
                 cpu->fast_mode = false;
-                sem_post(simulator->sem_refresh);
+                notify_display(simulator);
                 // 获取结束时间
                 gettimeofday(&end, NULL);
 
@@ -154,9 +400,13 @@ void* cpu_simulator(void *arg) {
                 mvprintw(40, 1, "Elapsed CPU cycles: %llu\n", cycles);
 
                 mvprintw(41, 1, " %.6fs\n", elapsed);
+            } else if (gdb_stepping) {
+                // 调试器单步：只执行一条指令，下一轮报告停止
+                gdb_stepping = false;
+                execute_instruction(cpu, load_inst(memory, cpu->pc));
+                debug_request_stop(DEBUG_STOP_STEP, cpu->pc, 0);
             } else {
-                cpu_execute(cpu, instruction);
-                cpu->csr[CSR_MINSTRET] += 1;
+                execute_block(cpu);
             }
         }
     }
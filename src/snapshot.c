@@ -0,0 +1,66 @@
+#include <string.h>
+#include <sched.h>
+#include "snapshot.h"
+
+atomic_int snapshot_requested = 0;
+
+static _Atomic uint32_t snapshot_sequence = 0;
+static StateSnapshot snapshot;
+
+static void fill_snapshot(StateSnapshot *s, CPU *cpu) {
+    s->pc = cpu->pc;
+    memcpy(s->registers, cpu->registers, sizeof(s->registers));
+    s->priv = cpu->priv;
+    s->csr = cpu->csr;
+    s->uart = *cpu->uart;
+    s->uart.LSR = uart_line_status(cpu->uart);
+
+    s->clint.mtime = clint_get_mtime(cpu->clint);
+    s->clint.mtimecmp = cpu->clint->mtimecmp[0];
+    s->clint.msip = cpu->clint->msip[0];
+
+    PLIC *plic = cpu->plic;
+    s->plic.uart_priority = plic->priority[UART0_IRQ];
+    for (int i = 0; i < SNAPSHOT_PLIC_WORDS; i++) {
+        s->plic.pending[i] = plic->pending[i];
+        s->plic.enable[i] = plic->context[0].enable[i];
+    }
+    s->plic.threshold = plic->context[0].threshold;
+    s->plic.claim_complete = plic->context[0].claim_complete;
+
+    s->stack_base = cpu->registers[2] - SNAPSHOT_STACK_WORDS;
+    for (int i = 0; i < SNAPSHOT_STACK_WORDS; i++) {
+        s->stack[i] = load_inst(cpu->memory, s->stack_base + i * 4);
+    }
+    s->source_base = cpu->pc - 4 * (SNAPSHOT_SOURCE_LINES / 2);
+    for (int i = 0; i < SNAPSHOT_SOURCE_LINES; i++) {
+        s->source[i] = load_inst(cpu->memory, s->source_base + i * 4);
+    }
+    s->debug_stop = debug_stop;
+}
+
+void snapshot_publish(CPU *cpu) {
+    uint32_t sequence = atomic_load_explicit(&snapshot_sequence, memory_order_relaxed);
+    atomic_store_explicit(&snapshot_sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    fill_snapshot(&snapshot, cpu);
+    atomic_store_explicit(&snapshot_sequence, sequence + 2, memory_order_release);
+}
+
+bool snapshot_read(StateSnapshot *out) {
+    while (1) {
+        uint32_t before = atomic_load_explicit(&snapshot_sequence, memory_order_acquire);
+        if (before == 0) {
+            return false;
+        }
+        if (before & 1) {
+            sched_yield();
+            continue;
+        }
+        memcpy(out, &snapshot, sizeof(*out));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&snapshot_sequence, memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+#include "cpu.h"
+#include "event.h"
+
+static const char *stats_path = NULL;
+static const char *stats_rom = NULL;
+static struct timespec start_time;
+static uint64_t start_instret = 0;
+
+// 报告里的字符串只需转义引号、反斜杠和控制字符
+static void write_json_string(FILE *file, const char *text) {
+    fputc('"', file);
+    for (const unsigned char *p = (const unsigned char *) text; *p != '\0'; p++) {
+        if (*p == '"' || *p == '\\') {
+            fprintf(file, "\\%c", *p);
+        } else if (*p < 0x20) {
+            fprintf(file, "\\u%04x", *p);
+        } else {
+            fputc(*p, file);
+        }
+    }
+    fputc('"', file);
+}
+
+static void stats_report(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double seconds = (double) (now.tv_sec - start_time.tv_sec) + (now.tv_nsec - start_time.tv_nsec) / 1e9;
+    CPU *cpu = get_cpu();
+    uint64_t instructions = cpu->csr.minstret - start_instret;
+    double mips = seconds > 0 ? (double) instructions / seconds / 1e6 : 0;
+
+    FILE *file = strcmp(stats_path, "-") == 0 ? stderr : fopen(stats_path, "w");
+    if (file == NULL) {
+        perror("Failed to open stats file");
+        return;
+    }
+    fprintf(file, "{\"rom\": ");
+    write_json_string(file, stats_rom);
+    // idle_time: WFI 快进跳过的虚拟时间，不算执行的指令
+    fprintf(file, ", \"wall_seconds\": %.6f, \"instructions\": %lu, \"idle_time\": %lu, \"mips\": %.3f}\n",
+            seconds, instructions, event_idle_time, mips);
+    if (file != stderr) {
+        fclose(file);
+    }
+}
+
+int stats_open(const char *path, const char *rom) {
+    stats_path = path;
+    stats_rom = rom;
+    if (atexit(stats_report) != 0) {
+        fprintf(stderr, "Failed to register stats report\n");
+        return -1;
+    }
+    return 0;
+}
+
+void stats_start(void) {
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    start_instret = get_cpu()->csr.minstret;
+}
@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <elf.h>
+#include "symbols.h"
+
+typedef struct {
+    uint64_t address;
+    char *name;
+} Symbol;
+
+static Symbol *symbols = NULL;
+static int symbol_count = 0;
+
+static int compare_symbols(const void *a, const void *b) {
+    const Symbol *sa = (const Symbol *) a;
+    const Symbol *sb = (const Symbol *) b;
+    return (sa->address > sb->address) - (sa->address < sb->address);
+}
+
+static uint8_t *read_file(const char *path, size_t *size) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *data = length > 0 ? malloc(length) : NULL;
+    if (data != NULL && fread(data, 1, length, file) != (size_t) length) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    *size = (size_t) length;
+    return data;
+}
+
+int symbols_load(const char *path) {
+    size_t size;
+    uint8_t *data = read_file(path, &size);
+    if (data == NULL) {
+        perror("Failed to read symbol file");
+        return -1;
+    }
+    const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *) data;
+    if (size < sizeof(Elf64_Ehdr) || memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 ||
+        ehdr->e_ident[EI_CLASS] != ELFCLASS64 || ehdr->e_machine != EM_RISCV ||
+        ehdr->e_shoff + (uint64_t) ehdr->e_shnum * sizeof(Elf64_Shdr) > size) {
+        fprintf(stderr, "%s is not a RV64 ELF file\n", path);
+        free(data);
+        return -1;
+    }
+
+    const Elf64_Shdr *sections = (const Elf64_Shdr *) (data + ehdr->e_shoff);
+    for (int i = 0; i < ehdr->e_shnum; i++) {
+        if (sections[i].sh_type != SHT_SYMTAB || sections[i].sh_link >= ehdr->e_shnum) {
+            continue;
+        }
+        const Elf64_Shdr *strtab = &sections[sections[i].sh_link];
+        if (sections[i].sh_offset + sections[i].sh_size > size || strtab->sh_offset + strtab->sh_size > size) {
+            continue;
+        }
+        const Elf64_Sym *syms = (const Elf64_Sym *) (data + sections[i].sh_offset);
+        size_t count = sections[i].sh_size / sizeof(Elf64_Sym);
+        const char *names = (const char *) (data + strtab->sh_offset);
+
+        Symbol *table = realloc(symbols, (symbol_count + count) * sizeof(Symbol));
+        if (table == NULL) {
+            break;
+        }
+        symbols = table;
+        for (size_t j = 0; j < count; j++) {
+            const Elf64_Sym *sym = &syms[j];
+            int type = ELF64_ST_TYPE(sym->st_info);
+            if ((type != STT_FUNC && type != STT_NOTYPE) || sym->st_name >= strtab->sh_size ||
+                sym->st_shndx == SHN_UNDEF || sym->st_shndx >= ehdr->e_shnum ||
+                !(sections[sym->st_shndx].sh_flags & SHF_EXECINSTR)) {
+                continue;
+            }
+            const char *name = names + sym->st_name;
+            // 跳过汇编器生成的局部标号和映射符号
+            if (name[0] == '\0' || name[0] == '$' || strncmp(name, ".L", 2) == 0) {
+                continue;
+            }
+            symbols[symbol_count].address = sym->st_value;
+            symbols[symbol_count].name = strdup(name);
+            symbol_count++;
+        }
+    }
+    free(data);
+
+    qsort(symbols, symbol_count, sizeof(Symbol), compare_symbols);
+    return symbol_count;
+}
+
+int symbols_lookup(uint64_t pc) {
+    int low = 0;
+    int high = symbol_count - 1;
+    int found = -1;
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        if (symbols[mid].address <= pc) {
+            found = mid;
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return found;
+}
+
+const char *symbols_name(int index) {
+    return (index >= 0 && index < symbol_count) ? symbols[index].name : NULL;
+}
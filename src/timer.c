@@ -1,11 +0,0 @@
-#include <pthread.h>
-#include <unistd.h>
-#include <stdint.h>
-#include <stdbool.h>
-#include "csr.h"
-#include "clint.h"
-#include "cpu.h"
-
-
-
-
@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "trace.h"
+#include "riscv_defs.h"
+#include "log.h"
+
+#define TRACE_RING_SIZE (16 * 1024 * 1024)  // CPU 线程与写线程之间的字节环形缓冲区 (2 的幂)
+#define TRACE_PUBLISH_BYTES 4096            // 攒够这么多字节才发布一次写指针，减少原子操作
+#define TRACE_MAP_CHUNK (64 * 1024 * 1024)  // 输出文件每次扩展并映射的大小
+#define TRACE_WRITER_IDLE_US 1000
+
+// 正在执行的指令已编码好的前半条记录。测试结束设备等 MMIO 写会在 cpu_execute 里直接 exit，
+// 这时由 trace_close 补完这条记录
+typedef struct {
+    bool active;
+    uint8_t record[TRACE_MAX_RECORD_SIZE];
+    size_t length;
+    uint8_t flags;
+    uint64_t pc;
+    uint32_t opcode;
+    uint32_t rd;
+    bool has_mem;
+    uint64_t mem_addr;
+    uint64_t mem_data;
+    uint32_t mem_size_log2;
+} TracePending;
+
+typedef struct {
+    // CPU 线程独占
+    TraceState state;
+    TracePending pending;
+    uint64_t count;           // 已记录的指令条数
+    uint64_t produced;        // 已写入环形缓冲区的字节数
+    TraceIndexEntry *index;
+    size_t index_count;
+    size_t index_capacity;
+
+    // CPU 线程与写线程共享
+    uint8_t *ring;
+    _Atomic uint64_t tail;    // 已发布的生产位置
+    _Atomic uint64_t head;    // 写线程已消费的位置
+    atomic_bool running;
+
+    // 写线程独占
+    int fd;
+    uint8_t *map;             // 当前映射的文件窗口
+    uint64_t map_offset;      // 窗口对应的文件偏移
+    uint64_t written;         // 已写入文件的记录流字节数
+
+    char *index_path;
+    pthread_t writer;
+} TraceRecorder;
+
+bool trace_enabled = false;
+static TraceRecorder recorder;
+
+// 将文件偏移 offset 所在的块映射进来 (必要时先扩展文件)
+static int map_chunk(TraceRecorder *tr, uint64_t offset) {
+    if (tr->map != NULL) {
+        munmap(tr->map, TRACE_MAP_CHUNK);
+        tr->map = NULL;
+    }
+    uint64_t chunk_offset = offset - offset % TRACE_MAP_CHUNK;
+    if (ftruncate(tr->fd, (off_t) (chunk_offset + TRACE_MAP_CHUNK)) != 0) {
+        return -1;
+    }
+    void *map = mmap(NULL, TRACE_MAP_CHUNK, PROT_READ | PROT_WRITE, MAP_SHARED, tr->fd, (off_t) chunk_offset);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    tr->map = map;
+    tr->map_offset = chunk_offset;
+    return 0;
+}
+
+// 把环形缓冲区中 [head, tail) 的数据复制到映射的文件中
+static uint64_t flush_ring(TraceRecorder *tr) {
+    uint64_t head = atomic_load_explicit(&tr->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&tr->tail, memory_order_acquire);
+    uint64_t total = tail - head;
+
+    while (head != tail) {
+        uint64_t file_offset = TRACE_HEADER_SIZE + tr->written;
+        if (tr->map == NULL || file_offset >= tr->map_offset + TRACE_MAP_CHUNK) {
+            if (map_chunk(tr, file_offset) != 0) {
+                LOG_ERROR(LOG_CAT_CPU, "trace: failed to map output file\n");
+                atomic_store_explicit(&tr->head, tail, memory_order_release);
+                return total;
+            }
+        }
+        uint64_t ring_pos = head & (TRACE_RING_SIZE - 1);
+        uint64_t n = tail - head;
+        uint64_t ring_room = TRACE_RING_SIZE - ring_pos;
+        uint64_t map_room = tr->map_offset + TRACE_MAP_CHUNK - file_offset;
+        if (n > ring_room) n = ring_room;
+        if (n > map_room) n = map_room;
+        memcpy(tr->map + (file_offset - tr->map_offset), tr->ring + ring_pos, n);
+        head += n;
+        tr->written += n;
+        atomic_store_explicit(&tr->head, head, memory_order_release);
+    }
+    return total;
+}
+
+static void *trace_writer(void *arg) {
+    TraceRecorder *tr = (TraceRecorder *) arg;
+    while (atomic_load_explicit(&tr->running, memory_order_acquire)) {
+        if (flush_ring(tr) == 0) {
+            usleep(TRACE_WRITER_IDLE_US);
+        }
+    }
+    flush_ring(tr);
+    return NULL;
+}
+
+static inline void publish(TraceRecorder *tr) {
+    atomic_store_explicit(&tr->tail, tr->produced, memory_order_release);
+}
+
+static void ring_push(TraceRecorder *tr, const uint8_t *data, size_t length) {
+    // 环形缓冲区满时等待写线程，写线程只做内存复制，不会阻塞在磁盘 I/O 上
+    while (tr->produced + length - atomic_load_explicit(&tr->head, memory_order_acquire) > TRACE_RING_SIZE) {
+        publish(tr);
+        sched_yield();
+    }
+    uint64_t pos = tr->produced & (TRACE_RING_SIZE - 1);
+    size_t first = TRACE_RING_SIZE - pos;
+    if (first >= length) {
+        memcpy(tr->ring + pos, data, length);
+    } else {
+        memcpy(tr->ring + pos, data, first);
+        memcpy(tr->ring, data + first, length - first);
+    }
+    tr->produced += length;
+    if (tr->produced - atomic_load_explicit(&tr->tail, memory_order_relaxed) >= TRACE_PUBLISH_BYTES) {
+        publish(tr);
+    }
+}
+
+static void add_index_entry(TraceRecorder *tr) {
+    if (tr->index_count == tr->index_capacity) {
+        size_t capacity = tr->index_capacity ? tr->index_capacity * 2 : 1024;
+        TraceIndexEntry *index = realloc(tr->index, capacity * sizeof(TraceIndexEntry));
+        if (index == NULL) {
+            return;
+        }
+        tr->index = index;
+        tr->index_capacity = capacity;
+    }
+    tr->index[tr->index_count].instret = tr->count;
+    tr->index[tr->index_count].offset = tr->produced;
+    tr->index_count++;
+}
+
+// 指令执行完后补上 rd 和访存数据，把记录送进环形缓冲区
+static void finish_record(TraceRecorder *tr, CPU *cpu) {
+    TracePending *pending = &tr->pending;
+    TraceState *state = &tr->state;
+    uint8_t *record = pending->record;
+    size_t n = pending->length;
+    uint8_t flags = pending->flags;
+    uint32_t rd = pending->rd;
+    if (rd != 0 && cpu->registers[rd] != state->registers[rd]) {
+        flags |= TRACE_FLAG_RD;
+        record[n++] = (uint8_t) rd;
+        n += trace_put_varint(record + n, trace_zigzag((int64_t) (cpu->registers[rd] - state->registers[rd])));
+        state->registers[rd] = cpu->registers[rd];
+    }
+    if (pending->has_mem) {
+        uint64_t mem_data = pending->mem_data;
+        uint32_t mem_size_log2 = pending->mem_size_log2;
+        if (pending->opcode == OPCODE_LOAD) {
+            mem_data = cpu->registers[rd];
+        } else if (mem_size_log2 < 3) {
+            mem_data &= (1ULL << (8 << mem_size_log2)) - 1;
+        }
+        flags |= TRACE_FLAG_MEM | (uint8_t) (mem_size_log2 << TRACE_MEM_SIZE_SHIFT);
+        n += trace_put_varint(record + n, trace_zigzag((int64_t) (pending->mem_addr - state->mem_addr)));
+        n += trace_put_varint(record + n, mem_data);
+        state->mem_addr = pending->mem_addr;
+    }
+    record[0] = flags;
+    state->next_pc = pending->pc + 4;
+    tr->count++;
+    pending->active = false;
+    ring_push(tr, record, n);
+}
+
+int trace_open(const char *path) {
+    TraceRecorder *tr = &recorder;
+    memset(tr, 0, sizeof(*tr));
+    tr->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (tr->fd < 0) {
+        perror("Failed to open trace file");
+        return -1;
+    }
+    TraceHeader header = {0};
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = 1;
+    header.keyframe_interval = TRACE_KEYFRAME_INTERVAL;
+    if (pwrite(tr->fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)) {
+        perror("Failed to write trace header");
+        close(tr->fd);
+        return -1;
+    }
+
+    tr->ring = malloc(TRACE_RING_SIZE);
+    tr->index_path = malloc(strlen(path) + sizeof(TRACE_INDEX_SUFFIX));
+    if (tr->ring == NULL || tr->index_path == NULL) {
+        fprintf(stderr, "Failed to allocate trace buffers\n");
+        close(tr->fd);
+        return -1;
+    }
+    sprintf(tr->index_path, "%s%s", path, TRACE_INDEX_SUFFIX);
+
+    atomic_store(&tr->running, true);
+    if (pthread_create(&tr->writer, NULL, trace_writer, tr) != 0) {
+        close(tr->fd);
+        return -1;
+    }
+    trace_enabled = true;
+    atexit(trace_close);
+    return 0;
+}
+
+void trace_close(void) {
+    TraceRecorder *tr = &recorder;
+    if (!trace_enabled) {
+        return;
+    }
+    trace_enabled = false;
+    // 在 cpu_execute 中退出 (写测试结束设备) 时，最后一条指令的记录还没送出
+    if (tr->pending.active) {
+        finish_record(tr, get_cpu());
+    }
+    publish(tr);
+    atomic_store_explicit(&tr->running, false, memory_order_release);
+    pthread_join(tr->writer, NULL);
+
+    if (tr->map != NULL) {
+        munmap(tr->map, TRACE_MAP_CHUNK);
+        tr->map = NULL;
+    }
+    // 去掉按块扩展时多出来的尾部
+    if (ftruncate(tr->fd, (off_t) (TRACE_HEADER_SIZE + tr->written)) != 0) {
+        perror("Failed to truncate trace file");
+    }
+    close(tr->fd);
+
+    FILE *index_file = fopen(tr->index_path, "wb");
+    if (index_file != NULL) {
+        fwrite(tr->index, sizeof(TraceIndexEntry), tr->index_count, index_file);
+        fclose(index_file);
+    }
+    free(tr->index);
+    free(tr->index_path);
+    free(tr->ring);
+}
+
+void trace_execute(CPU *cpu, uint32_t instruction) {
+    TraceRecorder *tr = &recorder;
+    TraceState *state = &tr->state;
+    TracePending *pending = &tr->pending;
+    uint8_t *record = pending->record;
+    size_t n = 1;
+    uint8_t flags = 0;
+    uint64_t pc = cpu->pc;
+
+    if (tr->count % TRACE_KEYFRAME_INTERVAL == 0) {
+        add_index_entry(tr);
+        flags |= TRACE_FLAG_KEYFRAME;
+        n += trace_put_varint(record + n, pc);
+        for (int i = 0; i < 32; i++) {
+            state->registers[i] = cpu->registers[i];
+            n += trace_put_varint(record + n, cpu->registers[i]);
+        }
+        state->mem_addr = 0;
+    } else if (pc != state->next_pc) {
+        flags |= TRACE_FLAG_JUMP;
+        n += trace_put_varint(record + n, trace_zigzag((int64_t) (pc - state->next_pc)));
+    }
+    memcpy(record + n, &instruction, sizeof(instruction));
+    n += sizeof(instruction);
+
+    // 执行前计算访存地址和写入的数据
+    uint32_t opcode = OPCODE(instruction);
+    uint32_t funct3 = FUNCT3(instruction);
+    uint32_t rd = RD(instruction);
+    pending->has_mem = false;
+    pending->mem_addr = 0;
+    pending->mem_data = 0;
+    pending->mem_size_log2 = 0;
+    switch (opcode) {
+        case OPCODE_LOAD:
+            pending->has_mem = true;
+            pending->mem_addr = cpu->registers[RS1(instruction)] + (int64_t) IMM(instruction);
+            pending->mem_size_log2 = funct3 & 0x3;
+            break;
+        case OPCODE_STORE:
+            pending->has_mem = true;
+            flags |= TRACE_FLAG_STORE;
+            pending->mem_addr = cpu->registers[RS1(instruction)] +
+                                (int64_t) (((int32_t) (instruction & 0xFE000000) >> 20) | (int32_t) rd);
+            pending->mem_size_log2 = funct3 & 0x3;
+            pending->mem_data = cpu->registers[RS2(instruction)];
+            break;
+        case OPCODE_AMO:
+            pending->has_mem = true;
+            flags |= TRACE_FLAG_STORE;
+            pending->mem_addr = cpu->registers[RS1(instruction)];
+            pending->mem_size_log2 = funct3 & 0x3;
+            pending->mem_data = cpu->registers[RS2(instruction)];
+            break;
+        default:
+            break;
+    }
+    pending->length = n;
+    pending->flags = flags;
+    pending->pc = pc;
+    pending->opcode = opcode;
+    pending->rd = rd;
+    pending->active = true;
+
+    cpu_execute(cpu, instruction);
+
+    finish_record(tr, cpu);
+}
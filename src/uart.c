@@ -1,13 +1,367 @@
 #include <stdint.h>
 #include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include "uart.h"
-#include "mfprintf.h"
+#include "cpu.h"
+#include "event.h"
+#include "plic.h"
+#include "log.h"
+#include "console.h"
+#include "replay.h"
+
+// 单生产者 / 单消费者的无锁字节环
+// 发送环：CPU 线程写入，显示线程取出；接收环：键盘线程或输入文件线程写入，CPU 线程在块边界取出放进
+// 客户机可见的接收 FIFO。客户机只在块边界看到新字符，记录/回放模式下送达时刻才能按虚拟时间复现
+typedef struct {
+    uint8_t data[UART_RING_SIZE];
+    _Atomic uint32_t head; // 消费者读位置
+    _Atomic uint32_t tail; // 生产者写位置
+} ByteRing;
 
 static UART global_uart;
+static ByteRing tx_ring;
+static ByteRing rx_ring;
+static bool tx_direct = false;
+static uint64_t tx_dropped = 0;
+bool uart_tx_waiting = false;
+
+// 接收侧状态，只由 CPU 线程访问
+static uint8_t rx_fifo[UART_RING_SIZE]; // 客户机可见的接收 FIFO
+static uint32_t rx_fifo_head = 0;
+static uint32_t rx_fifo_count = 0;
+static uint32_t rx_seen = 0;          // 上次检查时接收环中的字节数
+static uint64_t rx_last_activity = 0; // 最近一次收到或读出字符时的虚拟时间
+static bool rx_timeout = false;       // 字符超时条件成立
+static bool rx_asserted = false;      // 接收中断条件已送给 PLIC
+atomic_int uart_rx_kick = 0;
+
+static void uart_rx_timeout_expired(CPU *cpu, void *opaque);
+static EventTimer rx_timeout_timer = EVENT_TIMER_INIT("uart-rx-timeout", uart_rx_timeout_expired, NULL);
+
+// 多个生产者 (键盘、输入文件) 之间互斥，CPU 线程一侧不加锁
+static pthread_mutex_t rx_producer_lock = PTHREAD_MUTEX_INITIALIZER;
+static int rx_input_fd = -1;
+
 UART* get_uart(void) {
     return &global_uart;
 }
 
+void uart_set_tx_direct(bool direct) {
+    tx_direct = direct;
+}
+
+static inline uint32_t ring_used(ByteRing *ring) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return tail - head;
+}
+
+static inline bool ring_push(ByteRing *ring, uint8_t value) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&ring->head, memory_order_acquire) >= UART_RING_SIZE) {
+        return false;
+    }
+    ring->data[tail & (UART_RING_SIZE - 1)] = value;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+static inline bool ring_pop(ByteRing *ring, uint8_t *value) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (atomic_load_explicit(&ring->tail, memory_order_acquire) == head) {
+        return false;
+    }
+    *value = ring->data[head & (UART_RING_SIZE - 1)];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+// 记录/回放模式下发送环的占用情况取决于显示线程，不能让客户机看到：THRE 总是置位，环满时等待
+static inline bool tx_ring_visible(void) {
+    return !tx_direct && replay_mode == REPLAY_OFF;
+}
+
+static inline bool tx_ring_full(void) {
+    return tx_ring_visible() && ring_used(&tx_ring) >= UART_RING_SIZE;
+}
+
+size_t uart_tx_peek(uint8_t *buffer, size_t max) {
+    uint32_t head = atomic_load_explicit(&tx_ring.head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&tx_ring.tail, memory_order_acquire);
+    size_t count = tail - head;
+    if (count > max) {
+        count = max;
+    }
+    // 环可能回绕，分两段拷贝
+    uint32_t start = head & (UART_RING_SIZE - 1);
+    size_t first = UART_RING_SIZE - start;
+    if (first > count) {
+        first = count;
+    }
+    memcpy(buffer, tx_ring.data + start, first);
+    memcpy(buffer + first, tx_ring.data, count - first);
+    return count;
+}
+
+void uart_tx_consume(size_t count) {
+    uint32_t head = atomic_load_explicit(&tx_ring.head, memory_order_relaxed);
+    atomic_store_explicit(&tx_ring.head, head + (uint32_t) count, memory_order_release);
+}
+
+void uart_tx_flush(void) {
+    // 最多等 1 秒，避免显示线程已停止时卡住退出
+    for (int i = 0; i < 1000 && !tx_direct && ring_used(&tx_ring) != 0; i++) {
+        usleep(1000);
+    }
+}
+
+// THRE 中断：允许且发送环未满时挂起并通过 PLIC 送出；环满时记下，等消费者腾出空间后在块边界补发
+static void uart_update_tx_interrupt(UART *uart) {
+    uart_tx_waiting = false;
+    if ((uart->IER & IER_THR_EMPTY) == 0 || uart->thre_pending) {
+        return;
+    }
+    if (tx_ring_full()) {
+        uart_tx_waiting = true;
+        return;
+    }
+    uart->thre_pending = true;
+    trigger_interrupt(get_cpu(), UART0_IRQ);
+}
+
+// FCR[7:6] 选择的接收触发深度，FIFO 未启用时每个字符都触发
+static uint32_t rx_trigger_level(UART *uart) {
+    static const uint32_t levels[4] = {1, 4, 8, 14};
+    return (uart->FCR & 0x01) ? levels[uart->FCR >> 6] : 1;
+}
+
+// 接收中断：字符数达到触发深度，或低于触发深度但超过 UART_RX_TIMEOUT_INSTRET 条指令
+// 没有收到也没有读出字符 (字符超时)。只在条件从无到有时向 PLIC 送一次，多个字符合并成一次中断
+static void uart_update_rx_interrupt(UART *uart) {
+    uint32_t count = rx_fifo_count;
+    uint64_t now = event_now(get_cpu());
+    if (count > rx_seen) {
+        rx_last_activity = now;
+    }
+    rx_seen = count;
+
+    bool enabled = (uart->IER & IER_RX_AVAILABLE) != 0;
+    bool level = count >= rx_trigger_level(uart);
+    if (count == 0) {
+        rx_timeout = false;
+    } else if (!level && now - rx_last_activity >= UART_RX_TIMEOUT_INSTRET) {
+        rx_timeout = true;
+    }
+    // 字符超时挂在事件队列上，不在每个块边界检查
+    if (enabled && count > 0 && !level && !rx_timeout) {
+        event_timer_mod(&rx_timeout_timer, rx_last_activity + UART_RX_TIMEOUT_INSTRET);
+    } else {
+        event_timer_del(&rx_timeout_timer);
+    }
+
+    bool assert = enabled && (level || rx_timeout);
+    if (assert && !rx_asserted) {
+        trigger_interrupt(get_cpu(), UART0_IRQ);
+    }
+    rx_asserted = assert;
+}
+
+static void uart_rx_timeout_expired(CPU *cpu, void *opaque) {
+    (void) cpu;
+    (void) opaque;
+    uart_update_rx_interrupt(get_uart());
+}
+
+static void rx_fifo_push(const uint8_t *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        rx_fifo[(rx_fifo_head + rx_fifo_count) & (UART_RING_SIZE - 1)] = data[i];
+        rx_fifo_count++;
+    }
+}
+
+// 把生产者写入接收环的字符搬进客户机可见的 FIFO，FIFO 满时剩下的留到下一个块边界
+static size_t uart_rx_transfer(void) {
+    uint8_t buffer[UART_RING_SIZE];
+    size_t count = 0;
+    while (rx_fifo_count + count < UART_RING_SIZE && ring_pop(&rx_ring, &buffer[count])) {
+        count++;
+    }
+    if (ring_used(&rx_ring) != 0) {
+        atomic_store(&uart_rx_kick, 1);
+    }
+    if (count > 0) {
+        rx_fifo_push(buffer, count);
+        replay_record_input(REPLAY_INPUT_UART_RX, buffer, count);
+    }
+    return count;
+}
+
+void uart_service(void) {
+    UART *uart = get_uart();
+    if (replay_mode != REPLAY_OFF && !replay_live) {
+        // 重新执行历史或回放时不接收宿主机输入，标志留到回到前沿时再处理
+        return;
+    }
+    // 先清标志再看环，清除之后到达的字符会重新置位
+    atomic_exchange(&uart_rx_kick, 0);
+    size_t delivered = uart_rx_transfer();
+    // 记录模式下没有送达字符时不改变客户机可见的状态，否则回放时无法在同一时刻复现
+    if (delivered == 0 && replay_mode != REPLAY_OFF) {
+        return;
+    }
+    uart_update_rx_interrupt(uart);
+    uart_update_tx_interrupt(uart);
+}
+
+void uart_rx_inject(const uint8_t *data, size_t length) {
+    UART *uart = get_uart();
+    if (length > UART_RING_SIZE - rx_fifo_count) {
+        length = UART_RING_SIZE - rx_fifo_count;
+    }
+    rx_fifo_push(data, length);
+    uart_update_rx_interrupt(uart);
+    uart_update_tx_interrupt(uart);
+}
+
+void uart_save(UartState *state) {
+    state->regs = global_uart;
+    state->rx_count = rx_fifo_count;
+    for (uint32_t i = 0; i < rx_fifo_count; i++) {
+        state->rx_data[i] = rx_fifo[(rx_fifo_head + i) & (UART_RING_SIZE - 1)];
+    }
+    state->rx_seen = rx_seen;
+    state->rx_last_activity = rx_last_activity;
+    state->rx_timeout = rx_timeout;
+    state->rx_asserted = rx_asserted;
+}
+
+void uart_restore(const UartState *state) {
+    global_uart = state->regs;
+    memcpy(rx_fifo, state->rx_data, state->rx_count);
+    rx_fifo_head = 0;
+    rx_fifo_count = state->rx_count;
+    rx_seen = state->rx_seen;
+    rx_last_activity = state->rx_last_activity;
+    rx_timeout = state->rx_timeout;
+    rx_asserted = state->rx_asserted;
+    uart_tx_waiting = false;
+}
+
+size_t uart_rx_write(const uint8_t *data, size_t length) {
+    if (replay_mode == REPLAY_PLAY) {
+        // 回放时输入全部来自日志
+        return length;
+    }
+    size_t written = 0;
+    pthread_mutex_lock(&rx_producer_lock);
+    while (written < length && ring_push(&rx_ring, data[written])) {
+        written++;
+    }
+    pthread_mutex_unlock(&rx_producer_lock);
+    if (written > 0) {
+        atomic_store(&uart_rx_kick, 1);
+    }
+    return written;
+}
+
+// 输入文件线程：按接收环的空闲空间全速灌入，环满时短暂等待 CPU 线程读取，不丢字符
+static void *uart_input_loop(void *arg) {
+    (void) arg;
+    uint8_t buffer[UART_RING_SIZE];
+    ssize_t length;
+    while ((length = read(rx_input_fd, buffer, sizeof(buffer))) > 0) {
+        size_t done = 0;
+        while (done < (size_t) length) {
+            size_t written = uart_rx_write(buffer + done, length - done);
+            done += written;
+            if (written == 0) {
+                usleep(100);
+            }
+        }
+    }
+    LOG_INFO(LOG_CAT_UART, "UART input reached end of file\n");
+    if (rx_input_fd != STDIN_FILENO) {
+        close(rx_input_fd);
+    }
+    return NULL;
+}
+
+int uart_input_open(const char *path) {
+    if (strcmp(path, "-") == 0) {
+        rx_input_fd = STDIN_FILENO;
+    } else {
+        rx_input_fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (rx_input_fd < 0) {
+            perror("Failed to open UART input");
+            return -1;
+        }
+    }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, uart_input_loop, NULL) != 0) {
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+static void uart_transmit(UART *uart, uint8_t value) {
+    uart->THR = value;
+    if (replay_silent(get_cpu())) {
+        // 反向执行时重新经过的历史已经输出过
+    } else if (tx_direct) {
+        console_putc(value);
+    } else if (!tx_ring_visible()) {
+        while (!ring_push(&tx_ring, value)) {
+            usleep(100);
+        }
+    } else if (!ring_push(&tx_ring, value)) {
+        // 和真实硬件一样，THRE 清零时写入的字符会丢失
+        if (tx_dropped++ == 0) {
+            LOG_WARN(LOG_CAT_UART, "UART TX ring full, dropping output\n");
+        }
+    }
+    uart->thre_pending = false;
+    uart_update_tx_interrupt(uart);
+}
+
+// LSR 的收发位实时计算：接收 FIFO 非空时 DR 置位，发送环未满时 THRE 置位，发送环空时 TEMT 置位
+uint8_t uart_line_status(UART *uart) {
+    uint8_t lsr = uart->LSR & ~(LSR_THRE | LSR_RX_READY);
+    if (rx_fifo_count != 0) {
+        lsr |= LSR_RX_READY;
+    }
+    uint32_t used = tx_ring_visible() ? ring_used(&tx_ring) : 0;
+    if (used < UART_RING_SIZE) {
+        lsr |= LSR_TX_IDLE;
+    }
+    if (used == 0) {
+        lsr |= LSR_TX_EMPTY;
+    }
+    return lsr;
+}
+
+static uint8_t uart_interrupt_id(UART *uart) {
+    uint8_t fifo_bits = (uart->FCR & 0x01) ? IIR_FIFO_ENABLED : 0;
+    if (uart->IER & IER_RX_AVAILABLE) {
+        uint32_t count = rx_fifo_count;
+        if (count >= rx_trigger_level(uart)) {
+            return IIR_RX_AVAILABLE | fifo_bits;
+        }
+        if (rx_timeout && count > 0) {
+            return IIR_RX_TIMEOUT | fifo_bits;
+        }
+    }
+    if (uart->thre_pending) {
+        // 读到 THRE 中断即视为已处理
+        uart->thre_pending = false;
+        return IIR_THR_EMPTY | fifo_bits;
+    }
+    return IIR_NO_INTERRUPT | fifo_bits;
+}
+
 void uart_init(UART *uart) {
     uart->THR = 0;
     uart->RBR = 0;
@@ -21,14 +375,33 @@ void uart_init(UART *uart) {
     uart->SCR = 0;
     uart->DLL = 0;
     uart->DLM = 0;
+    uart->thre_pending = false;
+    uart_tx_waiting = false;
+    rx_fifo_count = 0;
+    rx_seen = 0;
+    rx_timeout = false;
+    rx_asserted = false;
+    event_timer_del(&rx_timeout_timer);
 }
 
 
 void _uart_write(UART *uart, uint16_t port, uint8_t value) {
     switch (port) {
         case 0: uart->THR = value; break;
-        case 1: uart->IER = value; break;
-        case 2: uart->FCR = value; break;
+        case 1:
+            uart->IER = value;
+            uart_update_rx_interrupt(uart);
+            uart_update_tx_interrupt(uart);
+            break;
+        case 2:
+            if (value & 0x02) {
+                // 清空接收 FIFO，还在接收环里没送达的字符不受影响
+                rx_fifo_count = 0;
+                rx_seen = 0;
+            }
+            uart->FCR = value & ~0x06; // 复位位自动清零
+            uart_update_rx_interrupt(uart);
+            break;
         case 3: uart->LCR = value; break;
         case 4: uart->MCR = value; break;
         case 5: uart->LSR = value; break;
@@ -47,7 +420,8 @@ void uart_write(uint64_t address, uint64_t value, uint32_t size) {
         if (uart->LCR & 0x80 && (offset == DLL_REG || offset == DLM_REG)) {
 	    port = 0x8 + offset;
         } else if (offset == THR_REG) {
-            uart->LSR &= ~LSR_THRE; // Clear THR empty bit
+            uart_transmit(uart, (uint8_t) value);
+            return;
     	}
 	_uart_write(uart, port, value);
     }
@@ -56,22 +430,24 @@ void uart_write(uint64_t address, uint64_t value, uint32_t size) {
 uint8_t _uart_read(UART *uart, uint16_t port) {
     switch (port) {
         case 0: // RBR
-            if (uart->fifo_count > 0) {
-                uint8_t data = uart->fifo[uart->fifo_head];
-                uart->fifo_head = (uart->fifo_head + 1) % UART_FIFO_SIZE;
-                uart->fifo_count--;
-                if (uart->fifo_count == 0) {
-                    uart->LSR &= ~LSR_RX_READY; // 清除数据准备好标志
-                }
-                return data;
+            if (rx_fifo_count != 0) {
+                uart->RBR = rx_fifo[rx_fifo_head];
+                rx_fifo_head = (rx_fifo_head + 1) & (UART_RING_SIZE - 1);
+                rx_fifo_count--;
+                // 读出字符重新开始字符超时计时
+                rx_seen--;
+                rx_last_activity = event_now(get_cpu());
+                rx_timeout = false;
+                uart_update_rx_interrupt(uart);
+                return uart->RBR;
             } else {
                 return 0; // FIFO 为空，返回 0
             }
         case 1: return uart->IER;
-        case 2: return uart->IIR;
+        case 2: return uart_interrupt_id(uart);
         case 3: return uart->LCR;
         case 4: return uart->MCR;
-        case 5: return uart->LSR;
+        case 5: return uart_line_status(uart);
         case 6: return uart->MSR;
         case 7: return uart->SCR;
         case 8: return uart->DLL & 0xFF;
@@ -0,0 +1,350 @@
+#include <string.h>
+#include "virtio.h"
+#include "cpu.h"
+#include "block.h"
+#include "log.h"
+
+atomic_int virtio_completion_pending = 0;
+
+static VirtioDevice *devices[VIRTIO_MAX_DEVICES];
+static int device_count = 0;
+
+void virtio_register(VirtioDevice *device) {
+    if (device_count < VIRTIO_MAX_DEVICES) {
+        devices[device_count++] = device;
+    }
+}
+
+uint8_t *virtio_guest_ptr(uint64_t address, uint64_t length) {
+    if (address < MEMORY_BASE_ADDR || address > MEMORY_END_ADDR || length > MEMORY_END_ADDR - address) {
+        return NULL;
+    }
+    return get_cpu()->memory->data + (address - MEMORY_BASE_ADDR);
+}
+
+static inline VirtqDesc *virtq_desc(VirtQueue *queue) {
+    return (VirtqDesc *) virtio_guest_ptr(queue->desc_addr, 0);
+}
+
+// avail 环：flags, idx, ring[num]
+static inline uint16_t *virtq_avail(VirtQueue *queue) {
+    return (uint16_t *) virtio_guest_ptr(queue->avail_addr, 0);
+}
+
+// used 环：flags, idx, {id, len}[num]
+static inline uint16_t *virtq_used(VirtQueue *queue) {
+    return (uint16_t *) virtio_guest_ptr(queue->used_addr, 0);
+}
+
+bool virtq_pop(VirtQueue *queue, uint16_t *head) {
+    if (!queue->ready) {
+        return false;
+    }
+    uint16_t *avail = virtq_avail(queue);
+    uint16_t avail_idx = __atomic_load_n(&avail[1], __ATOMIC_ACQUIRE);
+    if (queue->last_avail == avail_idx) {
+        return false;
+    }
+    *head = avail[2 + queue->last_avail % queue->num];
+    queue->last_avail++;
+    return true;
+}
+
+void virtq_unpop(VirtQueue *queue, uint16_t count) {
+    // 驱动在链被放回 used 环之前不会改动 avail 环里的条目
+    queue->last_avail -= count;
+}
+
+int virtq_map_chain(VirtQueue *queue, uint16_t head, VirtqBuffer *buffers, int max) {
+    VirtqDesc *table = virtq_desc(queue);
+    uint16_t index = head;
+    int count = 0;
+    while (true) {
+        // 链长超过队列大小说明有环
+        if (index >= queue->num || count >= max || count >= (int) queue->num) {
+            return -1;
+        }
+        VirtqDesc *desc = &table[index];
+        uint8_t *data = virtio_guest_ptr(desc->addr, desc->len);
+        if (data == NULL) {
+            return -1;
+        }
+        buffers[count].data = data;
+        buffers[count].len = desc->len;
+        buffers[count].device_writable = (desc->flags & VIRTQ_DESC_F_WRITE) != 0;
+        count++;
+        if (!(desc->flags & VIRTQ_DESC_F_NEXT)) {
+            return count;
+        }
+        index = desc->next;
+    }
+}
+
+// 设备写入的缓冲区可能装着客户机随后要执行的代码 (从磁盘读入的程序)，归还前让重叠的基本块失效
+static void invalidate_written_code(VirtQueue *queue, uint16_t head, uint32_t len) {
+    VirtqDesc *table = virtq_desc(queue);
+    uint16_t index = head;
+    for (uint32_t count = 0; len > 0 && index < queue->num && count < queue->num; count++) {
+        VirtqDesc *desc = &table[index];
+        if ((desc->flags & VIRTQ_DESC_F_WRITE) && virtio_guest_ptr(desc->addr, desc->len) != NULL) {
+            uint32_t written = desc->len < len ? desc->len : len;
+            block_cache_code_write(desc->addr - MEMORY_BASE_ADDR, written);
+            len -= written;
+        }
+        if (!(desc->flags & VIRTQ_DESC_F_NEXT)) {
+            break;
+        }
+        index = desc->next;
+    }
+}
+
+void virtq_push(VirtQueue *queue, uint16_t head, uint32_t len) {
+    invalidate_written_code(queue, head, len);
+    uint16_t *used = virtq_used(queue);
+    uint32_t *element = (uint32_t *) (used + 2) + 2 * (queue->used_idx % queue->num);
+    element[0] = head;
+    element[1] = len;
+    queue->used_idx++;
+    // 先写元素再发布下标
+    __atomic_store_n(&used[1], queue->used_idx, __ATOMIC_RELEASE);
+}
+
+void virtio_raise_interrupt(VirtioDevice *device, uint32_t reason) {
+    device->interrupt_status |= reason;
+    trigger_interrupt(get_cpu(), (int) device->irq);
+}
+
+void virtq_notify_guest(VirtioDevice *device, VirtQueue *queue) {
+    uint16_t *avail = virtq_avail(queue);
+    if (!(avail[0] & VIRTQ_AVAIL_F_NO_INTERRUPT)) {
+        virtio_raise_interrupt(device, VIRTIO_INT_USED_RING);
+    }
+}
+
+void virtq_complete_async(VirtQueue *queue, uint16_t head, uint32_t len) {
+    uint32_t tail = atomic_load_explicit(&queue->completion_tail, memory_order_relaxed);
+    queue->completions[tail % VIRTIO_QUEUE_SIZE].head = head;
+    queue->completions[tail % VIRTIO_QUEUE_SIZE].len = len;
+    atomic_store_explicit(&queue->completion_tail, tail + 1, memory_order_release);
+    atomic_store(&virtio_completion_pending, 1);
+}
+
+// 一个队列的所有完成项写回后只上报一次中断
+static void collect_queue(VirtioDevice *device, VirtQueue *queue) {
+    uint32_t head = atomic_load_explicit(&queue->completion_head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&queue->completion_tail, memory_order_acquire);
+    if (head == tail) {
+        return;
+    }
+    for (; head != tail; head++) {
+        VirtqCompletion *completion = &queue->completions[head % VIRTIO_QUEUE_SIZE];
+        if (queue->ready) {
+            virtq_push(queue, completion->head, completion->len);
+        }
+    }
+    atomic_store_explicit(&queue->completion_head, head, memory_order_release);
+    if (queue->ready) {
+        virtq_notify_guest(device, queue);
+    }
+}
+
+void virtio_collect_completions(void) {
+    // 先清标志再收集，清除之后登记的完成项会重新置位
+    atomic_exchange(&virtio_completion_pending, 0);
+    for (int i = 0; i < device_count; i++) {
+        for (uint32_t q = 0; q < devices[i]->num_queues; q++) {
+            collect_queue(devices[i], &devices[i]->queues[q]);
+        }
+        if (devices[i]->poll != NULL) {
+            devices[i]->poll(devices[i]);
+        }
+    }
+}
+
+static void virtio_device_reset(VirtioDevice *device) {
+    if (device->reset != NULL) {
+        device->reset(device);
+    }
+    device->driver_features = 0;
+    device->device_features_sel = 0;
+    device->driver_features_sel = 0;
+    device->status = 0;
+    device->interrupt_status = 0;
+    device->queue_sel = 0;
+    for (uint32_t i = 0; i < VIRTIO_MAX_QUEUES; i++) {
+        VirtQueue *queue = &device->queues[i];
+        queue->num = 0;
+        queue->ready = false;
+        queue->desc_addr = 0;
+        queue->avail_addr = 0;
+        queue->used_addr = 0;
+        queue->last_avail = 0;
+        queue->used_idx = 0;
+        // 在途请求已由 reset 回调等完，丢弃尚未写回的完成项
+        atomic_store(&queue->completion_head, atomic_load(&queue->completion_tail));
+    }
+}
+
+void virtio_reset_all(void) {
+    for (int i = 0; i < device_count; i++) {
+        virtio_device_reset(devices[i]);
+    }
+}
+
+static inline VirtQueue *selected_queue(VirtioDevice *device) {
+    return device->queue_sel < device->num_queues ? &device->queues[device->queue_sel] : NULL;
+}
+
+static inline void set_low(uint64_t *field, uint64_t value) {
+    *field = (*field & 0xFFFFFFFF00000000ULL) | (uint32_t) value;
+}
+
+static inline void set_high(uint64_t *field, uint64_t value) {
+    *field = (*field & 0xFFFFFFFFULL) | ((uint64_t) (uint32_t) value << 32);
+}
+
+// 打开队列前检查三个环都落在内存中
+static bool queue_valid(VirtQueue *queue) {
+    return queue->num != 0 &&
+           virtio_guest_ptr(queue->desc_addr, (uint64_t) queue->num * sizeof(VirtqDesc)) != NULL &&
+           virtio_guest_ptr(queue->avail_addr, 6 + 2ULL * queue->num) != NULL &&
+           virtio_guest_ptr(queue->used_addr, 6 + 8ULL * queue->num) != NULL &&
+           (queue->desc_addr & 15) == 0 && (queue->avail_addr & 1) == 0 && (queue->used_addr & 3) == 0;
+}
+
+uint64_t virtio_mmio_read(VirtioDevice *device, uint64_t offset, uint32_t size) {
+    if (offset >= VIRTIO_MMIO_CONFIG) {
+        uint64_t config_offset = offset - VIRTIO_MMIO_CONFIG;
+        uint64_t value = 0;
+        if (config_offset + size <= device->config_size) {
+            memcpy(&value, device->config + config_offset, size);
+        }
+        return value;
+    }
+    VirtQueue *queue = selected_queue(device);
+    switch (offset) {
+        case VIRTIO_MMIO_MAGIC_VALUE:
+            return VIRTIO_MMIO_MAGIC;
+        case VIRTIO_MMIO_VERSION:
+            return 2;
+        case VIRTIO_MMIO_DEVICE_ID:
+            return device->device_id;
+        case VIRTIO_MMIO_VENDOR_ID:
+            return VIRTIO_MMIO_VENDOR;
+        case VIRTIO_MMIO_DEVICE_FEATURES:
+            return device->device_features_sel == 0 ? (uint32_t) device->device_features :
+                   device->device_features_sel == 1 ? (uint32_t) (device->device_features >> 32) : 0;
+        case VIRTIO_MMIO_QUEUE_NUM_MAX:
+            return queue != NULL ? VIRTIO_QUEUE_SIZE : 0;
+        case VIRTIO_MMIO_QUEUE_READY:
+            return queue != NULL && queue->ready;
+        case VIRTIO_MMIO_INTERRUPT_STATUS:
+            return device->interrupt_status;
+        case VIRTIO_MMIO_STATUS:
+            return device->status;
+        case VIRTIO_MMIO_CONFIG_GENERATION:
+            return device->config_generation;
+        default:
+            return 0;
+    }
+}
+
+void virtio_mmio_write(VirtioDevice *device, uint64_t offset, uint64_t value, uint32_t size) {
+    if (device->device_id == 0) {
+        return;
+    }
+    if (offset >= VIRTIO_MMIO_CONFIG) {
+        uint64_t config_offset = offset - VIRTIO_MMIO_CONFIG;
+        if (config_offset + size <= device->config_size && device->config_write != NULL) {
+            memcpy(device->config + config_offset, &value, size);
+            device->config_write(device, (uint32_t) config_offset, size);
+        }
+        return;
+    }
+    VirtQueue *queue = selected_queue(device);
+    switch (offset) {
+        case VIRTIO_MMIO_DEVICE_FEATURES_SEL:
+            device->device_features_sel = (uint32_t) value;
+            break;
+        case VIRTIO_MMIO_DRIVER_FEATURES:
+            // 驱动只能确认设备提供的特性
+            if (device->driver_features_sel == 0) {
+                set_low(&device->driver_features, value & device->device_features);
+            } else if (device->driver_features_sel == 1) {
+                set_high(&device->driver_features, value & (device->device_features >> 32));
+            }
+            break;
+        case VIRTIO_MMIO_DRIVER_FEATURES_SEL:
+            device->driver_features_sel = (uint32_t) value;
+            break;
+        case VIRTIO_MMIO_QUEUE_SEL:
+            device->queue_sel = (uint32_t) value;
+            break;
+        case VIRTIO_MMIO_QUEUE_NUM:
+            // 队列大小必须是 2 的幂，used/avail 下标取模才与 16 位回绕一致
+            if (queue != NULL && !queue->ready && value <= VIRTIO_QUEUE_SIZE && (value & (value - 1)) == 0) {
+                queue->num = (uint32_t) value;
+            }
+            break;
+        case VIRTIO_MMIO_QUEUE_READY:
+            if (queue == NULL) {
+                break;
+            }
+            if (value == 1 && !queue_valid(queue)) {
+                LOG_WARN(LOG_CAT_MEMORY, "%s: queue %u has invalid rings\n", device->name, device->queue_sel);
+                device->status |= VIRTIO_STATUS_NEEDS_RESET;
+                break;
+            }
+            queue->ready = value == 1;
+            break;
+        case VIRTIO_MMIO_QUEUE_NOTIFY:
+            if (value < device->num_queues && device->queues[value].ready &&
+                (device->status & VIRTIO_STATUS_DRIVER_OK) && device->notify != NULL) {
+                device->notify(device, (uint32_t) value);
+            }
+            break;
+        case VIRTIO_MMIO_INTERRUPT_ACK:
+            device->interrupt_status &= ~(uint32_t) value;
+            break;
+        case VIRTIO_MMIO_STATUS:
+            if (value == 0) {
+                virtio_device_reset(device);
+            } else {
+                if ((value & VIRTIO_STATUS_FEATURES_OK) && !(device->driver_features & (1ULL << VIRTIO_F_VERSION_1))) {
+                    // 只支持现代设备，驱动没有确认 VERSION_1 时拒绝 FEATURES_OK
+                    value &= ~VIRTIO_STATUS_FEATURES_OK;
+                }
+                bool driver_ok = (value & VIRTIO_STATUS_DRIVER_OK) && !(device->status & VIRTIO_STATUS_DRIVER_OK);
+                device->status = (uint32_t) value;
+                if (driver_ok && device->notify != NULL) {
+                    // 驱动可能在 DRIVER_OK 之前就放好了缓冲区并通知过，那时的通知被忽略了，这里补一次
+                    for (uint32_t i = 0; i < device->num_queues; i++) {
+                        if (device->queues[i].ready) {
+                            device->notify(device, i);
+                        }
+                    }
+                }
+            }
+            break;
+        case VIRTIO_MMIO_QUEUE_DESC_LOW:
+            if (queue != NULL && !queue->ready) set_low(&queue->desc_addr, value);
+            break;
+        case VIRTIO_MMIO_QUEUE_DESC_HIGH:
+            if (queue != NULL && !queue->ready) set_high(&queue->desc_addr, value);
+            break;
+        case VIRTIO_MMIO_QUEUE_DRIVER_LOW:
+            if (queue != NULL && !queue->ready) set_low(&queue->avail_addr, value);
+            break;
+        case VIRTIO_MMIO_QUEUE_DRIVER_HIGH:
+            if (queue != NULL && !queue->ready) set_high(&queue->avail_addr, value);
+            break;
+        case VIRTIO_MMIO_QUEUE_DEVICE_LOW:
+            if (queue != NULL && !queue->ready) set_low(&queue->used_addr, value);
+            break;
+        case VIRTIO_MMIO_QUEUE_DEVICE_HIGH:
+            if (queue != NULL && !queue->ready) set_high(&queue->used_addr, value);
+            break;
+        default:
+            break;
+    }
+}
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "virtio_blk.h"
+#include "virtio.h"
+#include "log.h"
+
+typedef struct __attribute__((packed)) {
+    uint64_t capacity;   // 以 512 字节扇区计
+    uint32_t size_max;
+    uint32_t seg_max;
+    uint16_t cylinders;
+    uint8_t heads;
+    uint8_t sectors;
+    uint32_t blk_size;
+    uint8_t physical_block_exp;
+    uint8_t alignment_offset;
+    uint16_t min_io_size;
+    uint32_t opt_io_size;
+    uint8_t writeback;
+    uint8_t unused0;
+    uint16_t num_queues;
+} VirtioBlkConfig;
+
+// CPU 线程解析好的请求，segments 不含请求头和状态字节
+typedef struct {
+    uint16_t head;
+    uint32_t type;
+    uint64_t sector;
+    int count;
+    VirtqBuffer segments[VIRTIO_MAX_SEGMENTS];
+    uint8_t *status;
+} BlkRequest;
+
+// 每个队列一个后台线程：CPU 线程在 tail 放入请求，后台线程处理完写回完成项后再推进 head
+typedef struct {
+    VirtQueue *queue;
+    BlkRequest requests[VIRTIO_QUEUE_SIZE];
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+    sem_t available;
+} BlkWorker;
+
+static VirtioBlkConfig blk_config;
+static VirtioDevice blk_device = {
+        .name = "virtio-blk",
+        .irq = VIRTIO_BLK_IRQ,
+        .config = (uint8_t *) &blk_config,
+        .config_size = sizeof(VirtioBlkConfig),
+};
+static BlkWorker workers[VIRTIO_BLK_NUM_QUEUES];
+static uint8_t *image = NULL;
+static uint64_t image_size = 0;
+static bool image_readonly = false;
+
+static const char blk_id[VIRTIO_BLK_ID_BYTES] = "riscv-sim-disk";
+
+static uint8_t blk_execute(BlkRequest *request, uint32_t *written) {
+    *written = 0;
+    switch (request->type) {
+        case VIRTIO_BLK_T_IN:
+        case VIRTIO_BLK_T_OUT: {
+            if (request->type == VIRTIO_BLK_T_OUT && image_readonly) {
+                return VIRTIO_BLK_S_IOERR;
+            }
+            // 扇区号来自客户机，先检查范围再换算成字节偏移，避免乘法溢出绕回镜像开头
+            if (request->sector >= blk_config.capacity) {
+                return VIRTIO_BLK_S_IOERR;
+            }
+            uint64_t offset = request->sector * VIRTIO_BLK_SECTOR_SIZE;
+            for (int i = 0; i < request->count; i++) {
+                VirtqBuffer *segment = &request->segments[i];
+                if (segment->len > image_size - offset) {
+                    return VIRTIO_BLK_S_IOERR;
+                }
+                // 读请求只能写入驱动标记为设备可写的缓冲区
+                if (request->type == VIRTIO_BLK_T_IN && !segment->device_writable) {
+                    return VIRTIO_BLK_S_IOERR;
+                }
+                // 直接在镜像映射和客户机内存之间拷贝
+                if (request->type == VIRTIO_BLK_T_IN) {
+                    memcpy(segment->data, image + offset, segment->len);
+                    *written += segment->len;
+                } else {
+                    memcpy(image + offset, segment->data, segment->len);
+                }
+                offset += segment->len;
+            }
+            return VIRTIO_BLK_S_OK;
+        }
+        case VIRTIO_BLK_T_FLUSH:
+            return msync(image, image_size, MS_SYNC) == 0 ? VIRTIO_BLK_S_OK : VIRTIO_BLK_S_IOERR;
+        case VIRTIO_BLK_T_GET_ID:
+            if (request->count > 0 && request->segments[0].device_writable) {
+                uint32_t length = request->segments[0].len < VIRTIO_BLK_ID_BYTES ?
+                                  request->segments[0].len : VIRTIO_BLK_ID_BYTES;
+                memcpy(request->segments[0].data, blk_id, length);
+                *written = length;
+            }
+            return VIRTIO_BLK_S_OK;
+        default:
+            return VIRTIO_BLK_S_UNSUPP;
+    }
+}
+
+static void *blk_worker_loop(void *arg) {
+    BlkWorker *worker = (BlkWorker *) arg;
+    while (true) {
+        sem_wait(&worker->available);
+        uint32_t head = atomic_load_explicit(&worker->head, memory_order_relaxed);
+        BlkRequest *request = &worker->requests[head % VIRTIO_QUEUE_SIZE];
+        uint32_t written;
+        *request->status = blk_execute(request, &written);
+        virtq_complete_async(worker->queue, request->head, written + 1);
+        atomic_store_explicit(&worker->head, head + 1, memory_order_release);
+    }
+    return NULL;
+}
+
+// 解析描述符链：第一段是 16 字节请求头，最后一段是设备可写的状态字节
+static bool blk_parse(VirtQueue *queue, uint16_t head, BlkRequest *request) {
+    VirtqBuffer buffers[VIRTIO_MAX_SEGMENTS];
+    int count = virtq_map_chain(queue, head, buffers, VIRTIO_MAX_SEGMENTS);
+    if (count < 2 || buffers[0].len < 16 || buffers[0].device_writable ||
+        !buffers[count - 1].device_writable || buffers[count - 1].len < 1) {
+        return false;
+    }
+    memcpy(&request->type, buffers[0].data, sizeof(uint32_t));
+    memcpy(&request->sector, buffers[0].data + 8, sizeof(uint64_t));
+    request->head = head;
+    request->count = count - 2;
+    memcpy(request->segments, buffers + 1, request->count * sizeof(VirtqBuffer));
+    request->status = buffers[count - 1].data + buffers[count - 1].len - 1;
+    return true;
+}
+
+// 驱动写 QueueNotify：取出所有新请求交给该队列的后台线程，CPU 线程不做数据拷贝
+static void blk_notify(VirtioDevice *device, uint32_t index) {
+    VirtQueue *queue = &device->queues[index];
+    BlkWorker *worker = &workers[index];
+    uint16_t head;
+    bool rejected = false;
+    while (virtq_pop(queue, &head)) {
+        uint32_t tail = atomic_load_explicit(&worker->tail, memory_order_relaxed);
+        BlkRequest *request = &worker->requests[tail % VIRTIO_QUEUE_SIZE];
+        if (!blk_parse(queue, head, request)) {
+            LOG_WARN(LOG_CAT_MEMORY, "virtio-blk: malformed request on queue %u\n", index);
+            virtq_push(queue, head, 0);
+            rejected = true;
+            continue;
+        }
+        atomic_store_explicit(&worker->tail, tail + 1, memory_order_release);
+        sem_post(&worker->available);
+    }
+    if (rejected) {
+        virtq_notify_guest(device, queue);
+    }
+}
+
+// 复位前等后台线程处理完所有在途请求
+static void blk_reset(VirtioDevice *device) {
+    for (uint32_t i = 0; i < device->num_queues; i++) {
+        BlkWorker *worker = &workers[i];
+        while (atomic_load_explicit(&worker->head, memory_order_acquire) !=
+               atomic_load_explicit(&worker->tail, memory_order_relaxed)) {
+            usleep(100);
+        }
+    }
+}
+
+uint64_t virtio_blk_read(uint64_t address, uint32_t size) {
+    return virtio_mmio_read(&blk_device, address - VIRTIO_BLK_BASE_ADDR, size);
+}
+
+void virtio_blk_write(uint64_t address, uint64_t value, uint32_t size) {
+    virtio_mmio_write(&blk_device, address - VIRTIO_BLK_BASE_ADDR, value, size);
+}
+
+int virtio_blk_open(const char *path) {
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        image_readonly = true;
+    }
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < VIRTIO_BLK_SECTOR_SIZE) {
+        perror("Failed to open disk image");
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    // 不足一个扇区的尾部不可见
+    image_size = (uint64_t) st.st_size / VIRTIO_BLK_SECTOR_SIZE * VIRTIO_BLK_SECTOR_SIZE;
+    image = mmap(NULL, image_size, image_readonly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        perror("Failed to map disk image");
+        image = NULL;
+        return -1;
+    }
+
+    blk_config.capacity = image_size / VIRTIO_BLK_SECTOR_SIZE;
+    blk_config.seg_max = VIRTIO_MAX_SEGMENTS - 2;
+    blk_config.blk_size = VIRTIO_BLK_SECTOR_SIZE;
+    blk_config.num_queues = VIRTIO_BLK_NUM_QUEUES;
+
+    blk_device.device_id = VIRTIO_ID_BLOCK;
+    blk_device.num_queues = VIRTIO_BLK_NUM_QUEUES;
+    blk_device.device_features = (1ULL << VIRTIO_F_VERSION_1) | (1ULL << VIRTIO_BLK_F_SEG_MAX) |
+                                 (1ULL << VIRTIO_BLK_F_BLK_SIZE) | (1ULL << VIRTIO_BLK_F_FLUSH) |
+                                 (1ULL << VIRTIO_BLK_F_MQ) | (image_readonly ? 1ULL << VIRTIO_BLK_F_RO : 0);
+    blk_device.notify = blk_notify;
+    blk_device.reset = blk_reset;
+
+    for (int i = 0; i < VIRTIO_BLK_NUM_QUEUES; i++) {
+        workers[i].queue = &blk_device.queues[i];
+        sem_init(&workers[i].available, 0, 0);
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, blk_worker_loop, &workers[i]) != 0) {
+            return -1;
+        }
+        pthread_detach(thread);
+    }
+    virtio_register(&blk_device);
+    LOG_INFO(LOG_CAT_MEMORY, "virtio-blk: %s, %lu sectors%s\n", path, blk_config.capacity,
+             image_readonly ? " (read-only)" : "");
+    return 0;
+}
@@ -0,0 +1,463 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "virtio_console.h"
+#include "virtio.h"
+#include "log.h"
+
+#define CONSOLE_NAME_MAX 64
+#define CONSOLE_IOV_MAX 1024     // 一次 writev 最多的段数
+#define CONSOLE_RX_BATCH 32
+#define CONTROL_PENDING_MAX 32
+
+typedef struct __attribute__((packed)) {
+    uint16_t cols;
+    uint16_t rows;
+    uint32_t max_nr_ports;
+    uint32_t emerg_wr;
+} VirtioConsoleConfig;
+
+typedef struct __attribute__((packed)) {
+    uint32_t id;
+    uint16_t event;
+    uint16_t value;
+} ConsoleControl;
+
+// 接收等待和 virtio-net 一样：后台线程 poll 到可读后置位 rx_ready 并停下，CPU 线程读空输入后再放它继续等
+typedef struct {
+    char name[CONSOLE_NAME_MAX];
+    int out_fd;
+    int in_fd;               // -1 表示没有输入
+    sem_t rx_wake;
+    atomic_int rx_ready;
+    bool rx_polling;
+    bool rx_starved;
+    bool write_failed;
+} ConsolePort;
+
+// 等待发给驱动的控制消息，控制接收队列没有缓冲区时暂存
+typedef struct {
+    ConsoleControl control;
+    char name[CONSOLE_NAME_MAX];
+    uint32_t name_len;
+} PendingControl;
+
+static VirtioConsoleConfig console_config;
+static VirtioDevice console_device = {
+        .name = "virtio-console",
+        .irq = VIRTIO_CONSOLE_IRQ,
+        .config = (uint8_t *) &console_config,
+        .config_size = sizeof(VirtioConsoleConfig),
+};
+static ConsolePort ports[VIRTIO_CONSOLE_MAX_PORTS];
+static uint32_t port_count = 0;
+static PendingControl pending[CONTROL_PENDING_MAX];
+static uint32_t pending_count = 0;
+
+static struct iovec tx_iov[CONSOLE_IOV_MAX];
+
+// 多端口布局：端口 0 用队列 0/1，控制消息用 2/3，端口 n 用 2n+2/2n+3
+#define CONTROL_RX_QUEUE 2
+#define CONTROL_TX_QUEUE 3
+
+static inline uint32_t port_rx_queue(uint32_t port) {
+    return port == 0 ? 0 : 2 * port + 2;
+}
+
+static inline bool queue_to_port(uint32_t queue, uint32_t *port, bool *transmit) {
+    if (queue == CONTROL_RX_QUEUE || queue == CONTROL_TX_QUEUE) {
+        return false;
+    }
+    *port = queue < 2 ? 0 : queue / 2 - 1;
+    *transmit = queue & 1;
+    return *port < port_count;
+}
+
+static void *console_rx_loop(void *arg) {
+    ConsolePort *port = (ConsolePort *) arg;
+    struct pollfd pfd = {.fd = port->in_fd, .events = POLLIN};
+    while (true) {
+        sem_wait(&port->rx_wake);
+        while (poll(&pfd, 1, -1) < 0 && errno == EINTR) {
+        }
+        atomic_store(&port->rx_ready, 1);
+        atomic_store(&virtio_completion_pending, 1);
+    }
+    return NULL;
+}
+
+static void rx_rearm(ConsolePort *port) {
+    if (!port->rx_polling && port->in_fd >= 0) {
+        port->rx_polling = true;
+        sem_post(&port->rx_wake);
+    }
+}
+
+static void send_control(uint32_t id, uint16_t event, uint16_t value, const char *name);
+
+// 把控制消息写进驱动提供的控制接收缓冲区，没有缓冲区的留到驱动下次补充
+static void flush_control(void) {
+    VirtQueue *queue = &console_device.queues[CONTROL_RX_QUEUE];
+    uint32_t sent = 0;
+    uint16_t head;
+    while (sent < pending_count && virtq_pop(queue, &head)) {
+        PendingControl *message = &pending[sent];
+        VirtqBuffer buffers[VIRTIO_MAX_SEGMENTS];
+        int count = virtq_map_chain(queue, head, buffers, VIRTIO_MAX_SEGMENTS);
+        uint32_t length = sizeof(ConsoleControl) + message->name_len;
+        if (count < 1 || !buffers[0].device_writable || buffers[0].len < length) {
+            LOG_WARN(LOG_CAT_MEMORY, "virtio-console: control buffer too small\n");
+            virtq_push(queue, head, 0);
+            continue;
+        }
+        memcpy(buffers[0].data, &message->control, sizeof(ConsoleControl));
+        memcpy(buffers[0].data + sizeof(ConsoleControl), message->name, message->name_len);
+        virtq_push(queue, head, length);
+        sent++;
+    }
+    if (sent > 0) {
+        memmove(pending, pending + sent, (pending_count - sent) * sizeof(PendingControl));
+        pending_count -= sent;
+        virtq_notify_guest(&console_device, queue);
+    }
+}
+
+static void send_control(uint32_t id, uint16_t event, uint16_t value, const char *name) {
+    if (pending_count >= CONTROL_PENDING_MAX) {
+        LOG_WARN(LOG_CAT_MEMORY, "virtio-console: control queue overflow\n");
+        return;
+    }
+    PendingControl *message = &pending[pending_count++];
+    message->control.id = id;
+    message->control.event = event;
+    message->control.value = value;
+    message->name_len = name != NULL ? (uint32_t) strlen(name) : 0;
+    if (message->name_len > 0) {
+        memcpy(message->name, name, message->name_len);
+    }
+    flush_control();
+}
+
+static void handle_control(ConsoleControl *control) {
+    switch (control->event) {
+        case VIRTIO_CONSOLE_DEVICE_READY:
+            if (control->value == 1) {
+                for (uint32_t i = 0; i < port_count; i++) {
+                    send_control(i, VIRTIO_CONSOLE_DEVICE_ADD, 0, NULL);
+                }
+            }
+            break;
+        case VIRTIO_CONSOLE_PORT_READY:
+            if (control->value != 1 || control->id >= port_count) {
+                break;
+            }
+            if (control->id == 0) {
+                send_control(0, VIRTIO_CONSOLE_CONSOLE_PORT, 1, NULL);
+            } else if (ports[control->id].name[0] != '\0') {
+                send_control(control->id, VIRTIO_CONSOLE_PORT_NAME, 1, ports[control->id].name);
+            }
+            // 宿主机一侧始终是打开的
+            send_control(control->id, VIRTIO_CONSOLE_PORT_OPEN, 1, NULL);
+            break;
+        default:
+            // PORT_OPEN 等通知不影响宿主机一侧
+            break;
+    }
+}
+
+static void control_transmit(VirtQueue *queue) {
+    uint16_t head;
+    bool pushed = false;
+    while (virtq_pop(queue, &head)) {
+        VirtqBuffer buffers[VIRTIO_MAX_SEGMENTS];
+        int count = virtq_map_chain(queue, head, buffers, VIRTIO_MAX_SEGMENTS);
+        if (count >= 1 && buffers[0].len >= sizeof(ConsoleControl)) {
+            ConsoleControl control;
+            memcpy(&control, buffers[0].data, sizeof(control));
+            handle_control(&control);
+        }
+        virtq_push(queue, head, 0);
+        pushed = true;
+    }
+    if (pushed) {
+        virtq_notify_guest(&console_device, queue);
+    }
+}
+
+static void write_all(ConsolePort *port, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(port->out_fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (!port->write_failed) {
+                port->write_failed = true;
+                LOG_WARN(LOG_CAT_MEMORY, "virtio-console: port %ld write failed: %s\n",
+                         (long) (port - ports), strerror(errno));
+            }
+            return;
+        }
+        // 部分写入时跳过已写完的段
+        while (count > 0 && (size_t) written >= iov->iov_len) {
+            written -= (ssize_t) iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8_t *) iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+// 一次通知里的所有缓冲区合并成尽量少的 writev
+static void port_transmit(ConsolePort *port, VirtQueue *queue) {
+    uint16_t heads[CONSOLE_IOV_MAX];
+    int chains = 0;
+    int iov_count = 0;
+    bool pushed = false;
+    while (true) {
+        uint16_t head;
+        bool more = iov_count + VIRTIO_MAX_SEGMENTS <= CONSOLE_IOV_MAX && chains < CONSOLE_IOV_MAX && virtq_pop(queue, &head);
+        if (more) {
+            VirtqBuffer buffers[VIRTIO_MAX_SEGMENTS];
+            int count = virtq_map_chain(queue, head, buffers, VIRTIO_MAX_SEGMENTS);
+            for (int i = 0; i < count; i++) {
+                if (!buffers[i].device_writable && buffers[i].len > 0) {
+                    tx_iov[iov_count].iov_base = buffers[i].data;
+                    tx_iov[iov_count].iov_len = buffers[i].len;
+                    iov_count++;
+                }
+            }
+            heads[chains++] = head;
+            continue;
+        }
+        if (chains == 0) {
+            break;
+        }
+        write_all(port, tx_iov, iov_count);
+        for (int i = 0; i < chains; i++) {
+            virtq_push(queue, heads[i], 0);
+        }
+        pushed = true;
+        chains = 0;
+        iov_count = 0;
+    }
+    if (pushed) {
+        virtq_notify_guest(&console_device, queue);
+    }
+}
+
+static void port_receive(ConsolePort *port, VirtQueue *queue) {
+    if (!(console_device.status & VIRTIO_STATUS_DRIVER_OK)) {
+        // 驱动就绪前输入留在宿主机一侧，等驱动补充接收缓冲区时再读
+        port->rx_starved = true;
+        return;
+    }
+    bool pushed = false;
+    for (int i = 0; i < CONSOLE_RX_BATCH; i++) {
+        uint16_t head;
+        if (!virtq_pop(queue, &head)) {
+            port->rx_starved = true;
+            break;
+        }
+        VirtqBuffer buffers[VIRTIO_MAX_SEGMENTS];
+        struct iovec iov[VIRTIO_MAX_SEGMENTS];
+        int count = virtq_map_chain(queue, head, buffers, VIRTIO_MAX_SEGMENTS);
+        int iov_count = 0;
+        for (int j = 0; j < count; j++) {
+            if (buffers[j].device_writable) {
+                iov[iov_count].iov_base = buffers[j].data;
+                iov[iov_count].iov_len = buffers[j].len;
+                iov_count++;
+            }
+        }
+        if (iov_count == 0) {
+            LOG_WARN(LOG_CAT_MEMORY, "virtio-console: rx buffer has no writable segment\n");
+            virtq_push(queue, head, 0);
+            pushed = true;
+            continue;
+        }
+        ssize_t length = readv(port->in_fd, iov, iov_count);
+        if (length > 0) {
+            virtq_push(queue, head, (uint32_t) length);
+            pushed = true;
+            continue;
+        }
+        virtq_unpop(queue, 1);
+        if (length < 0 && (errno == EAGAIN || errno == EINTR)) {
+            rx_rearm(port);
+        } else {
+            // 输入到达结尾或出错，不再读取
+            close(port->in_fd);
+            port->in_fd = -1;
+        }
+        break;
+    }
+    if (pushed) {
+        virtq_notify_guest(&console_device, queue);
+    }
+    if (port->in_fd >= 0 && !port->rx_polling && !port->rx_starved) {
+        // 一批没读完，下一个块边界继续
+        atomic_store(&port->rx_ready, 1);
+        atomic_store(&virtio_completion_pending, 1);
+    }
+}
+
+static void console_notify(VirtioDevice *device, uint32_t index) {
+    if (index == CONTROL_TX_QUEUE) {
+        control_transmit(&device->queues[index]);
+        return;
+    }
+    if (index == CONTROL_RX_QUEUE) {
+        flush_control();
+        return;
+    }
+    uint32_t number;
+    bool transmit;
+    if (!queue_to_port(index, &number, &transmit)) {
+        return;
+    }
+    ConsolePort *port = &ports[number];
+    if (transmit) {
+        port_transmit(port, &device->queues[index]);
+    } else if (port->rx_starved && port->in_fd >= 0) {
+        port->rx_starved = false;
+        port_receive(port, &device->queues[index]);
+    }
+}
+
+static void console_poll(VirtioDevice *device) {
+    for (uint32_t i = 0; i < port_count; i++) {
+        ConsolePort *port = &ports[i];
+        if (atomic_exchange(&port->rx_ready, 0)) {
+            port->rx_polling = false;
+            port->rx_starved = false;
+            port_receive(port, &device->queues[port_rx_queue(i)]);
+        }
+    }
+}
+
+static void console_config_write(VirtioDevice *device, uint32_t offset, uint32_t size) {
+    (void) device;
+    // 紧急写：驱动还没起来时直接写一个字符到端口 0
+    if (offset == offsetof(VirtioConsoleConfig, emerg_wr) && size >= 1) {
+        uint8_t value = (uint8_t) console_config.emerg_wr;
+        struct iovec iov = {.iov_base = &value, .iov_len = 1};
+        write_all(&ports[0], &iov, 1);
+    }
+}
+
+static void console_reset(VirtioDevice *device) {
+    (void) device;
+    pending_count = 0;
+    for (uint32_t i = 0; i < port_count; i++) {
+        if (ports[i].rx_starved) {
+            ports[i].rx_starved = false;
+            rx_rearm(&ports[i]);
+        }
+    }
+}
+
+uint64_t virtio_console_read(uint64_t address, uint32_t size) {
+    return virtio_mmio_read(&console_device, address - VIRTIO_CONSOLE_BASE_ADDR, size);
+}
+
+void virtio_console_write(uint64_t address, uint64_t value, uint32_t size) {
+    virtio_mmio_write(&console_device, address - VIRTIO_CONSOLE_BASE_ADDR, value, size);
+}
+
+static int open_output(const char *path) {
+    if (strcmp(path, "-") == 0) {
+        return STDOUT_FILENO;
+    }
+    struct stat st;
+    if (stat(path, &st) == 0 && (S_ISFIFO(st.st_mode) || S_ISCHR(st.st_mode) || S_ISSOCK(st.st_mode))) {
+        // 管道用 O_RDWR 打开，读端还没打开时不会阻塞
+        return open(path, O_RDWR | O_CLOEXEC);
+    }
+    return open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+}
+
+static int open_port(ConsolePort *port, char *item) {
+    char *equals = strchr(item, '=');
+    if (equals != NULL) {
+        *equals = '\0';
+        snprintf(port->name, sizeof(port->name), "%s", item);
+        item = equals + 1;
+    }
+    char *input = strchr(item, ':');
+    if (input != NULL) {
+        *input++ = '\0';
+    }
+    port->out_fd = open_output(item);
+    if (port->out_fd < 0) {
+        perror("Failed to open virtio console output");
+        return -1;
+    }
+    port->in_fd = -1;
+    if (input == NULL || *input == '\0') {
+        return 0;
+    }
+    port->in_fd = strcmp(input, "-") == 0 ? dup(STDIN_FILENO) : open(input, O_RDONLY | O_CLOEXEC);
+    if (port->in_fd < 0 || fcntl(port->in_fd, F_SETFL, fcntl(port->in_fd, F_GETFL) | O_NONBLOCK) != 0) {
+        perror("Failed to open virtio console input");
+        return -1;
+    }
+    sem_init(&port->rx_wake, 0, 1);
+    port->rx_polling = true;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, console_rx_loop, port) != 0) {
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+int virtio_console_open(const char *spec) {
+    char *list = strdup(spec);
+    char *save = NULL;
+    for (char *item = strtok_r(list, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save)) {
+        if (port_count >= VIRTIO_CONSOLE_MAX_PORTS) {
+            fprintf(stderr, "Too many virtio console ports (max %d)\n", VIRTIO_CONSOLE_MAX_PORTS);
+            free(list);
+            return -1;
+        }
+        if (open_port(&ports[port_count], item) != 0) {
+            free(list);
+            return -1;
+        }
+        port_count++;
+    }
+    free(list);
+    if (port_count == 0) {
+        return -1;
+    }
+
+    console_config.cols = 80;
+    console_config.rows = 25;
+    console_config.max_nr_ports = port_count;
+
+    console_device.device_id = VIRTIO_ID_CONSOLE;
+    console_device.num_queues = 2 * port_count + 2;
+    console_device.device_features = (1ULL << VIRTIO_F_VERSION_1) | (1ULL << VIRTIO_CONSOLE_F_SIZE) |
+                                     (1ULL << VIRTIO_CONSOLE_F_MULTIPORT) |
+                                     (1ULL << VIRTIO_CONSOLE_F_EMERG_WRITE);
+    console_device.notify = console_notify;
+    console_device.reset = console_reset;
+    console_device.poll = console_poll;
+    console_device.config_write = console_config_write;
+    virtio_register(&console_device);
+    LOG_INFO(LOG_CAT_MEMORY, "virtio-console: %u port(s)\n", port_count);
+    return 0;
+}
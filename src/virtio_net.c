@@ -0,0 +1,377 @@
+#define _GNU_SOURCE // recvmmsg/sendmmsg
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "virtio_net.h"
+#include "virtio.h"
+#include "log.h"
+
+typedef struct __attribute__((packed)) {
+    uint8_t mac[6];
+    uint16_t status;
+    uint16_t max_virtqueue_pairs;
+    uint16_t mtu;
+} VirtioNetConfig;
+
+static VirtioNetConfig net_config;
+static VirtioDevice net_device = {
+        .name = "virtio-net",
+        .irq = VIRTIO_NET_IRQ,
+        .config = (uint8_t *) &net_config,
+        .config_size = sizeof(VirtioNetConfig),
+};
+
+static int net_fd = -1;
+static struct sockaddr_un peers[VIRTIO_NET_MAX_PEERS];
+static int peer_count = 0;
+static uint32_t active_pairs = 1;
+
+// 接收等待：后台线程 poll 到可读后置位 rx_ready 并停下，CPU 线程收完 (套接字读空) 再 sem_post 让它继续等。
+// 客户机没有接收缓冲区时记下 rx_starved，等驱动补充缓冲区的通知再收
+static sem_t rx_wake;
+static atomic_int rx_ready = 0;
+static bool rx_polling = true;
+static bool rx_starved = false;
+
+// 一批帧的 msghdr 和 iovec，只在 CPU 线程使用
+static struct mmsghdr batch_msgs[VIRTIO_NET_BATCH];
+static struct iovec batch_iov[VIRTIO_NET_BATCH][VIRTIO_MAX_SEGMENTS];
+static uint16_t batch_heads[VIRTIO_NET_BATCH];
+static uint8_t drop_buffer[65536];
+
+static void *net_rx_loop(void *arg) {
+    (void) arg;
+    struct pollfd pfd = {.fd = net_fd, .events = POLLIN};
+    while (true) {
+        sem_wait(&rx_wake);
+        while (poll(&pfd, 1, -1) < 0 && errno == EINTR) {
+        }
+        atomic_store(&rx_ready, 1);
+        atomic_store(&virtio_completion_pending, 1);
+    }
+    return NULL;
+}
+
+static void rx_rearm(void) {
+    if (!rx_polling) {
+        rx_polling = true;
+        sem_post(&rx_wake);
+    }
+}
+
+// 把一个描述符链转换成 iovec，跳过开头的 virtio_net_hdr，返回 iovec 个数，链非法时返回 -1
+static int chain_to_iov(VirtQueue *queue, uint16_t head, bool receive, struct iovec *iov, uint8_t **header) {
+    VirtqBuffer buffers[VIRTIO_MAX_SEGMENTS];
+    int count = virtq_map_chain(queue, head, buffers, VIRTIO_MAX_SEGMENTS);
+    // 接收链全部可写、发送链全部只读；头部必须在第一段里
+    if (count < 1 || buffers[0].len < VIRTIO_NET_HDR_SIZE) {
+        return -1;
+    }
+    int iov_count = 0;
+    for (int i = 0; i < count; i++) {
+        if (buffers[i].device_writable != receive) {
+            return -1;
+        }
+        uint32_t skip = i == 0 ? VIRTIO_NET_HDR_SIZE : 0;
+        if (buffers[i].len > skip) {
+            iov[iov_count].iov_base = buffers[i].data + skip;
+            iov[iov_count].iov_len = buffers[i].len - skip;
+            iov_count++;
+        }
+    }
+    *header = buffers[0].data;
+    return iov_count;
+}
+
+// 丢弃套接字里积压的帧 (驱动未就绪时链路视为断开)
+static void rx_discard(void) {
+    while (recv(net_fd, drop_buffer, sizeof(drop_buffer), MSG_DONTWAIT) >= 0) {
+    }
+}
+
+// 选一个有空闲缓冲区的接收队列，平时都走第 0 对，缓冲区用完才溢出到其他队列，避免同一流乱序
+static VirtQueue *rx_queue_with_buffers(void) {
+    for (uint32_t pair = 0; pair < active_pairs; pair++) {
+        VirtQueue *queue = &net_device.queues[2 * pair];
+        uint16_t head;
+        if (virtq_pop(queue, &head)) {
+            virtq_unpop(queue, 1);
+            return queue;
+        }
+    }
+    return NULL;
+}
+
+// 一次最多收 4 批，防止对端持续发送时 CPU 线程停在这里
+static void net_receive(void) {
+    if ((net_device.status & (VIRTIO_STATUS_DRIVER_OK | VIRTIO_STATUS_NEEDS_RESET)) != VIRTIO_STATUS_DRIVER_OK) {
+        rx_discard();
+        rx_rearm();
+        return;
+    }
+    for (int round = 0; round < 4; round++) {
+        VirtQueue *queue = rx_queue_with_buffers();
+        if (queue == NULL) {
+            rx_starved = true;
+            return;
+        }
+        int count = 0;
+        uint8_t *headers[VIRTIO_NET_BATCH];
+        while (count < VIRTIO_NET_BATCH && virtq_pop(queue, &batch_heads[count])) {
+            int iov_count = chain_to_iov(queue, batch_heads[count], true, batch_iov[count], &headers[count]);
+            if (iov_count < 0) {
+                // 已取出的缓冲区要按顺序退回，不能跳过这一个，只能停下来等驱动复位
+                LOG_WARN(LOG_CAT_MEMORY, "virtio-net: malformed rx buffer\n");
+                virtq_unpop(queue, 1);
+                net_device.status |= VIRTIO_STATUS_NEEDS_RESET;
+                virtio_raise_interrupt(&net_device, VIRTIO_INT_CONFIG);
+                break;
+            }
+            memset(&batch_msgs[count], 0, sizeof(struct mmsghdr));
+            batch_msgs[count].msg_hdr.msg_iov = batch_iov[count];
+            batch_msgs[count].msg_hdr.msg_iovlen = iov_count;
+            count++;
+        }
+        int received = count > 0 ? recvmmsg(net_fd, batch_msgs, count, MSG_DONTWAIT, NULL) : 0;
+        if (received < 0) {
+            received = 0;
+        }
+        // 没用上的缓冲区退回 avail 环
+        virtq_unpop(queue, count - received);
+        for (int i = 0; i < received; i++) {
+            // 帧被截断说明驱动给的缓冲区不够大，按空帧交还
+            uint32_t length = batch_msgs[i].msg_hdr.msg_flags & MSG_TRUNC ? 0 : batch_msgs[i].msg_len;
+            memset(headers[i], 0, VIRTIO_NET_HDR_SIZE);
+            headers[i][10] = 1; // num_buffers
+            virtq_push(queue, batch_heads[i], length == 0 ? 0 : length + VIRTIO_NET_HDR_SIZE);
+        }
+        if (received > 0) {
+            virtq_notify_guest(&net_device, queue);
+        }
+        if (net_device.status & VIRTIO_STATUS_NEEDS_RESET) {
+            rx_starved = true;
+            return;
+        }
+        if (received < count) {
+            // 套接字读空，继续等待
+            rx_rearm();
+            return;
+        }
+    }
+    // 还有数据，下一个块边界再收
+    atomic_store(&rx_ready, 1);
+    atomic_store(&virtio_completion_pending, 1);
+}
+
+static void net_transmit(VirtQueue *queue) {
+    bool pushed = false;
+    while (true) {
+        int count = 0;
+        while (count < VIRTIO_NET_BATCH && virtq_pop(queue, &batch_heads[count])) {
+            uint8_t *header;
+            int iov_count = chain_to_iov(queue, batch_heads[count], false, batch_iov[count], &header);
+            if (iov_count < 0) {
+                LOG_WARN(LOG_CAT_MEMORY, "virtio-net: malformed tx packet\n");
+                virtq_push(queue, batch_heads[count], 0);
+                pushed = true;
+                continue;
+            }
+            memset(&batch_msgs[count], 0, sizeof(struct mmsghdr));
+            batch_msgs[count].msg_hdr.msg_iov = batch_iov[count];
+            batch_msgs[count].msg_hdr.msg_iovlen = iov_count;
+            count++;
+        }
+        if (count == 0) {
+            break;
+        }
+        // 对端缓冲区满或未启动时直接丢帧，和真实链路一样由上层协议重传
+        for (int p = 0; p < peer_count; p++) {
+            for (int i = 0; i < count; i++) {
+                batch_msgs[i].msg_hdr.msg_name = &peers[p];
+                batch_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_un);
+            }
+            sendmmsg(net_fd, batch_msgs, count, MSG_DONTWAIT);
+        }
+        for (int i = 0; i < count; i++) {
+            virtq_push(queue, batch_heads[i], 0);
+        }
+        pushed = true;
+    }
+    if (pushed) {
+        virtq_notify_guest(&net_device, queue);
+    }
+}
+
+static uint8_t net_control(uint8_t class, uint8_t command, VirtqBuffer *data, int count) {
+    switch (class) {
+        case VIRTIO_NET_CTRL_RX:
+            // 集线器模式下总是混杂接收，过滤交给客户机
+            return VIRTIO_NET_OK;
+        case VIRTIO_NET_CTRL_MQ:
+            if (command == VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET && count > 0 && data[0].len >= 2) {
+                uint16_t pairs;
+                memcpy(&pairs, data[0].data, sizeof(pairs));
+                if (pairs >= 1 && pairs <= VIRTIO_NET_MAX_PAIRS) {
+                    active_pairs = pairs;
+                    return VIRTIO_NET_OK;
+                }
+            }
+            return VIRTIO_NET_ERR;
+        default:
+            return VIRTIO_NET_ERR;
+    }
+}
+
+// 控制命令：{class, command} 头，命令数据，最后是设备可写的 ack 字节
+static void net_control_queue(VirtQueue *queue) {
+    uint16_t head;
+    bool pushed = false;
+    while (virtq_pop(queue, &head)) {
+        VirtqBuffer buffers[VIRTIO_MAX_SEGMENTS];
+        int count = virtq_map_chain(queue, head, buffers, VIRTIO_MAX_SEGMENTS);
+        uint32_t written = 0;
+        if (count >= 2 && buffers[0].len >= 2 && !buffers[0].device_writable &&
+            buffers[count - 1].device_writable && buffers[count - 1].len >= 1) {
+            *buffers[count - 1].data = net_control(buffers[0].data[0], buffers[0].data[1], buffers + 1, count - 2);
+            written = 1;
+        }
+        virtq_push(queue, head, written);
+        pushed = true;
+    }
+    if (pushed) {
+        virtq_notify_guest(&net_device, queue);
+    }
+}
+
+// 控制队列排在所有收发队列之后：协商了 MQ 时是 2 * max_virtqueue_pairs，否则只有一对收发队列，控制队列是 2
+static uint32_t net_control_index(VirtioDevice *device) {
+    if (device->driver_features & (1ULL << VIRTIO_NET_F_MQ)) {
+        return 2 * VIRTIO_NET_MAX_PAIRS;
+    }
+    return 2;
+}
+
+static void net_notify(VirtioDevice *device, uint32_t index) {
+    uint32_t control_index = net_control_index(device);
+    if (index == control_index) {
+        if (device->driver_features & (1ULL << VIRTIO_NET_F_CTRL_VQ)) {
+            net_control_queue(&device->queues[index]);
+        }
+    } else if (index > control_index) {
+        // 没有协商 MQ 时多出来的队列不存在
+        return;
+    } else if (index & 1) {
+        net_transmit(&device->queues[index]);
+    } else if (rx_starved) {
+        // 驱动补充了接收缓冲区
+        rx_starved = false;
+        net_receive();
+    }
+}
+
+static void net_poll(VirtioDevice *device) {
+    (void) device;
+    if (atomic_exchange(&rx_ready, 0)) {
+        rx_polling = false;
+        net_receive();
+    }
+}
+
+// 收发都在 CPU 线程同步完成，没有在途请求，只需恢复接收状态
+static void net_reset(VirtioDevice *device) {
+    (void) device;
+    active_pairs = 1;
+    if (rx_starved) {
+        rx_starved = false;
+        rx_rearm();
+    }
+}
+
+uint64_t virtio_net_read(uint64_t address, uint32_t size) {
+    return virtio_mmio_read(&net_device, address - VIRTIO_NET_BASE_ADDR, size);
+}
+
+void virtio_net_write(uint64_t address, uint64_t value, uint32_t size) {
+    virtio_mmio_write(&net_device, address - VIRTIO_NET_BASE_ADDR, value, size);
+}
+
+static bool make_address(struct sockaddr_un *address, const char *path) {
+    if (strlen(path) >= sizeof(address->sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return false;
+    }
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    strcpy(address->sun_path, path);
+    return true;
+}
+
+int virtio_net_open(const char *spec) {
+    char *list = strdup(spec);
+    char *save = NULL;
+    char *local = strtok_r(list, ",", &save);
+    struct sockaddr_un address;
+    if (local == NULL || !make_address(&address, local)) {
+        free(list);
+        return -1;
+    }
+    for (char *peer = strtok_r(NULL, ",", &save); peer != NULL; peer = strtok_r(NULL, ",", &save)) {
+        if (peer_count >= VIRTIO_NET_MAX_PEERS || !make_address(&peers[peer_count], peer)) {
+            fprintf(stderr, "Too many or invalid network peers\n");
+            free(list);
+            return -1;
+        }
+        peer_count++;
+    }
+
+    net_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    unlink(local);
+    if (net_fd < 0 || bind(net_fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+        perror("Failed to bind network socket");
+        free(list);
+        return -1;
+    }
+    int buffer_size = 4 << 20;
+    setsockopt(net_fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    setsockopt(net_fd, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+
+    // MAC 由本机套接字路径导出 (FNV-1a)，同一组配置每次启动都一样
+    uint32_t hash = 2166136261u;
+    for (const char *p = local; *p; p++) {
+        hash = (hash ^ (uint8_t) *p) * 16777619u;
+    }
+    uint8_t mac[6] = {0x52, 0x54, 0x00, (uint8_t) (hash >> 16), (uint8_t) (hash >> 8), (uint8_t) hash};
+    memcpy(net_config.mac, mac, sizeof(mac));
+    net_config.status = VIRTIO_NET_S_LINK_UP;
+    net_config.max_virtqueue_pairs = VIRTIO_NET_MAX_PAIRS;
+    net_config.mtu = VIRTIO_NET_MTU;
+
+    net_device.device_id = VIRTIO_ID_NET;
+    net_device.num_queues = 2 * VIRTIO_NET_MAX_PAIRS + 1;
+    net_device.device_features = (1ULL << VIRTIO_F_VERSION_1) | (1ULL << VIRTIO_NET_F_MTU) |
+                                 (1ULL << VIRTIO_NET_F_MAC) | (1ULL << VIRTIO_NET_F_STATUS) |
+                                 (1ULL << VIRTIO_NET_F_CTRL_VQ) | (1ULL << VIRTIO_NET_F_MQ);
+    net_device.notify = net_notify;
+    net_device.reset = net_reset;
+    net_device.poll = net_poll;
+
+    sem_init(&rx_wake, 0, 1);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, net_rx_loop, NULL) != 0) {
+        free(list);
+        return -1;
+    }
+    pthread_detach(thread);
+    virtio_register(&net_device);
+    LOG_INFO(LOG_CAT_MEMORY, "virtio-net: %s, %d peer(s), mac %02x:%02x:%02x:%02x:%02x:%02x\n", local, peer_count,
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    free(list);
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// 客户机基准测试：以无界面模式逐个运行 bench/*.bin，每个程序运行 --repeat 次取最快的一次，
+// 把墙钟时间、客户机指令数和 MIPS 汇总成 JSON。时间和指令数来自模拟器的 --stats 报告，
+// 不含模拟器启动；程序通过测试结束设备报告成功 (退出码 0) 时才算通过
+
+#define BENCH_LOAD_ADDRESS "0x80000000"
+
+typedef struct {
+    char name[256];
+    int passed;
+    double wall_seconds;
+    unsigned long instructions;
+    double mips;
+} BenchResult;
+
+static void print_usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s <simulator> [--repeat <n>] [--output <file>] <program.bin>...\n", program_name);
+}
+
+// 从模拟器的一行 JSON 报告里取出数值字段
+static int read_number(const char *report, const char *key, double *value) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+    const char *field = strstr(report, pattern);
+    if (field == NULL) {
+        return -1;
+    }
+    *value = strtod(field + strlen(pattern), NULL);
+    return 0;
+}
+
+// 运行一次，成功时填入 result 的时间、指令数和 MIPS
+static int run_once(const char *simulator, const char *program, BenchResult *result) {
+    char stats_path[] = "/tmp/riscv_bench_XXXXXX";
+    int fd = mkstemp(stats_path);
+    if (fd < 0) {
+        perror("Failed to create stats file");
+        return -1;
+    }
+    close(fd);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        unlink(stats_path);
+        return -1;
+    }
+    if (pid == 0) {
+        // 客户机输出和模拟器日志都丢弃，只留下 stderr 上的错误
+        char *args[] = {
+                (char *) simulator, "--rom", (char *) program, "--load_address", BENCH_LOAD_ADDRESS,
+                "--headless", "--console", "/dev/null", "--log_file", "/dev/null", "--stats", stats_path, NULL
+        };
+        execv(simulator, args);
+        perror("execv");
+        _exit(127);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    char report[1024] = {0};
+    FILE *file = fopen(stats_path, "r");
+    if (file != NULL) {
+        size_t length = fread(report, 1, sizeof(report) - 1, file);
+        report[length] = '\0';
+        fclose(file);
+    }
+    unlink(stats_path);
+
+    double instructions = 0;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 ||
+        read_number(report, "wall_seconds", &result->wall_seconds) != 0 ||
+        read_number(report, "instructions", &instructions) != 0 ||
+        read_number(report, "mips", &result->mips) != 0) {
+        return -1;
+    }
+    result->instructions = (unsigned long) instructions;
+    return 0;
+}
+
+static void write_json(FILE *file, const char *simulator, int repeat, const BenchResult *results, int count) {
+    fprintf(file, "{\n  \"simulator\": \"%s\",\n  \"repeat\": %d,\n  \"benchmarks\": [\n", simulator, repeat);
+    for (int i = 0; i < count; i++) {
+        const BenchResult *result = &results[i];
+        fprintf(file, "    {\"name\": \"%s\", \"status\": \"%s\", \"wall_seconds\": %.6f, "
+                      "\"instructions\": %lu, \"mips\": %.3f}%s\n",
+                result->name, result->passed ? "pass" : "fail", result->wall_seconds,
+                result->instructions, result->mips, i + 1 < count ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+}
+
+int main(int argc, char *argv[]) {
+    struct option long_options[] = {
+            {"repeat", required_argument, 0, 'n'},
+            {"output", required_argument, 0, 'o'},
+            {"help", no_argument, 0, 'h'},
+            {0, 0, 0, 0}
+    };
+    int repeat = 1;
+    const char *output_path = NULL;
+    int c;
+    while ((c = getopt_long(argc, argv, "n:o:h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'n':
+                repeat = (int) strtol(optarg, NULL, 0);
+                if (repeat < 1) {
+                    fprintf(stderr, "Error: --repeat must be at least 1\n");
+                    return 1;
+                }
+                break;
+            case 'o':
+                output_path = optarg;
+                break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (argc - optind < 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    const char *simulator = argv[optind];
+    int count = argc - optind - 1;
+    BenchResult *results = calloc(count, sizeof(BenchResult));
+    if (results == NULL) {
+        perror("Failed to allocate results");
+        return 1;
+    }
+
+    int failures = 0;
+    for (int i = 0; i < count; i++) {
+        const char *program = argv[optind + 1 + i];
+        BenchResult *result = &results[i];
+        // 名字取文件名去掉扩展名
+        char path[4096];
+        snprintf(path, sizeof(path), "%s", program);
+        snprintf(result->name, sizeof(result->name), "%s", basename(path));
+        char *extension = strrchr(result->name, '.');
+        if (extension != NULL) {
+            *extension = '\0';
+        }
+
+        result->passed = 1;
+        for (int run = 0; run < repeat; run++) {
+            BenchResult current = *result;
+            if (run_once(simulator, program, &current) != 0) {
+                result->passed = 0;
+                break;
+            }
+            if (run == 0 || current.wall_seconds < result->wall_seconds) {
+                *result = current;
+            }
+        }
+        if (!result->passed) {
+            failures++;
+        }
+        fprintf(stderr, "%-12s %s %10.6fs %12lu insts %9.3f MIPS\n", result->name,
+                result->passed ? "pass" : "FAIL", result->wall_seconds, result->instructions, result->mips);
+    }
+
+    FILE *output = stdout;
+    if (output_path != NULL) {
+        output = fopen(output_path, "w");
+        if (output == NULL) {
+            perror("Failed to open output file");
+            free(results);
+            return 1;
+        }
+    }
+    write_json(output, simulator, repeat, results, count);
+    if (output != stdout) {
+        fclose(output);
+    }
+    free(results);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace.h"
+#include "disassemble.h"
+
+// 离线解码 riscv_simulator --trace 生成的二进制执行轨迹
+
+static void print_usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s <trace file> [--start <n>] [--count <n>]\n", program_name);
+}
+
+// 从 .idx 索引中找到不晚于 start 的最后一个关键帧
+static int find_keyframe(const char *trace_path, uint64_t start, TraceIndexEntry *entry) {
+    char index_path[4096];
+    snprintf(index_path, sizeof(index_path), "%s%s", trace_path, TRACE_INDEX_SUFFIX);
+    FILE *file = fopen(index_path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    TraceIndexEntry current;
+    int found = -1;
+    while (fread(&current, sizeof(current), 1, file) == 1 && current.instret <= start) {
+        *entry = current;
+        found = 0;
+    }
+    fclose(file);
+    return found;
+}
+
+int main(int argc, char *argv[]) {
+    struct option long_options[] = {
+            {"start", required_argument, 0, 's'},
+            {"count", required_argument, 0, 'n'},
+            {"help", no_argument, 0, 'h'},
+            {0, 0, 0, 0}
+    };
+    uint64_t start = 0;
+    uint64_t count = UINT64_MAX;
+    int c;
+    while ((c = getopt_long(argc, argv, "s:n:h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 's':
+                start = strtoull(optarg, NULL, 0);
+                break;
+            case 'n':
+                count = strtoull(optarg, NULL, 0);
+                break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    const char *path = argv[optind];
+
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror("Failed to open trace file");
+        return 1;
+    }
+    if ((size_t) st.st_size < TRACE_HEADER_SIZE) {
+        fprintf(stderr, "Trace file too short\n");
+        return 1;
+    }
+    const uint8_t *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        perror("Failed to map trace file");
+        return 1;
+    }
+    const TraceHeader *header = (const TraceHeader *) data;
+    if (memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0) {
+        fprintf(stderr, "Not a trace file: %s\n", path);
+        return 1;
+    }
+
+    const uint8_t *stream = data + TRACE_HEADER_SIZE;
+    const uint8_t *end = data + st.st_size;
+    // 没有索引时从头开始顺序解码
+    TraceIndexEntry keyframe = {0, 0};
+    find_keyframe(path, start, &keyframe);
+
+    init_csr_names();
+    TraceState state = {0};
+    const uint8_t *p = stream + keyframe.offset;
+    uint64_t instret = keyframe.instret;
+    uint64_t printed = 0;
+    char buffer[128];
+
+    while (p < end && printed < count) {
+        const uint8_t *record = p;
+        uint8_t flags = *p++;
+        uint64_t value;
+        size_t n;
+        uint64_t pc = state.next_pc;
+
+        if (flags & TRACE_FLAG_KEYFRAME) {
+            if ((n = trace_get_varint(p, end, &pc)) == 0) break;
+            p += n;
+            for (int i = 0; i < 32; i++) {
+                if ((n = trace_get_varint(p, end, &state.registers[i])) == 0) goto truncated;
+                p += n;
+            }
+            state.mem_addr = 0;
+        } else if (flags & TRACE_FLAG_JUMP) {
+            if ((n = trace_get_varint(p, end, &value)) == 0) break;
+            p += n;
+            pc += (uint64_t) trace_unzigzag(value);
+        }
+        if (p + 4 > end) break;
+        uint32_t instruction;
+        memcpy(&instruction, p, sizeof(instruction));
+        p += sizeof(instruction);
+
+        int rd = -1;
+        if (flags & TRACE_FLAG_RD) {
+            if (p >= end) break;
+            rd = *p++ & 0x1F;
+            if ((n = trace_get_varint(p, end, &value)) == 0) break;
+            p += n;
+            state.registers[rd] += (uint64_t) trace_unzigzag(value);
+        }
+        uint64_t mem_data = 0;
+        if (flags & TRACE_FLAG_MEM) {
+            if ((n = trace_get_varint(p, end, &value)) == 0) break;
+            p += n;
+            state.mem_addr += (uint64_t) trace_unzigzag(value);
+            if ((n = trace_get_varint(p, end, &mem_data)) == 0) break;
+            p += n;
+        }
+        state.next_pc = pc + 4;
+
+        if (instret >= start) {
+            disassemble(pc, instruction, buffer, sizeof(buffer));
+            printf("%10lu  %016lx  %08x  %-32s", instret, pc, instruction, buffer);
+            if (rd >= 0) {
+                printf("  %s=0x%lx", reg_names[rd], state.registers[rd]);
+            }
+            if (flags & TRACE_FLAG_MEM) {
+                int size = 1 << ((flags >> TRACE_MEM_SIZE_SHIFT) & TRACE_MEM_SIZE_MASK);
+                printf("  %s%d [0x%lx] 0x%lx", (flags & TRACE_FLAG_STORE) ? "st" : "ld", size * 8,
+                       state.mem_addr, mem_data);
+            }
+            printf("\n");
+            printed++;
+        }
+        instret++;
+        continue;
+
+    truncated:
+        p = record;
+        break;
+    }
+    if (p < end && printed < count) {
+        fprintf(stderr, "Trace truncated at offset %ld\n", (long) (p - stream));
+    }
+
+    munmap((void *) data, st.st_size);
+    close(fd);
+    return 0;
+}